@@ -1,5 +1,6 @@
 #include "CustomControls.h"
 #include <string>
+#include <cstring>
 
 IKnobMultiControlText::IKnobMultiControlText (IPlugBase* pPlug, int x, int y, int paramIdx, IBitmap* pBitmap,
                                               IText* pText, bool showParamLabel, int offset)
@@ -178,22 +179,27 @@ ICairoPlotControl::ICairoPlotControl (IPlugBase* pPlug, IRECT pR, int paramIdx,
       mFill (fillEnable),
       mRange (1),
       mLineWeight (2.),
-      mRetina (false)
+      mRetina (false),
+      mAntialias (CAIRO_ANTIALIAS_DEFAULT),
+      surface (0),
+      cr (0),
+      mCache (0),
+      mCacheCr (0),
+      mCacheValid (false)
 {
     mWidth = mRECT.W ();
     mHeight = mRECT.H ();
 
     mVals = new valarray<double> (0., mWidth);
-
-    surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, mWidth, mHeight);
-    cr = cairo_create (surface);
 }
 
 ICairoPlotControl::~ICairoPlotControl ()
 {
     delete mVals;
-    cairo_destroy (cr);
-    cairo_surface_destroy (surface);
+    if (cr) cairo_destroy (cr);
+    if (surface) cairo_surface_destroy (surface);
+    if (mCacheCr) cairo_destroy (mCacheCr);
+    if (mCache) cairo_surface_destroy (mCache);
 }
 
 void ICairoPlotControl::setFillEnable (bool b)
@@ -216,18 +222,20 @@ void ICairoPlotControl::setAAquality (int quality)
     switch (quality)
     {
         case kNone:
-            cairo_set_antialias (cr, CAIRO_ANTIALIAS_NONE);
+            mAntialias = CAIRO_ANTIALIAS_NONE;
             break;
         case kFast:
-            cairo_set_antialias (cr, CAIRO_ANTIALIAS_FAST);
+            mAntialias = CAIRO_ANTIALIAS_FAST;
             break;
         case kGood:
-            cairo_set_antialias (cr, CAIRO_ANTIALIAS_GOOD);
+            mAntialias = CAIRO_ANTIALIAS_GOOD;
             break;
         case kBest:
-            cairo_set_antialias (cr, CAIRO_ANTIALIAS_BEST);
+            mAntialias = CAIRO_ANTIALIAS_BEST;
             break;
     }
+
+    if (cr) cairo_set_antialias (cr, mAntialias);
 }
 
 void ICairoPlotControl::setLineWeight (double w)
@@ -262,18 +270,10 @@ void ICairoPlotControl::plotVals (valarray<double>* vals, bool normalize)
     SetDirty (true);
 }
 
-bool ICairoPlotControl::Draw (IGraphics* pGraphics)
+void ICairoPlotControl::render (cairo_t* cr)
 {
     double mSpacing = (double) mWidth / mVals->size ();
 
-    cairo_save (cr);
-    cairo_set_source_rgba (cr, 0, 0, 0, 0);
-    cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
-    cairo_paint (cr);
-    cairo_restore (cr);
-
-    // surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, mWidth, mHeight);
-    // cr = cairo_create(surface);
     if (mRetina)
     {
         cairo_set_line_width (cr, mLineWeight * 2);
@@ -318,6 +318,26 @@ bool ICairoPlotControl::Draw (IGraphics* pGraphics)
         cairo_set_source_rgba (cr, mColorLine.R, mColorLine.G, mColorLine.B, mColorLine.A);
         cairo_stroke (cr);
     }
+}
+
+bool ICairoPlotControl::Draw (IGraphics* pGraphics)
+{
+    // Standalone controls create their surface on first draw, controls added to an
+    // ICairoPlotCompositor never do
+    if (!surface)
+    {
+        surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, mWidth, mHeight);
+        cr = cairo_create (surface);
+        cairo_set_antialias (cr, mAntialias);
+    }
+
+    cairo_save (cr);
+    cairo_set_source_rgba (cr, 0, 0, 0, 0);
+    cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+    cairo_paint (cr);
+    cairo_restore (cr);
+
+    render (cr);
 
     cairo_surface_flush (surface);
 
@@ -326,15 +346,17 @@ bool ICairoPlotControl::Draw (IGraphics* pGraphics)
     LICE_WrapperBitmap WrapperBitmap = LICE_WrapperBitmap (data, mWidth, mHeight, mWidth, false);
 
     // Render
-    //}
     IBitmap result;
-
     result = IBitmap (&WrapperBitmap, WrapperBitmap.getWidth (), WrapperBitmap.getHeight ());
 
     return pGraphics->DrawBitmap (&result, &this->mRECT);
 }
 
 // Accessors//
+cairo_antialias_t ICairoPlotControl::getAntialias ()
+{
+    return mAntialias;
+}
 CColor ICairoPlotControl::getColorFill ()
 {
     return mColorFill;
@@ -370,13 +392,50 @@ inline double ICairoPlotControl::percentToCoordinates (double value)
     return mHeight - value * mHeight;
 }
 
+void ICairoPlotControl::setHistoryMapping (plotHistory& history, double yRange, double headroom)
+{
+    // percentToCoordinates (scaleValue (value, yRange, headroom, 0, 1)) as one linear map
+    const double scale = -mHeight / (headroom - yRange);
+    history.setMapping (scale, mHeight - scale * yRange);
+}
+
+cairo_t* ICairoPlotControl::getCache (bool clear)
+{
+    if (!mCache)
+    {
+        mCache = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, mWidth, mHeight);
+        mCacheCr = cairo_create (mCache);
+    }
+
+    cairo_set_antialias (mCacheCr, mAntialias);
+
+    if (clear)
+    {
+        cairo_save (mCacheCr);
+        cairo_set_source_rgba (mCacheCr, 0, 0, 0, 0);
+        cairo_set_operator (mCacheCr, CAIRO_OPERATOR_SOURCE);
+        cairo_paint (mCacheCr);
+        cairo_restore (mCacheCr);
+    }
+
+    cairo_new_path (mCacheCr);
+
+    return mCacheCr;
+}
+
+void ICairoPlotControl::paintCache (cairo_t* cr)
+{
+    cairo_surface_flush (mCache);
+    cairo_set_source_surface (cr, mCache, 0, 0);
+    cairo_paint (cr);
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 ILevelPlotControl::ILevelPlotControl (IPlugBase* pPlug, IRECT pR, IColor* fillColor, IColor* lineColor,
                                       double timeScale, bool fillEnable, int paramIdx)
     : ICairoPlotControl (pPlug, pR, paramIdx, fillColor, lineColor, fillEnable),
       mTimeScale (timeScale),
-      mBufferLength (0.),
       mYRange (-32),
       mStroke (true),
       mHeadroom (2),
@@ -385,17 +444,11 @@ ILevelPlotControl::ILevelPlotControl (IPlugBase* pPlug, IRECT pR, IColor* fillCo
 {
     mRes = kHighRes;
     mXRes = mWidth / 2.;
-    mDrawVals = new valarray<double> (mHeight, mXRes);
-    mBuffer = new valarray<double> (0., mTimeScale * mPlug->GetSampleRate () / (double) mXRes);
     setResolution (kHighRes);
     setLineWeight (2.);
 }
 
-ILevelPlotControl::~ILevelPlotControl ()
-{
-    delete mDrawVals;
-    delete mBuffer;
-}
+ILevelPlotControl::~ILevelPlotControl () {}
 
 void ILevelPlotControl::setReverseFill (bool rev)
 {
@@ -429,16 +482,9 @@ void ILevelPlotControl::setResolution (int res)
             break;
     }
 
-    mBuffer->resize (mTimeScale * mPlug->GetSampleRate () / (double) mXRes, -48.);
-    mBufferLength = 0;
-    if (mReverseFill)
-    {
-        mDrawVals->resize (mXRes, -2);
-    }
-    else
-    {
-        mDrawVals->resize (mXRes, mHeight);
-    }
+    mHistory.init (1, mXRes, IPMAX (1, int(mTimeScale * mPlug->GetSampleRate () / (double) mXRes)));
+    mHistory.fill (0, mReverseFill ? -2 : mHeight);
+    setHistoryMapping (mHistory, mYRange, 2);
     mSpacing = mWidth / mXRes;
 }
 
@@ -461,6 +507,8 @@ void ILevelPlotControl::setYRange (int yRangeDB)
         default:
             break;
     }
+
+    setHistoryMapping (mHistory, mYRange, 2);
 }
 
 void ILevelPlotControl::setStroke (bool stroke)
@@ -474,34 +522,11 @@ void ILevelPlotControl::setGradientFill (bool grad)
 }
 void ILevelPlotControl::process (double sample)
 {
-    mBuffer->operator[] (mBufferLength) = sample;
-    mBufferLength++;
-
-    if (mBufferLength >= mBuffer->size ())
-    {
-        double average;
-
-        *mDrawVals = mDrawVals->shift (1);
-
-        average = mBuffer->sum () / (double) mBuffer->size ();
-        average = scaleValue (average, mYRange, 2, 0, 1);
-        mDrawVals->operator[] (mDrawVals->size () - 1) = percentToCoordinates (average);
-
-        mBufferLength = 0;
-    }
+    mHistory.add (sample);
 }
 
-bool ILevelPlotControl::Draw (IGraphics* pGraphics)
+void ILevelPlotControl::render (cairo_t* cr)
 {
-    cairo_save (cr);
-    cairo_set_source_rgba (cr, 0, 0, 0, 0);
-    cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
-    cairo_paint (cr);
-    cairo_restore (cr);
-
-    // surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, mWidth, mHeight);
-    // cr = cairo_create(surface);
-
     if (mRetina)
     {
         cairo_set_line_width (cr, mLineWeight * 2);
@@ -526,13 +551,13 @@ bool ILevelPlotControl::Draw (IGraphics* pGraphics)
     }
 
     // Draw data points
-    for (int i = 0, x = 0; x < mWidth && i < mDrawVals->size (); i++)
+    for (int i = 0, x = 0; x < mWidth && i < mHistory.getColumns (); i++)
     {
-        cairo_line_to (cr, x, mDrawVals->operator[] (i));
+        cairo_line_to (cr, x, mHistory.get (0, i));
         x += mSpacing;
     }
 
-    cairo_line_to (cr, mWidth + 8, mDrawVals->operator[] (mDrawVals->size () - 1));
+    cairo_line_to (cr, mWidth + 8, mHistory.get (0, mHistory.getColumns () - 1));
     // Endpoint in bottom right corner
     if (mReverseFill)
     {
@@ -599,54 +624,32 @@ bool ILevelPlotControl::Draw (IGraphics* pGraphics)
             cairo_fill (cr);
         }
     }
-    cairo_surface_flush (surface);
-
-    unsigned int* data = (unsigned int*) cairo_image_surface_get_data (surface);
-    // Bind to LICE
-    LICE_WrapperBitmap WrapperBitmap = LICE_WrapperBitmap (data, mWidth, mHeight, mWidth, false);
-
-    // Render
-    //}
-    IBitmap result;
-    result = IBitmap (&WrapperBitmap, WrapperBitmap.getWidth (), WrapperBitmap.getHeight ());
-    return pGraphics->DrawBitmap (&result, &this->mRECT);
 }
 
 IGRPlotControl::IGRPlotControl (IPlugBase* pPlug, IRECT pR, int paramIdx, IColor* preFillColor, IColor* postFillColor,
                                 IColor* postLineColor, IColor* GRFillColor, IColor* GRLineColor, double timeScale)
     : ICairoPlotControl (pPlug, pR, paramIdx, postFillColor, postLineColor, true),
       mTimeScale (timeScale),
-      mBufferLength (0.),
       mYRange (-32),
       mHeadroom (2),
       sr (mPlug->GetSampleRate ()),
+      mRate (mPlug->GetSampleRate ()),
       mPreFillColor (preFillColor),
       mGRFillColor (GRFillColor),
       mGRLineColor (GRLineColor),
       mRes (2.),
-      mGradientFill (true)
+      mGradientFill (true),
+      mTap (0),
+      mOverlay (0),
+      mIncremental (false),
+      mNewColumns (0)
 {
     mXRes = mWidth / 2.;
-    mDrawValsPre = new valarray<double> (mHeight, mXRes);
-    mDrawValsPost = new valarray<double> (mHeight, mXRes);
-    mDrawValsGR = new valarray<double> (mHeight, mXRes);
-
-    mBufferPre = new valarray<double> (0., mTimeScale * sr / (double) mXRes);
-    mBufferPost = new valarray<double> (0., mTimeScale * sr / (double) mXRes);
-    mBufferGR = new valarray<double> (-2, mTimeScale * sr / (double) mXRes);
-
     setResolution (kHighRes);
     setLineWeight (2.);
 }
 
-IGRPlotControl::~IGRPlotControl ()
-{
-    delete mDrawValsPre;
-    delete mDrawValsPost;
-    delete mDrawValsGR;
-    delete mBufferPre;
-    delete mBufferPost;
-}
+IGRPlotControl::~IGRPlotControl () {}
 
 void IGRPlotControl::setResolution (int res)
 {
@@ -675,15 +678,12 @@ void IGRPlotControl::setResolution (int res)
 
     if (mRetina) mXRes /= 2;
 
-    mBufferPre->resize (mTimeScale * sr / (double) mXRes, -48.);
-    mBufferPost->resize (mTimeScale * sr / (double) mXRes, -48.);
-    mBufferGR->resize (mTimeScale * sr / (double) mXRes, 0);
-
-    mDrawValsPre->resize (mXRes, mHeight);
-    mDrawValsPost->resize (mXRes, mHeight);
-    mDrawValsGR->resize (mXRes, -2);
-
-    mBufferLength = 0;
+    mHistory.init (kLanes, mXRes, IPMAX (1, int(mTimeScale * mRate / (double) mXRes)));
+    mHistory.fill (kLanePre, mHeight);
+    mHistory.fill (kLanePost, mHeight);
+    mHistory.fill (kLaneGR, -2);
+    setHistoryMapping (mHistory, mYRange, mHeadroom);
+    mCacheValid = false;
 
     mSpacing = mWidth / mXRes;
 }
@@ -707,56 +707,82 @@ void IGRPlotControl::setYRange (int yRangeDB)
         default:
             break;
     }
+
+    setHistoryMapping (mHistory, mYRange, mHeadroom);
 }
 
 void IGRPlotControl::setGradientFill (bool enabled)
 {
     mGradientFill = enabled;
+    mCacheValid = false;
 }
 
-void IGRPlotControl::process (double sampleIn, double sampleOut, double sampleGR)
+void IGRPlotControl::setIncrementalDraw (bool enabled)
 {
-    mBufferPre->operator[] (mBufferLength) = sampleIn;
-    mBufferPost->operator[] (mBufferLength) = sampleOut;
-    mBufferGR->operator[] (mBufferLength) = sampleGR;
+    mIncremental = enabled;
+    mCacheValid = false;
+}
 
-    mBufferLength++;
+void IGRPlotControl::setMeterTap (meterTap* tap)
+{
+    mTap = tap;
+    mRate = mTap ? meterTap::getFrameRate (sr) : sr;
 
-    if (mBufferLength >= mBufferPre->size ())
-    {
-        double averagePre, averagePost, averageGR;
+    mEnvIn.init (envFollower::kPeak, 0, 75, 60, mRate);
+    mEnvOut.init (envFollower::kPeak, 0, 75, 60, mRate);
 
-        *mDrawValsPre = mDrawValsPre->shift (1);
-        *mDrawValsPost = mDrawValsPost->shift (1);
-        *mDrawValsGR = mDrawValsGR->shift (1);
+    setResolution (mRes);
+}
 
-        averagePre = mBufferPre->sum () / (double) mBufferPre->size ();
-        averagePost = mBufferPost->sum () / (double) mBufferPost->size ();
-        averageGR = mBufferGR->sum () / (double) mBufferGR->size ();
+void IGRPlotControl::setOverlay (IControl* overlay)
+{
+    mOverlay = overlay;
+}
 
-        averagePre = scaleValue (averagePre, mYRange, mHeadroom, 0, 1);
-        mDrawValsPre->operator[] (mDrawValsPre->size () - 1) = percentToCoordinates (averagePre);
+bool IGRPlotControl::IsDirty ()
+{
+    if (mTap)
+    {
+        // Pick up a sample rate change from Reset, this rebuilds the followers and history on the GUI thread
+        if (mTap->getSampleRate () != sr)
+        {
+            sr = mTap->getSampleRate ();
+            setMeterTap (mTap);
+        }
 
-        averagePost = scaleValue (averagePost, mYRange, mHeadroom, 0, 1);
-        mDrawValsPost->operator[] (mDrawValsPost->size () - 1) = percentToCoordinates (averagePost);
+        meterFrame frame;
+        bool updated = false;
 
-        averageGR = scaleValue (averageGR, mYRange, mHeadroom, 0, 1);
-        mDrawValsGR->operator[] (mDrawValsGR->size () - 1) = percentToCoordinates (averageGR);
+        while (mTap->read (frame))
+        {
+            process (AmpToDB (mEnvIn.process (frame.in)), AmpToDB (mEnvOut.process (frame.out)), frame.gr);
+            updated = true;
+        }
 
-        mBufferLength = 0;
+        if (updated)
+        {
+            SetDirty (false);
+            if (mOverlay) mOverlay->SetDirty (false);
+        }
     }
+
+    return IControl::IsDirty ();
 }
 
-bool IGRPlotControl::Draw (IGraphics* pGraphics)
+void IGRPlotControl::process (double sampleIn, double sampleOut, double sampleGR)
 {
-    cairo_save (cr);
-    cairo_set_source_rgba (cr, 0, 0, 0, 0);
-    cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
-    cairo_paint (cr);
-    cairo_restore (cr);
+    if (mHistory.add (sampleIn, sampleOut, sampleGR))
+    {
+        mNewColumns++;
+    }
+}
 
-    // surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, mWidth, mHeight);
-    // cr = cairo_create(surface);
+void IGRPlotControl::drawColumns (cairo_t* cr, int first)
+{
+    // Partial redraws start the paths at the first column instead of outside the plot.
+    // The caller clips the closing edge away.
+    const double left = first > 0 ? first * mSpacing : -4.;
+    const double leftGR = first > 0 ? first * mSpacing : -8.;
 
     if (mRetina)
     {
@@ -769,16 +795,16 @@ bool IGRPlotControl::Draw (IGraphics* pGraphics)
     ////////////////////////////////////////////////////////////////////////////////PRE
 
     // Starting point in bottom left corner.
-    cairo_move_to (cr, -4, mHeight + 4);
+    cairo_move_to (cr, left, mHeight + 4);
 
     // Draw data points
-    for (int i = 0, x = 0; x < mWidth && i < mDrawValsPre->size (); i++)
+    for (int i = first, x = first * mSpacing; x < mWidth && i < mHistory.getColumns (); i++)
     {
-        cairo_line_to (cr, x, mDrawValsPre->operator[] (i));
+        cairo_line_to (cr, x, mHistory.get (kLanePre, i));
         x += mSpacing;
     }
 
-    cairo_line_to (cr, mWidth + 4, mDrawValsPre->operator[] (mDrawValsPre->size () - 1));
+    cairo_line_to (cr, mWidth + 4, mHistory.get (kLanePre, mHistory.getColumns () - 1));
     // Endpoint in bottom right corner
     cairo_line_to (cr, mWidth + 4, mHeight + 4);
 
@@ -792,16 +818,16 @@ bool IGRPlotControl::Draw (IGraphics* pGraphics)
     cairo_new_path (cr);
 
     // Starting point in bottom left corner.
-    cairo_move_to (cr, -4, mHeight + 4);
+    cairo_move_to (cr, left, mHeight + 4);
 
     // Draw data points
-    for (int i = 0, x = 0; x < mWidth && i < mDrawValsPost->size (); i++)
+    for (int i = first, x = first * mSpacing; x < mWidth && i < mHistory.getColumns (); i++)
     {
-        cairo_line_to (cr, x, mDrawValsPost->operator[] (i));
+        cairo_line_to (cr, x, mHistory.get (kLanePost, i));
         x += mSpacing;
     }
 
-    cairo_line_to (cr, mWidth + 4, mDrawValsPre->operator[] (mDrawValsPre->size () - 1));
+    cairo_line_to (cr, mWidth + 4, mHistory.get (kLanePre, mHistory.getColumns () - 1));
     // Endpoint in bottom right corner
     cairo_line_to (cr, mWidth + 4, mHeight + 4);
 
@@ -814,16 +840,16 @@ bool IGRPlotControl::Draw (IGraphics* pGraphics)
     cairo_new_path (cr);
 
     // Starting point in top left corner.
-    cairo_move_to (cr, -8, -8);
+    cairo_move_to (cr, leftGR, -8);
 
     // Draw data points
-    for (int i = 0, x = 0; x < mWidth && i < mDrawValsGR->size (); i++)
+    for (int i = first, x = first * mSpacing; x < mWidth && i < mHistory.getColumns (); i++)
     {
-        cairo_line_to (cr, x, mDrawValsGR->operator[] (i));
+        cairo_line_to (cr, x, mHistory.get (kLaneGR, i));
         x += mSpacing;
     }
 
-    cairo_line_to (cr, mWidth + 8, mDrawValsGR->operator[] (mDrawValsGR->size () - 1));
+    cairo_line_to (cr, mWidth + 8, mHistory.get (kLaneGR, mHistory.getColumns () - 1));
 
     // Endpoint in top right corner
     cairo_line_to (cr, mWidth + 8, -8);
@@ -885,59 +911,120 @@ bool IGRPlotControl::Draw (IGraphics* pGraphics)
     cairo_path_destroy (pathPre);
     cairo_path_destroy (pathPost);
     cairo_path_destroy (pathGR);
+}
 
-    cairo_surface_flush (surface);
+void IGRPlotControl::render (cairo_t* cr)
+{
+    if (!mIncremental)
+    {
+        drawColumns (cr, 0);
+        return;
+    }
 
-    unsigned int* data = (unsigned int*) cairo_image_surface_get_data (surface);
-    // Bind to LICE
-    LICE_WrapperBitmap WrapperBitmap = LICE_WrapperBitmap (data, mWidth, mHeight, mWidth, false);
+    const int size = mHistory.getColumns ();
+    const int shift = mNewColumns * mSpacing;
 
-    // Render
-    //}
-    IBitmap result;
-    result = IBitmap (&WrapperBitmap, WrapperBitmap.getWidth (), WrapperBitmap.getHeight ());
-    return pGraphics->DrawBitmap (&result, &this->mRECT);
+    if (!mCacheValid || mNewColumns >= size - 2 || shift >= mWidth)
+    {
+        // Full redraw
+        drawColumns (getCache (true), 0);
+        mCacheValid = true;
+    }
+    else if (mNewColumns > 0)
+    {
+        getCache (false);
+        scrollCache (shift);
+
+        // Everything right of the newest previously drawn column, less room for the
+        // stroke, has changed. Paths start a column further left so no edge shows.
+        const int margin = (int) ceil (mLineWeight) + 3;
+        const int xStart = IPMAX (0, (size - 1 - mNewColumns) * mSpacing - margin);
+        const int first = IPMAX (0, (xStart - margin) / mSpacing - 1);
+
+        cairo_save (mCacheCr);
+        cairo_rectangle (mCacheCr, xStart, 0, mWidth - xStart, mHeight);
+        cairo_clip (mCacheCr);
+        cairo_set_source_rgba (mCacheCr, 0, 0, 0, 0);
+        cairo_set_operator (mCacheCr, CAIRO_OPERATOR_SOURCE);
+        cairo_paint (mCacheCr);
+        cairo_set_operator (mCacheCr, CAIRO_OPERATOR_OVER);
+
+        cairo_new_path (mCacheCr);
+        drawColumns (mCacheCr, first);
+        cairo_restore (mCacheCr);
+    }
+
+    mNewColumns = 0;
+
+    paintCache (cr);
+}
+
+void IGRPlotControl::scrollCache (int shift)
+{
+    cairo_surface_flush (mCache);
+
+    unsigned char* data = cairo_image_surface_get_data (mCache);
+    const int stride = cairo_image_surface_get_stride (mCache);
+
+    for (int y = 0; y < mHeight; y++)
+    {
+        unsigned char* row = data + y * stride;
+        memmove (row, row + shift * 4, (mWidth - shift) * 4);
+    }
+
+    cairo_surface_mark_dirty (mCache);
 }
 
 ICompressorPlotControl::ICompressorPlotControl (IPlugBase* pPlug, IRECT pR, IColor* lineColor, IColor* fillColor,
-                                                compressor* comp, int paramIdx)
+                                                compressorCurve* curve, int paramIdx)
     : ICairoPlotControl (pPlug, pR, paramIdx, fillColor, lineColor, false), mYRange (-32), mHeadroom (2.)
 {
     setLineWeight (2.);
-    mComp = comp;
+    mCurve = curve;
+    mCurve->update (mComp);
 }
 
 void ICompressorPlotControl::calc ()
 {
-    double threshCoord = scaleValue (mComp->getThreshold (), mYRange, mHeadroom, 0, mWidth);
+    double threshCoord = scaleValue (mComp.getThreshold (), mYRange, mHeadroom, 0, mWidth);
 
-    x1 = scaleValue (mComp->getKneeBoundL (), mYRange, mHeadroom, 0, mWidth);
+    x1 = scaleValue (mComp.getKneeBoundL (), mYRange, mHeadroom, 0, mWidth);
     y1 = mHeight - x1;
 
     xCP = threshCoord;
     yCP = mHeight - threshCoord;
 
-    x2 = scaleValue (mComp->getKneeBoundU (), mYRange, mHeadroom, 0, mWidth);
-    y2 = yCP - ((x2 - xCP) / mComp->getRatio ());
+    x2 = scaleValue (mComp.getKneeBoundU (), mYRange, mHeadroom, 0, mWidth);
+    y2 = yCP - ((x2 - xCP) / mComp.getRatio ());
 
     x3 = mWidth + 2;
 
-    y3 = yCP - ((mWidth + 2 - xCP) / mComp->getRatio ());
+    y3 = yCP - ((mWidth + 2 - xCP) / mComp.getRatio ());
 
-    SetDirty ();
+    mCacheValid = false;
+    SetDirty (false);
 }
 
-bool ICompressorPlotControl::Draw (IGraphics* pGraphics)
+bool ICompressorPlotControl::IsDirty ()
 {
-    cairo_save (cr);
-    cairo_set_source_rgba (cr, 0, 0, 0, 0);
-    cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
-    cairo_paint (cr);
-    cairo_restore (cr);
+    if (mCurve->update (mComp)) calc ();
 
-    // surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, mWidth, mHeight);
-    // cr = cairo_create(surface);
+    return IControl::IsDirty ();
+}
 
+void ICompressorPlotControl::render (cairo_t* cr)
+{
+    if (!mCacheValid)
+    {
+        drawCurve (getCache (true));
+        mCacheValid = true;
+    }
+
+    paintCache (cr);
+}
+
+void ICompressorPlotControl::drawCurve (cairo_t* cr)
+{
     if (mRetina)
     {
         cairo_set_line_width (cr, mLineWeight * 2);
@@ -957,7 +1044,7 @@ bool ICompressorPlotControl::Draw (IGraphics* pGraphics)
     // Starting point in bottom left corner.
     cairo_move_to (cr, -1, mHeight + 1);
 
-    if (mComp->getKnee () > 0.)
+    if (mComp.getKnee () > 0.)
     {
         cairo_line_to (cr, x1, y1);
         cairo_curve_to (cr, xCP, yCP, xCP, yCP, x2, y2);
@@ -970,38 +1057,40 @@ bool ICompressorPlotControl::Draw (IGraphics* pGraphics)
     }
 
     cairo_stroke (cr);
-
-    cairo_surface_flush (surface);
-
-    unsigned int* data = (unsigned int*) cairo_image_surface_get_data (surface);
-    // Bind to LICE
-    LICE_WrapperBitmap WrapperBitmap = LICE_WrapperBitmap (data, mWidth, mHeight, mWidth, false);
-
-    // Render
-    //
-    IBitmap result;
-    result = IBitmap (&WrapperBitmap, WrapperBitmap.getWidth (), WrapperBitmap.getHeight ());
-
-    return pGraphics->DrawBitmap (&result, &this->mRECT);
 }
 
 IThresholdPlotControl::IThresholdPlotControl (IPlugBase* pPlug, IRECT pR, int paramIdx, IColor* lineColor,
-                                              compressor* comp)
+                                              compressorCurve* curve)
     : ICairoPlotControl (pPlug, pR, paramIdx, (IColor*) &COLOR_BLACK, lineColor, false), mYRange (-32), mHeadroom (2)
 {
-    mComp = comp;
+    mCurve = curve;
+    mCurve->update (mComp);
 }
 
-bool IThresholdPlotControl::Draw (IGraphics* pGraphics)
+bool IThresholdPlotControl::IsDirty ()
 {
-    cairo_save (cr);
-    cairo_set_source_rgba (cr, 0, 0, 0, 0);
-    cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
-    cairo_paint (cr);
-    cairo_restore (cr);
+    if (mCurve->update (mComp))
+    {
+        mCacheValid = false;
+        SetDirty (false);
+    }
+
+    return IControl::IsDirty ();
+}
 
-    // surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, mWidth, mHeight);
-    // cr = cairo_create(surface);
+void IThresholdPlotControl::render (cairo_t* cr)
+{
+    if (!mCacheValid)
+    {
+        drawThreshold (getCache (true));
+        mCacheValid = true;
+    }
+
+    paintCache (cr);
+}
+
+void IThresholdPlotControl::drawThreshold (cairo_t* cr)
+{
     double dashes[] = {
         6.0, /* ink */
         3.0, /* skip */
@@ -1026,7 +1115,7 @@ bool IThresholdPlotControl::Draw (IGraphics* pGraphics)
 
     cairo_set_dash (cr, dashes, ndash, offset);
 
-    double threshCoord = scaleValue (mComp->getThreshold (), mYRange, mHeadroom, 0, mHeight);
+    double threshCoord = scaleValue (mComp.getThreshold (), mYRange, mHeadroom, 0, mHeight);
 
     cairo_move_to (cr, threshCoord, 0);
 
@@ -1050,6 +1139,74 @@ bool IThresholdPlotControl::Draw (IGraphics* pGraphics)
 
     cairo_fill (cr);
     cairo_pattern_destroy (grad);
+}
+
+ICairoPlotCompositor::ICairoPlotCompositor (IPlugBase* pPlug, IRECT pR) : IControl (pPlug, pR)
+{
+    mWidth = mRECT.W ();
+    mHeight = mRECT.H ();
+
+    surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, mWidth, mHeight);
+    cr = cairo_create (surface);
+}
+
+ICairoPlotCompositor::~ICairoPlotCompositor ()
+{
+    for (int i = 0; i < mLayers.size (); i++) delete mLayers[i];
+
+    cairo_destroy (cr);
+    cairo_surface_destroy (surface);
+}
+
+void ICairoPlotCompositor::addLayer (ICairoPlotControl* layer)
+{
+    mLayers.push_back (layer);
+    SetDirty (false);
+}
+
+bool ICairoPlotCompositor::IsDirty ()
+{
+    bool dirty = IControl::IsDirty ();
+
+    // Every layer is polled so that layers that pull data in IsDirty() stay up to date
+    for (int i = 0; i < mLayers.size (); i++)
+    {
+        if (mLayers[i]->IsDirty ()) dirty = true;
+    }
+
+    return dirty;
+}
+
+bool ICairoPlotCompositor::Draw (IGraphics* pGraphics)
+{
+    cairo_save (cr);
+    cairo_set_source_rgba (cr, 0, 0, 0, 0);
+    cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+    cairo_paint (cr);
+    cairo_restore (cr);
+
+    for (int i = 0; i < mLayers.size (); i++)
+    {
+        ICairoPlotControl* layer = mLayers[i];
+
+        if (!layer->IsHidden ())
+        {
+            IRECT* r = layer->GetRECT ();
+
+            cairo_save (cr);
+            cairo_translate (cr, r->L - mRECT.L, r->T - mRECT.T);
+            cairo_rectangle (cr, 0, 0, r->W (), r->H ());
+            cairo_clip (cr);
+            cairo_new_path (cr);
+            cairo_set_antialias (cr, layer->getAntialias ());
+
+            layer->render (cr);
+
+            cairo_restore (cr);
+        }
+
+        layer->SetClean ();
+    }
 
     cairo_surface_flush (surface);
 
@@ -1058,7 +1215,50 @@ bool IThresholdPlotControl::Draw (IGraphics* pGraphics)
     LICE_WrapperBitmap WrapperBitmap = LICE_WrapperBitmap (data, mWidth, mHeight, mWidth, false);
 
     // Render
-    //}
     IBitmap result (&WrapperBitmap, WrapperBitmap.getWidth (), WrapperBitmap.getHeight ());
     return pGraphics->DrawBitmap (&result, &this->mRECT);
 }
+
+
+ILoadMeterControl::ILoadMeterControl (IPlugBase* pPlug, IRECT pR, IText* pText, const blockTimer* timer)
+: ITextControl (pPlug, pR, pText, ""), mTimer (timer), mFrames (kRefreshFrames)
+{
+    mTimer->read (mLast);
+}
+
+bool ILoadMeterControl::IsDirty ()
+{
+    if (++mFrames >= kRefreshFrames)
+    {
+        mFrames = 0;
+
+        blockTimingStats stats;
+        mTimer->read (stats);
+
+        // Mean over the blocks since the last update, the stats are totals since the last reset
+        uint64_t blocks = stats.blocks - mLast.blocks;
+        if (stats.blocks < mLast.blocks || blocks > 0)
+        {
+            double load = stats.blocks < mLast.blocks ? stats.loadSum / std::max<uint64_t> (stats.blocks, 1) : (stats.loadSum - mLast.loadSum) / blocks;
+
+            char text[64];
+            snprintf (text, sizeof (text), "DSP %.1f%%  peak %.1f%%  late %llu", 100. * load, 100. * stats.peakLoad, (unsigned long long) stats.overruns);
+            SetTextFromPlug (text);
+            mLast = stats;
+        }
+    }
+
+    return IControl::IsDirty ();
+}
+
+IIdleControl::IIdleControl (IPlugBase* pPlug, idleFunction function)
+: IControl (pPlug, IRECT (0, 0, 0, 0)), mFunction (function)
+{
+}
+
+bool IIdleControl::IsDirty ()
+{
+    mFunction (mPlug);
+
+    return false;
+}
@@ -2,10 +2,15 @@
 #define CUSTOM_CONTROLS_H
 
 #include <valarray>
+#include <vector>
 #include <cairo.h>
 #include "IControl.h"
 #include "DSP/DSP.h"
 #include "DSP/EnvelopeFollower.h"
+#include "DSP/MeterTap.h"
+#include "DSP/CompressorCurve.h"
+#include "DSP/BlockTimer.h"
+#include "DSP/PlotHistory.h"
 
 class IKnobMultiControlText : public IKnobMultiControl
 {
@@ -205,7 +210,8 @@ public:
     void plotVals (valarray<double>* vals, bool normalize = false);
 
     /**
-     *  Draw the plot. To be called by IGraphics.
+     *  Draw the plot into the control's own surface and blit it. To be called by IGraphics.
+     *  Not used when the control is a layer of an ICairoPlotCompositor.
      *
      *  @param pGraphics Pointer to IGraphics
      *
@@ -213,7 +219,16 @@ public:
      */
     bool Draw (IGraphics* pGraphics);
 
+    /**
+     *  Render the plot into a Cairo context whose origin is the top left corner of the plot.
+     *  The context is not cleared first.
+     *
+     *  @param cr Pointer to a cairo_t
+     */
+    virtual void render (cairo_t* cr);
+
     // Accessors//
+    cairo_antialias_t getAntialias ();
     CColor getColorFill ();
     CColor getColorLine ();
     bool getFill ();
@@ -228,9 +243,10 @@ protected:
     int mWidth, mHeight;
     double mRange, mLineWeight;
     valarray<double>* mVals;
+    bool mRetina;
+    cairo_antialias_t mAntialias;
     cairo_surface_t* surface;
     cairo_t* cr;
-    bool mRetina;
 
     /**
      *  Scale a value from range [inMin, inMax] to [outMin, outMax]
@@ -246,6 +262,37 @@ protected:
     inline double scaleValue (double inValue, double inMin, double inMax, double outMin, double outMax);
 
     inline double percentToCoordinates (double value);
+
+    /**
+     *  Set history to store its columns as plot coordinates, mapping yRange dB to the bottom
+     *  of the plot and headroom dB to the top, as scaleValue() and percentToCoordinates() do
+     *
+     *  @param history  The plot's history
+     *  @param yRange   Level at the bottom of the plot in dB
+     *  @param headroom Level at the top of the plot in dB
+     */
+    void setHistoryMapping (plotHistory& history, double yRange, double headroom);
+
+    /**
+     *  Get the context of the control's cache surface, creating the surface on first use.
+     *  Layers that change rarely render into the cache and paint it with paintCache().
+     *
+     *  @param clear If true, the cache is cleared to transparent
+     *
+     *  @return Pointer to the cache's cairo_t
+     */
+    cairo_t* getCache (bool clear);
+
+    /**
+     *  Paint the cache surface into cr at the plot origin
+     *
+     *  @param cr Pointer to a cairo_t
+     */
+    void paintCache (cairo_t* cr);
+
+    cairo_surface_t* mCache;
+    cairo_t* mCacheCr;
+    bool mCacheValid;
 };
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -338,18 +385,16 @@ public:
     void process (double sample);
 
     /**
-     *  Draws the plot
-     *
-     *  @param pGraphics Pointer to IGraphics
+     *  Renders the plot
      *
-     *  @return True if drawn
+     *  @param cr Pointer to a cairo_t
      */
-    bool Draw (IGraphics* pGraphics);
+    void render (cairo_t* cr);
 
 protected:
     double mTimeScale;
-    int mBufferLength, mXRes, mRes, mSpacing, mYRange, mHeadroom;
-    valarray<double>*mBuffer, *mDrawVals;
+    int mXRes, mRes, mSpacing, mYRange, mHeadroom;
+    plotHistory mHistory;
     bool mStroke, mReverseFill, mGradientFill;
 };
 
@@ -382,17 +427,80 @@ public:
 
     void setGradientFill (bool enabled);
 
+    /**
+     *  If enabled, the plot is kept in a cached surface that is scrolled left as columns arrive,
+     *  and only the newly arrived columns at the right edge are rasterized
+     *
+     *  @param enabled True = incremental drawing
+     */
+    void setIncrementalDraw (bool enabled);
+
+    /**
+     *  Feed the plot from a meterTap instead of calling process() from the audio thread.
+     *  Frames are drained, envelope followed and converted to dB on the GUI thread in IsDirty().
+     *
+     *  @param tap Pointer to a meterTap written by the audio thread
+     */
+    void setMeterTap (meterTap* tap);
+
+    /**
+     *  Set a control drawn on top of the plot that must be redrawn whenever the plot changes
+     *
+     *  @param overlay Pointer to an IControl
+     */
+    void setOverlay (IControl* overlay);
+
+    /**
+     *  Add a column of values to the plot
+     *
+     *  @param sampleIn  Input level in dB
+     *  @param sampleOut Output level in dB
+     *  @param sampleGR  Gain reduction in dB
+     */
     void process (double sampleIn, double sampleOut, double sampleGR);
 
-    bool Draw (IGraphics* pGraphics);
+    /**
+     *  Polled by IGraphics once per frame. Drains the meterTap if one is set.
+     *
+     *  @return True if the plot needs to be redrawn
+     */
+    bool IsDirty ();
+
+    void render (cairo_t* cr);
 
 protected:
-    double mTimeScale, sr;
-    int mBufferLength, mXRes, mSpacing, mYRange, mHeadroom, mRes;
-    valarray<double>*mBufferPre, *mBufferPost, *mBufferGR, *mDrawValsPre, *mDrawValsPost, *mDrawValsGR;
+    /**
+     *  Draw the plot paths from column first to the right edge
+     */
+    void drawColumns (cairo_t* cr, int first);
+
+    /**
+     *  Move the cached pixels left by shift pixels
+     */
+    void scrollCache (int shift);
+
+    // Lanes of mHistory
+    enum
+    {
+        kLanePre,
+        kLanePost,
+        kLaneGR,
+        kLanes
+    };
+
+    double mTimeScale, sr, mRate;
+    int mXRes, mSpacing, mYRange, mHeadroom, mRes;
+    plotHistory mHistory;
 
     bool mGradientFill;
 
+    meterTap* mTap;
+    envFollower mEnvIn, mEnvOut;
+    IControl* mOverlay;
+
+    bool mIncremental;
+    int mNewColumns;
+
     CColor mPreFillColor, mGRLineColor, mGRFillColor;
 };
 
@@ -414,27 +522,34 @@ public:
      *  @param pR           IRECT
      *  @param lineColor    Pointer to an IColor
      *  @param fillColor    Pointer to an IColor
-     *  @param comp         Pointer to a compressor
+     *  @param curve        Pointer to a compressorCurve published by the audio thread
      *  @param paramIdx     Parameter index (Default = -1)
      */
-    ICompressorPlotControl (IPlugBase* pPlug, IRECT pR, IColor* lineColor, IColor* fillColor, compressor* comp,
+    ICompressorPlotControl (IPlugBase* pPlug, IRECT pR, IColor* lineColor, IColor* fillColor, compressorCurve* curve,
                             int paramIdx = -1);
 
     /**
-     *  Update the compressor response curve. Call when compressor settings are changed.
+     *  Update the compressor response curve and invalidate the cached layer
      */
     void calc ();
 
     /**
-     *  Draw the plot
+     *  Polled by IGraphics once per frame. Recalculates the curve if the published settings changed.
      *
-     *  @param pGraphics Pointer to IGraphics
+     *  @return True if the plot needs to be redrawn
+     */
+    bool IsDirty ();
+
+    /**
+     *  Render the plot
      *
-     *  @return True if drawn
+     *  @param cr Pointer to a cairo_t
      */
-    bool Draw (IGraphics* pGraphics);
+    void render (cairo_t* cr);
 
 private:
+    void drawCurve (cairo_t* cr);
+
     double mHeadroom;
 
     /**
@@ -457,7 +572,8 @@ private:
      */
     double x3, y3;
     int mYRange;
-    compressor* mComp;
+    compressorCurve* mCurve;
+    compressor mComp;
 };
 
 /**
@@ -472,14 +588,128 @@ private:
 class IThresholdPlotControl : public ICairoPlotControl
 {
 public:
-    IThresholdPlotControl (IPlugBase* pPlug, IRECT pR, int paramIdx, IColor* lineColor, compressor* comp);
+    IThresholdPlotControl (IPlugBase* pPlug, IRECT pR, int paramIdx, IColor* lineColor, compressorCurve* curve);
 
-    bool Draw (IGraphics* pGraphics);
+    /**
+     *  Polled by IGraphics once per frame. Invalidates the cached layer if the threshold changed.
+     *
+     *  @return True if the plot needs to be redrawn
+     */
+    bool IsDirty ();
+
+    void render (cairo_t* cr);
 
 private:
+    void drawThreshold (cairo_t* cr);
+
     int mYRange;
     double mHeadroom;
-    compressor* mComp;
+    compressorCurve* mCurve;
+    compressor mComp;
+};
+
+/**
+ *  An IControl that owns a single Cairo surface and context and renders a stack of
+ *  ICairoPlotControls into it in z-order (first added is drawn first). The result is
+ *  blitted once per frame. Layers are not attached to IGraphics, the compositor
+ *  polls them for dirtiness and takes ownership of them.
+ *
+ *  @see ICairoPlotControl
+ */
+class ICairoPlotCompositor : public IControl
+{
+public:
+    ICairoPlotCompositor (IPlugBase* pPlug, IRECT pR);
+
+    ~ICairoPlotCompositor ();
+
+    /**
+     *  Add a layer on top of the existing ones. The layer's IRECT must lie inside the compositor's.
+     *
+     *  @param layer Pointer to an ICairoPlotControl, ownership passes to the compositor
+     */
+    void addLayer (ICairoPlotControl* layer);
+
+    bool IsDirty ();
+
+    bool Draw (IGraphics* pGraphics);
+
+private:
+    int mWidth, mHeight;
+    std::vector<ICairoPlotControl*> mLayers;
+    cairo_surface_t* surface;
+    cairo_t* cr;
+};
+
+/**
+ *  A text readout of the audio callback's load, polled from a blockTimer on the GUI thread.
+ *  Shows the mean load since the previous update, the peak load and the overrun count
+ *
+ *  @see blockTimer
+ */
+class ILoadMeterControl : public ITextControl
+{
+public:
+    /**
+     *  Constructor
+     *
+     *  @param pPlug        Pointer to IPlugBase
+     *  @param pR           IRECT
+     *  @param pText        Pointer to an IText
+     *  @param timer        Pointer to the blockTimer of the audio callback
+     */
+    ILoadMeterControl (IPlugBase* pPlug, IRECT pR, IText* pText, const blockTimer* timer);
+
+    ~ILoadMeterControl () {}
+
+    /**
+     *  Polled by IGraphics once per frame. Rereads the timer every kRefreshFrames frames.
+     *
+     *  @return True if the text changed
+     */
+    bool IsDirty ();
+
+private:
+    enum
+    {
+        kRefreshFrames = 8
+    };
+
+    const blockTimer* mTimer;
+    blockTimingStats mLast;
+    int mFrames;
+};
+
+/**
+ *  An invisible control that calls a function once per GUI frame, from IsDirty() on the GUI
+ *  thread. For calls the host expects from its UI thread, such as SetLatency()
+ */
+class IIdleControl : public IControl
+{
+public:
+    typedef void (*idleFunction) (IPlugBase* pPlug);
+
+    /**
+     *  Constructor
+     *
+     *  @param pPlug        Pointer to IPlugBase, passed to function
+     *  @param function     Called once per frame
+     */
+    IIdleControl (IPlugBase* pPlug, idleFunction function);
+
+    ~IIdleControl () {}
+
+    bool Draw (IGraphics* pGraphics) { return true; }
+
+    /**
+     *  Polled by IGraphics once per frame. Calls the function
+     *
+     *  @return False, there is nothing to draw
+     */
+    bool IsDirty ();
+
+private:
+    idleFunction mFunction;
 };
 
 #endif //CUSTOM_CONTROLS_H
@@ -24,6 +24,14 @@ enum EParams
   kCutoffLP,
   kHPEnable,
   kLPEnable,
+  kLookahead,
+  kDetector,
+  kRMSWindow,
+  kOversamplingClean,
+  kOversamplingColored,
+  kOversamplingLimiter,
+  kLinkMode,
+  kLinkGroups,
   kNumParams
 };
 
@@ -68,6 +76,10 @@ enum ELayout
   kModeX = 320,
   kModeY = 282,
   
+  kDetectorX = 462,
+  kDetectorY = 19,
+  kRMSWindowX = kDetectorX + 79,
+  
   kKnobFrames = 63,
   kSliderFrames = 68
 };
@@ -76,27 +88,12 @@ enum ELayout
 
 
 DComp::DComp(IPlugInstanceInfo instanceInfo)
-:	IPLUG_CTOR(kNumParams, kNumPrograms, instanceInfo), mGain(0.), mThreshold(0.), mAttack(10.), mHold(0.), mRelease(250.), mRatio(4), mKnee(.5),mMix(1.), mCuttoffLP(20000.), mCuttoffHP(20.), mHPEnable(false), mLPEnable(false), mSCAudition(false), mSidechainEnable(false), mMode(0)
+:	IPLUG_CTOR(kNumParams, kNumPrograms, instanceInfo)
 {
   TRACE;
   
-  ///////////////////////////////////////////////////////////////////////////////////////
-  //Param Smoothers
-  
-  mGainSmoother.init(5., GetSampleRate());
-  mThresholdSmoother.init(5., GetSampleRate());
-  mAttackSmoother.init(5., GetSampleRate());
-  mReleaseSmoother.init(5., GetSampleRate());
-  mHoldSmoother.init(5., GetSampleRate());
-  mRatioSmoother.init(5., GetSampleRate());
-  mMixSmoother.init(5., GetSampleRate());
-  mHPSmoother.init(5., GetSampleRate());
-  mLPSmoother.init(5., GetSampleRate());
-  mKneeSmoother.init(5., GetSampleRate());
+  static_assert(kNumParams <= kMaxParams, "mParams is too small for EParams");
   
-  ///////////////////////////////////////////////////////////////////////////////////////
-
-
   ///////////////////////////////////////////////////////////////////////////////////////
   //Parameters
   //arguments are: name, defaultVal, minVal, maxVal, step, label
@@ -123,24 +120,56 @@ DComp::DComp(IPlugInstanceInfo instanceInfo)
   GetParam(kSidechain)->InitBool("Sidechain", false);
   GetParam(kSCAudition)->InitBool("Audition Sidechain", false);
   
-  GetParam(kMode)->InitEnum("Mode", 0, 1);
+  GetParam(kMode)->InitEnum("Mode", 0, 3);
   GetParam(kMode)->SetDisplayText(0, "Clean");
   GetParam(kMode)->SetDisplayText(1, "Colored");
+  GetParam(kMode)->SetDisplayText(2, "Limiter");
+  
+  //Only used in Limiter mode, delays the output by the same amount
+  GetParam(kLookahead)->InitDouble("Lookahead", 5., 0., DCompEngine::kMaxLookaheadMS, 0.1, "ms");
+  
+  //Switching to RMS takes effect at the next block, OnParamChange allocates the RMS buffers
+  GetParam(kDetector)->InitEnum("Detector", envFollower::kPeak, 2);
+  GetParam(kDetector)->SetDisplayText(envFollower::kPeak, "Peak");
+  GetParam(kDetector)->SetDisplayText(envFollower::kRMS, "RMS");
+  GetParam(kRMSWindow)->InitDouble("RMS Window", 50., 1., DCompEngine::kMaxRMSWindowMS, 1., "ms");
+
+  //Per mode, Off/2x/4x/8x. Adds the oversampler's delay to the latency of that mode
+  const char* oversamplingNames[] = {"Clean Oversampling", "Colored Oversampling", "Limiter Oversampling"};
+  for (int i = 0; i < 3; ++i)
+  {
+    GetParam(kOversamplingClean + i)->InitEnum(oversamplingNames[i], 0, 4);
+    GetParam(kOversamplingClean + i)->SetDisplayText(0, "Off");
+    GetParam(kOversamplingClean + i)->SetDisplayText(1, "2x");
+    GetParam(kOversamplingClean + i)->SetDisplayText(2, "4x");
+    GetParam(kOversamplingClean + i)->SetDisplayText(3, "8x");
+  }
+  
+  //How the channels share their detector. Stereo links both channels under All and Pairs, Off compresses them separately
+  GetParam(kLinkMode)->InitEnum("Link Detector", DCompEngine::kLinkMax, 2);
+  GetParam(kLinkMode)->SetDisplayText(DCompEngine::kLinkMax, "Max");
+  GetParam(kLinkMode)->SetDisplayText(DCompEngine::kLinkSum, "Weighted Sum");
+  GetParam(kLinkGroups)->InitEnum("Channel Link", 0, 3);
+  GetParam(kLinkGroups)->SetDisplayText(0, "All");
+  GetParam(kLinkGroups)->SetDisplayText(1, "Pairs");
+  GetParam(kLinkGroups)->SetDisplayText(2, "Off");
       
   ///////////////////////////////////////////////////////////////////////////////////////
 
   
-  //Initialize envelope Followers
-  envPlotIn.init(compressor::kPeak, 0, 75, 60, GetSampleRate());
-  envPlotOut.init(compressor::kPeak, 0, 75, 60, GetSampleRate());
-  mComp.init(mAttack, mRelease, mHold, mRatio, mKnee, GetSampleRate());
-
+  //Seed the lock-free parameter targets with the parameter defaults
+  for (int i = 0; i < kNumParams; ++i)
+  {
+    OnParamChange(i);
+  }
+  
+  //Initialize engine from the defaults
+  applyParamChanges();
+  mEngine.init(GetSampleRate());
+  mEngine.setCurve(&mCurve);
+  mMeterTap.setSampleRate(GetSampleRate());
+  mTimer.setSampleRate(GetSampleRate());
   
-  //Initalize filters
-  mHighpass.setSampleRate(GetSampleRate());
-  mHighpass.setFilter(SVFHighpass, mCuttoffHP, 0.707, 0.);
-  mLowpass.setSampleRate(GetSampleRate());
-  mLowpass.setFilter(SVFLowpass, mCuttoffLP, 0.707, 0.);
   //Create graphics context
   IGraphics* pGraphics = MakeGraphics(this, kWidth, kHeight, 30);
   
@@ -199,23 +228,29 @@ DComp::DComp(IPlugInstanceInfo instanceInfo)
   multiPlot->setLineWeight(2.);
   multiPlot->setAAquality(ICairoPlotControl::kFast);
   multiPlot->setYRange(IGRPlotControl::k32dB);
+  multiPlot->setIncrementalDraw(true);
+  multiPlot->setMeterTap(&mMeterTap);
 
-  pGraphics->AttachControl(multiPlot);
+  //All cairo plots are rendered into one shared surface and blitted once per frame
+  plotCompositor = new ICairoPlotCompositor(this, plotRECT);
+  plotCompositor->addLayer(multiPlot);
   
   //Threshold plot
-  threshPlot= new IThresholdPlotControl(this, plotRECT, -1, &threshLineColor, &mComp);
+  threshPlot= new IThresholdPlotControl(this, plotRECT, -1, &threshLineColor, &mCurve);
   threshPlot->setLineWeight(3.);
   threshPlot->setAAquality(ICairoPlotControl::kNone);
 
-  pGraphics->AttachControl(threshPlot);
+  plotCompositor->addLayer(threshPlot);
   
   //Compressor ratio plot
-  compPlot = new ICompressorPlotControl(this, IRECT(plotRECT.L, plotRECT.T, plotRECT.L + plotRECT.H(), plotRECT.T + plotRECT.H()), &plotCompLineColor, &plotCompFillColor, &mComp);
+  compPlot = new ICompressorPlotControl(this, IRECT(plotRECT.L, plotRECT.T, plotRECT.L + plotRECT.H(), plotRECT.T + plotRECT.H()), &plotCompLineColor, &plotCompFillColor, &mCurve);
   compPlot->calc();
   compPlot->setLineWeight(3.);
   compPlot->setAAquality(ICairoPlotControl::kNone);
 
-  pGraphics->AttachControl(compPlot);
+  plotCompositor->addLayer(compPlot);
+
+  pGraphics->AttachControl(plotCompositor);
  
   //Inner shadow for plot
   mShadow = new IBitmapControl(this, plotRECT.L , plotRECT.T, &shadow);
@@ -274,11 +309,27 @@ DComp::DComp(IPlugInstanceInfo instanceInfo)
   //Mode selector popup
   pGraphics->AttachControl(new IPopUpMenuControl(this, IRECT(kModeX, kModeY, kModeX + 75, kModeY + 25), COLOR_WHITE, COLOR_WHITE, modeColor, kMode));
   
+  //Detector selector popup
+  pGraphics->AttachControl(new IPopUpMenuControl(this, IRECT(kDetectorX, kDetectorY, kDetectorX + 75, kDetectorY + 25), COLOR_WHITE, COLOR_WHITE, modeColor, kDetector));
+  
+  //RMS window caption
+  pGraphics->AttachControl(new ICaptionControl(this, IRECT(kRMSWindowX, kDetectorY + 2, kRMSWindowX + 63, kDetectorY + 23), kRMSWindow, &cutoffCaption));
+  
   //Version String
   pGraphics->AttachControl(new ITextControl(this, IRECT(106, 29, 175, 37), &versionText, versionString));
   
-  //Attach shadow
+  //Callback load readout, next to the version string
+  if (blockTimer::isEnabled())
+  {
+    pGraphics->AttachControl(new ILoadMeterControl(this, IRECT(180, 29, 340, 37), &versionText, &mTimer));
+  }
+  
+  //Reports latency changes from the GUI thread
+  pGraphics->AttachControl(new IIdleControl(this, &DComp::reportPendingLatency));
+  
+  //Attach shadow, redrawn along with the level plot
   pGraphics->AttachControl(mShadow);
+  multiPlot->setOverlay(mShadow);
   
   //Label I/O channels
   if (GetAPI() == kAPIVST2) // for VST2 we name individual outputs
@@ -309,26 +360,20 @@ DComp::DComp(IPlugInstanceInfo instanceInfo)
 DComp::~DComp() {}
 
 
-double DComp::distort(double sample){
-  if(sample > DBToAmp(mThreshold* .9) || sample < -1 * DBToAmp(mThreshold))
-    return 1/5. * fastAtan(sample * 5);
-  else
-    return sample;
-}
-
-
 void DComp::ProcessDoubleReplacing(double** inputs, double** outputs, int nFrames)
 {
-  // Mutex is already locked for us.
-
-  bool in1ic = IsInChannelConnected(0);
-  bool in2ic = IsInChannelConnected(1);
-  bool in3ic = IsInChannelConnected(2);
-  bool in4ic = IsInChannelConnected(3);
+  mTimer.begin();
   
-  //Print which channels are connected
-  printf("%i %i %i %i, ------------------------- \n", in1ic, in2ic, in3ic, in4ic);
+  // Mutex is already locked for us by the wrapper, but nothing in here relies on it.
+  // Parameter changes arrive lock-free through mParams.
+  applyParamChanges();
   
+  //Groups without an RMS buffer take one requested by OnParamChange, if the worker has made it
+  mRMSRings.apply(mEngine);
+  
+  //Only feed the plot while the editor is open
+  mEngine.setMeterTap(GetGUI() ? &mMeterTap : 0);
+
   //RTAS only supports one sidechain channel
 #ifdef RTAS_API
   double* in1 = inputs[0];
@@ -337,6 +382,8 @@ void DComp::ProcessDoubleReplacing(double** inputs, double** outputs, int nFrame
   
   double* out1 = outputs[0];
   double* out2 = outputs[1];
+  
+  mEngine.process(in1, in2, scin1, scin1, out1, out2, nFrames);
 #else
   double* in1 = inputs[0];
   double* in2 = inputs[1];
@@ -359,207 +406,124 @@ void DComp::ProcessDoubleReplacing(double** inputs, double** outputs, int nFrame
   }
 #endif
 
-  //Main processing loop
-  for (int s = 0; s < nFrames; ++s, ++scin1, ++scin2, ++in1, ++in2, ++out1, ++out2)
-  {
-    double sampleFiltered1, sampleFiltered2, sampleDry1, sampleDry2, gr, gainSmoothed, mixSmoothed;
-
-    /////////////////////////////////////////////////////////////////////////////////////////////////
-    //Parameter smoothing
-    
-    if(gainSmoothed != mGain) gainSmoothed = mGainSmoother.process(mGain);
-    if(mComp.getAttack() != mAttack) mComp.setAttack(mAttackSmoother.process(mAttack));
-    if(mComp.getRelease() != mRelease) mComp.setRelease(mReleaseSmoother.process(mRelease));
-    if(mComp.getHold() != mHold) mComp.setHold(mHoldSmoother.process(mHold));
-    if(mComp.getRatio() != mRatio){
-      mComp.setRatio(mRatioSmoother.process(mRatio));
-      compPlot->calc();
-    }
-    if(mComp.getThreshold() != mThreshold){
-      mComp.setThreshold(mThresholdSmoother.process(mThreshold));
-      compPlot->calc();
-    }
-    if(mComp.getKnee() != mKnee) {
-      mComp.setKnee(mKneeSmoother.process(mKnee));
-      compPlot->calc();
-    }
-    if(mixSmoothed != mMix) mixSmoothed = mMixSmoother.process(mMix);
-    if(mLowpass.getCutoff() != mCuttoffLP) mLowpass.setCutoffFreq(mLPSmoother.process(mCuttoffLP));
-    if(mHighpass.getCutoff() != mCuttoffHP) mHighpass.setCutoffFreq(mHPSmoother.process(mCuttoffHP));
-    
-    //end parameter smoothing
-    /////////////////////////////////////////////////////////////////////////////////////////////////
-
-    sampleDry1 = *in1;
-    sampleDry2 = *in2;
-    sampleFiltered1 = *in1;
-    sampleFiltered2 = *in2;
-    
-    //Apply Saturation
-    if(mMode == 1){
-      *in1 = distort(*in1);
-      *in2 = distort(*in2);
-    }
-    
-    //Filter sample for compressor envelope detector
-    if(!mSidechainEnable){
-      if(mLPEnable) {
-        sampleFiltered1 = mLowpass.processAudioSample(sampleFiltered1, 0);
-        sampleFiltered2 = mLowpass.processAudioSample(sampleFiltered2, 1);
-      }
-      if(mHPEnable){
-        sampleFiltered1 = mHighpass.processAudioSample(sampleFiltered1, 0);
-        sampleFiltered2 = mHighpass.processAudioSample(sampleFiltered2, 1);
-      }
-    
-      gr = mComp.processStereo(sampleFiltered1, sampleFiltered2);
-    }
-    else{
-      if(mLPEnable){
-        *scin1 = mLowpass.processAudioSample(*scin1, 0);
-        *scin2 = mLowpass.processAudioSample(*scin2, 1);
-      }
-      if(mHPEnable){
-        *scin1 = mHighpass.processAudioSample(*scin1, 0);
-        *scin2 = mHighpass.processAudioSample(*scin2, 1);
-      }
-
-      gr = mComp.processStereo(*scin1, *scin2);
-    }
-    
-    //Apply gain reduction from compressor
-    *in1 *= DBToAmp(gr);
-    *in2 *= DBToAmp(gr);
-    
-
-
-    //Apply makeup gain
-    *in1 *= DBToAmp(gainSmoothed);
-    *in2 *= DBToAmp(gainSmoothed);
-    
-    //If sidechain audition enabled, output sidechain signal
-    if(!mSCAudition){
-      *out1 = *in1 * mixSmoothed + sampleDry1 * (1 - mixSmoothed);
-      *out2 = *in2 * mixSmoothed + sampleDry2 * (1 - mixSmoothed);
-    }
-    else if(mSidechainEnable){
-      *out1 = *scin1;
-      *out2 = *scin2;
-    }
-    else{
-      *out1 = sampleFiltered1;
-      *out2 = sampleFiltered2;
-    }
-
-    //Update plots
-    //plot->process(AmpToDB(envPlotIn.process(max(sampleDry1, sampleDry2))));
-    //plotOut->process(AmpToDB(envPlotOut.process(max(*in1, *in2))));
-    //GRplot->process(scaleValue(gr, 2, -32, 2, -32));  //Scale value to match level plot range
-
-    
-    //Tell graphics context to redraw plots + shadow
-    if(GetGUI()) {
-      //plot->SetDirty();
-      //plotOut->SetDirty();
-      //compPlot->SetDirty();
-      //threshPlot->SetDirty();
-      //GRplot->SetDirty();
-      mShadow->SetDirty();
-      multiPlot->process(AmpToDB(envPlotIn.process(max(sampleDry1, sampleDry2))), AmpToDB(envPlotOut.process(max(*in1, *in2))), scaleValue(gr, 2, -32, 2, -32));
-
-    }
-  }
+  mEngine.process(in1, in2, scin1, scin2, out1, out2, nFrames);
 #endif
+  
+  mTimer.end(nFrames);
 }
 
 void DComp::Reset()
 {
   TRACE;
   IMutexLock lock(this);
+  
+  //Take parameter changes the audio thread has not applied yet, init() starts every smoother at its target
+  applyParamChanges();
+  
+  //Recompute every time constant for the current sample rate and clear all state. This also
+  //allocates every buffer the engine needs at this rate, so ProcessDoubleReplacing never does
+  mEngine.init(GetSampleRate());
+  mMeterTap.setSampleRate(GetSampleRate());
+  
+  mTimer.setSampleRate(GetSampleRate());
+  mTimer.requestReset();
+  
+  mLatencyPending.store(false);
+  updateLatency();
+}
+
+//Reports the Limiter mode lookahead and the oversampling delay to the host, PLUG_LATENCY covers the default (Clean, no oversampling) mode
+void DComp::updateLatency()
+{
+  int mode = GetParam(kMode)->Int();
+  int oversampling = 1 << GetParam(kOversamplingClean + mode)->Int();
+  int latency = DCompEngine::getLatency(mode, GetParam(kLookahead)->Value(), GetSampleRate(), oversampling);
+  
+  if (latency != GetLatency())
+  {
+    SetLatency(latency);
+  }
 }
 
 void DComp::OnParamChange(int paramIdx)
 {
-  IMutexLock lock(this);
+  //No lock is taken here. The new value is published through mParams and
+  //picked up by the audio thread at the start of the next block in applyParamChanges()
+  double value = GetParam(paramIdx)->Value();
 
   switch (paramIdx)
   {
-    case kGain:
-      mGain = GetParam(kGain)->Value();
-      break;
-      
-    case kThreshold:
-      mThreshold = GetParam(kThreshold)->Value();
-      mComp.setThreshold(mThresholdSmoother.process(mThreshold));
-      compPlot->calc();
-      threshPlot->SetDirty();
-      break;
-      
-    case kAttack:
-      mAttack = GetParam(kAttack)->Value();
-      break;
-      
-    case kHold:
-      mHold = GetParam(kHold)->Value();
-      break;
-      
-    case kRelease:
-      mRelease = GetParam(kRelease)->Value();
-      break;
-      
-    case kRatio:
-      mRatio = GetParam(kRatio)->Value();
-      mComp.setRatio(mRatioSmoother.process(mRatio));
-      compPlot->calc();
-      break;
-      
     case kKnee:
-      mKnee = GetParam(kKnee)->Value() * 2.;
-      mComp.setKnee(mKneeSmoother.process(mKnee));
-      compPlot->calc();
-      break;
-      
-    case kMode:
-      mMode = GetParam(kMode)->Value();
+      value *= 2.;
       break;
       
     case kMix:
-      mMix = GetParam(kMix)->Value() / 100.;
-      break;
-      
-    case kCutoffHP:
-      mCuttoffHP = GetParam(kCutoffHP)->Value();
-      break;
-      
-    case kCutoffLP:
-      mCuttoffLP = GetParam(kCutoffLP)->Value();
-      break;
-      
-    case kSidechain:
-      mSidechainEnable = GetParam(kSidechain)->Value();
-      break;
-    
-    case kSCAudition:
-      mSCAudition = GetParam(kSCAudition)->Value();
-      break;
-      
-    case kLPEnable:
-      mLPEnable = GetParam(kLPEnable)->Value();
-      break;
-      
-    case kHPEnable:
-      mHPEnable = GetParam(kHPEnable)->Value();
+      value /= 100.;
       break;
       
     default:
       break;
   }
+  
+  mParams.set(paramIdx, value);
+  
+  //RMS needs a buffer in every link group in use. Hosts may call this from the audio thread, so
+  //only ask mRMSRings for them, its worker allocates them and the next blocks pick them up
+  if ((paramIdx == kDetector || paramIdx == kLinkGroups) && GetParam(kDetector)->Int() == envFollower::kRMS)
+  {
+    //Stereo uses one group under All and Pairs, two under Off
+    mRMSRings.request(GetSampleRate(), GetParam(kLinkGroups)->Int() == 2 ? 2 : 1);
+  }
+  
+  //SetLatency makes the host restart the plugin, which it expects from its UI thread. Leave it to
+  //reportPendingLatency() on the GUI thread, or the next Reset() while the editor is closed
+  if (paramIdx == kMode || paramIdx == kLookahead || paramIdx == kOversamplingClean || paramIdx == kOversamplingColored || paramIdx == kOversamplingLimiter)
+  {
+    mLatencyPending.store(true);
+  }
 }
 
-inline double DComp::fastAtan(double x){
-  return (x / (1.0 + 0.28 * (x * x)));
+//Called once per frame on the GUI thread by the IIdleControl attached in the constructor
+void DComp::reportPendingLatency(IPlugBase* pPlug)
+{
+  DComp* plug = static_cast<DComp*>(pPlug);
+  if (plug->mLatencyPending.exchange(false))
+  {
+    plug->updateLatency();
+  }
 }
 
-inline double DComp::scaleValue(double inValue, double inMin, double inMax, double outMin, double outMax){
-  return ((outMax - outMin) * (inValue - inMin)) / (inMax - inMin) + outMin;
-}
\ No newline at end of file
+//Called from the audio thread at block start, copies the latest published parameter values
+void DComp::applyParamChanges()
+{
+  if(!mParams.consume())
+    return;
+  
+  mEngine.setGain(mParams.get(kGain));
+  mEngine.setThreshold(mParams.get(kThreshold));
+  mEngine.setAttack(mParams.get(kAttack));
+  mEngine.setRelease(mParams.get(kRelease));
+  mEngine.setHold(mParams.get(kHold));
+  mEngine.setRatio(mParams.get(kRatio));
+  mEngine.setKnee(mParams.get(kKnee));
+  mEngine.setMode(mParams.get(kMode));
+  mEngine.setMix(mParams.get(kMix));
+  mEngine.setSidechainEnable(mParams.get(kSidechain));
+  mEngine.setSidechainAudition(mParams.get(kSCAudition));
+  mEngine.setCutoffHP(mParams.get(kCutoffHP));
+  mEngine.setCutoffLP(mParams.get(kCutoffLP));
+  mEngine.setHPEnable(mParams.get(kHPEnable));
+  mEngine.setLPEnable(mParams.get(kLPEnable));
+  mEngine.setLookahead(mParams.get(kLookahead));
+  mEngine.setDetector(mParams.get(kDetector));
+  mEngine.setRMSWindow(mParams.get(kRMSWindow));
+  mEngine.setOversampling(DCompEngine::kClean, 1 << (int) mParams.get(kOversamplingClean));
+  mEngine.setOversampling(DCompEngine::kColored, 1 << (int) mParams.get(kOversamplingColored));
+  mEngine.setOversampling(DCompEngine::kLimiter, 1 << (int) mParams.get(kOversamplingLimiter));
+  mEngine.setLinkMode(mParams.get(kLinkMode));
+  
+  //All: one group, Pairs: front pairs and so on, Off: every channel on its own
+  int linkGroups = mParams.get(kLinkGroups);
+  for (int c = 0; c < DCompEngine::kMaxChannels; ++c)
+    mEngine.setLinkGroup(c, linkGroups == 0 ? 0 : linkGroups == 1 ? c / 2 : c);
+}
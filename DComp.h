@@ -1,11 +1,15 @@
 #ifndef __DCOMP__
 #define __DCOMP__
 
+#include <atomic>
 #include "IPlug_include_in_plug_hdr.h"
 #include "IPopupMenuControl.h"
-#include "DSP/CParamSmooth.h"
-#include "DSP/EnvelopeFollower.h"
-#include "DSP/VAStateVariableFilter/VAStateVariableFilter.h"
+#include "DSP/DCompEngine.h"
+#include "DSP/MeterTap.h"
+#include "DSP/CompressorCurve.h"
+#include "DSP/BlockTimer.h"
+#include "DSP/RMSRingWorker.h"
+#include "DSP/ParamTransport.h"
 #include "IControl.h"
 #include "CustomControls.h"
 
@@ -19,12 +23,19 @@ public:
   void OnParamChange(int paramIdx);
   void ProcessDoubleReplacing(double** inputs, double** outputs, int nFrames);
   
+  //Timing of ProcessDoubleReplacing against the buffer deadline, safe to call from any thread
+  void getBlockTiming(blockTimingStats& stats) const { mTimer.read(stats); }
+  void resetBlockTiming() { mTimer.requestReset(); }
+  
+  //Blocks taking longer than this fraction of nFrames / sample rate count as overruns (default 1)
+  void setDeadlineFraction(double fraction) { mTimer.setDeadlineFraction(fraction); }
+  
 private:
   char* versionString = "v0.1.1";
   
-  double scaleValue(double inValue, double inMin, double inMax, double outMin, double outMax);
-  inline double fastAtan(double x);
-  double distort(double sample);
+  void applyParamChanges();
+  void updateLatency();
+  static void reportPendingLatency(IPlugBase* pPlug);
   
   const int kGainMin = 0;
   const int kGainMax = 32;
@@ -32,6 +43,9 @@ private:
   const int kThresholdMax = 2;
   const double frameTime = 1/20.;
   
+  //Must be at least kNumParams
+  static const int kMaxParams = 23;
+  
   IColor plotBackgroundColor = IColor(206,206,206);
   IColor plotPreLineColor =  IColor(170, 151, 151, 151);
   IColor plotPostLineColor =  IColor(123, 200, 200, 200);
@@ -56,27 +70,26 @@ private:
   IText popUpLabel = IText(18, &COLOR_WHITE, "Futura", IText::kStyleNormal, IText::kAlignCenter);
   IText versionText = IText(9, &threshLineColor, "Futura", IText::kStyleNormal, IText::kAlignNear);
   
-  double mGain, mThreshold, mAttack, mHold, mRelease, mRatio, mKnee, mMix, mCuttoffLP, mCuttoffHP;
-  int mMode;
-  bool mSidechainEnable, mSCAudition, mLPEnable, mHPEnable;
-  envFollower envPlotIn;
-  envFollower envPlotOut;
-  compressor mComp;
+  //Latest parameter values published by OnParamChange, indexed by EParams
+  paramTransport<kMaxParams> mParams;
+  
+  //Set by OnParamChange when the latency may have changed, see reportPendingLatency()
+  std::atomic<bool> mLatencyPending{false};
+  
+  //Allocates the RMS buffers OnParamChange asks for on its own thread, swapped in by the audio thread
+  rmsRingWorker<double> mRMSRings;
+  
+  //All audio processing, owned by the audio thread
+  DCompEngine mEngine;
   
-  VAStateVariableFilter mLowpass;
-  VAStateVariableFilter mHighpass;
+  //Effective threshold, ratio and knee of the compressor, polled by the curve plots on the GUI thread
+  compressorCurve mCurve;
   
+  //Level and gain reduction summaries for the plot, drained by multiPlot on the GUI thread
+  meterTap mMeterTap;
   
-  CParamSmooth mGainSmoother;
-  CParamSmooth mThresholdSmoother;
-  CParamSmooth mAttackSmoother;
-  CParamSmooth mReleaseSmoother;
-  CParamSmooth mHoldSmoother;
-  CParamSmooth mRatioSmoother;
-  CParamSmooth mKneeSmoother;
-  CParamSmooth mMixSmoother;
-  CParamSmooth mHPSmoother;
-  CParamSmooth mLPSmoother;
+  //Times every ProcessDoubleReplacing call, read by the load readout and getBlockTiming()
+  blockTimer mTimer;
   
   ILevelPlotControl* plot;
   ILevelPlotControl* plotOut;
@@ -85,6 +98,7 @@ private:
   IThresholdPlotControl* threshPlot;
   
   IGRPlotControl* multiPlot;
+  ICairoPlotCompositor* plotCompositor;
   
   IBitmapControl* mShadow;
 };
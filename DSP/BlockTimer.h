@@ -0,0 +1,136 @@
+//
+//  BlockTimer.h
+//
+//  Times each audio callback against its deadline (nFrames / sampleRate) on the monotonic
+//  clock. The audio thread is the only writer and keeps everything in relaxed atomics, so
+//  the GUI or any other thread can read the stats at any time without a lock.
+//  Build with DCOMP_BLOCK_TIMING=0 and begin()/end() compile to nothing.
+//
+
+#ifndef BlockTimer_h
+#define BlockTimer_h
+
+#ifndef DCOMP_BLOCK_TIMING
+#define DCOMP_BLOCK_TIMING 1
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+//Totals since the last reset. Fields are read one at a time, so they can be a block apart
+struct blockTimingStats{
+    enum{
+        kBuckets = 16
+    };
+
+    uint64_t blocks;        //Blocks timed
+    uint64_t overruns;      //Blocks that took longer than the deadline fraction
+    uint64_t samples;       //Samples in those blocks
+    uint64_t busyNS;        //Time spent in them, busyNS / samples is the cost per sample
+    double loadSum;         //Sum of each block's time over its deadline, loadSum / blocks is the mean load
+    double peakLoad;        //Longest block over its deadline
+
+    //Blocks by processing time per sample: bucket 0 is under 1 ns, bucket i is 2^(i-1) to
+    //2^i ns, the last bucket also takes everything slower
+    uint64_t histogram[kBuckets];
+};
+
+class blockTimer{
+public:
+    blockTimer() : nsPerFrame(1e9 / 44100.), deadlineFraction(1.), resetRequested(false){
+        clear();
+    }
+
+    ~blockTimer(){}
+
+    //Audio thread, or before processing starts
+    void setSampleRate(double sampleRate){
+        nsPerFrame = 1e9 / sampleRate;
+    }
+
+    //Any thread. Blocks taking longer than this fraction of their deadline count as overruns
+    void setDeadlineFraction(double fraction){
+        deadlineFraction.store(fraction, std::memory_order_relaxed);
+    }
+
+    double getDeadlineFraction() const { return deadlineFraction.load(std::memory_order_relaxed); }
+
+    //Any thread. The stats are cleared by the audio thread at the end of the next block
+    void requestReset(){
+        resetRequested.store(true, std::memory_order_release);
+    }
+
+#if DCOMP_BLOCK_TIMING
+    //Audio thread, first thing in the callback
+    inline void begin(){
+        start = std::chrono::steady_clock::now();
+    }
+
+    //Audio thread, last thing in the callback
+    inline void end(int nFrames){
+        const int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+        if(resetRequested.load(std::memory_order_relaxed) && resetRequested.exchange(false, std::memory_order_acquire)) clear();
+        if(nFrames <= 0) return;
+
+        const double load = ns / (nFrames * nsPerFrame);
+
+        //Single writer, so plain load + store instead of read-modify-write
+        increment(blocks, 1);
+        increment(samples, nFrames);
+        increment(busyNS, ns);
+        loadSum.store(loadSum.load(std::memory_order_relaxed) + load, std::memory_order_relaxed);
+        if(load > peakLoad.load(std::memory_order_relaxed)) peakLoad.store(load, std::memory_order_relaxed);
+        if(load > deadlineFraction.load(std::memory_order_relaxed)) increment(overruns, 1);
+
+        int bucket = 0;
+        for(uint64_t perSample = ns / nFrames; perSample && bucket < blockTimingStats::kBuckets - 1; perSample >>= 1) ++bucket;
+        increment(histogram[bucket], 1);
+    }
+#else
+    inline void begin(){}
+    inline void end(int){}
+#endif
+
+    //Any thread
+    void read(blockTimingStats& stats) const{
+        stats.blocks = blocks.load(std::memory_order_relaxed);
+        stats.overruns = overruns.load(std::memory_order_relaxed);
+        stats.samples = samples.load(std::memory_order_relaxed);
+        stats.busyNS = busyNS.load(std::memory_order_relaxed);
+        stats.loadSum = loadSum.load(std::memory_order_relaxed);
+        stats.peakLoad = peakLoad.load(std::memory_order_relaxed);
+        for(int i = 0; i < blockTimingStats::kBuckets; ++i) stats.histogram[i] = histogram[i].load(std::memory_order_relaxed);
+    }
+
+    //False when timing was compiled out and the stats stay empty
+    static bool isEnabled(){ return DCOMP_BLOCK_TIMING != 0; }
+
+private:
+    std::chrono::steady_clock::time_point start;
+    double nsPerFrame;
+
+    std::atomic<double> deadlineFraction;
+    std::atomic<bool> resetRequested;
+
+    std::atomic<uint64_t> blocks, overruns, samples, busyNS;
+    std::atomic<double> loadSum, peakLoad;
+    std::atomic<uint64_t> histogram[blockTimingStats::kBuckets];
+
+    static inline void increment(std::atomic<uint64_t>& counter, uint64_t amount){
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    void clear(){
+        blocks.store(0, std::memory_order_relaxed);
+        overruns.store(0, std::memory_order_relaxed);
+        samples.store(0, std::memory_order_relaxed);
+        busyNS.store(0, std::memory_order_relaxed);
+        loadSum.store(0., std::memory_order_relaxed);
+        peakLoad.store(0., std::memory_order_relaxed);
+        for(int i = 0; i < blockTimingStats::kBuckets; ++i) histogram[i].store(0, std::memory_order_relaxed);
+    }
+};
+
+#endif /* BlockTimer_h */
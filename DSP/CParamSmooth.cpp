@@ -32,4 +32,15 @@ double CParamSmooth::process(double in)
     z = (in * b) + (z * a);
     return z;
 }
+
+double CParamSmooth::processBlock(double in, int nSamples)
+{
+    z = in + (z - in) * pow(a, nSamples);
+    return z;
+}
+
+void CParamSmooth::reset(double value)
+{
+    z = value;
+}
     
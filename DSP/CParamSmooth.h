@@ -20,6 +20,12 @@ public:
     void init(double smoothingTimeInMs, double samplingRate);
 
     double process(double in);
+    
+    //Advances the smoother by nSamples steps towards in, in closed form
+    double processBlock(double in, int nSamples);
+    
+    //Jumps straight to value, so the next call does not ramp in from 0
+    void reset(double value);
 
 private:
     double a, b, z;
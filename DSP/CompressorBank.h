@@ -0,0 +1,179 @@
+//
+//  CompressorBank.h
+//
+//  Many independent peak compressors, one per mixer strip say, with their state kept as
+//  structure of arrays: one array each for the envelopes, hold timers, coefficients and
+//  curve settings. The compressBank kernel then advances a whole register of strips per
+//  instruction, sample by sample (4 doubles or 8 floats with AVX2, twice that with AVX-512).
+//  Every strip keeps its own settings.
+//
+//  Each strip behaves like a compressor fed through processBlock(): gain reduction in dB
+//  for a detector level. Only peak detection is supported, with no RMS, gain table or
+//  control rate. Unlike compressor, the envelope is kept in T, so a float bank fits twice
+//  as many strips per register and stays within float rounding of the double one.
+//
+
+#ifndef CompressorBank_h
+#define CompressorBank_h
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "DSPKernels.h"
+#include "EnvelopeFollower.h"
+
+template <typename T>
+class compressorBank{
+public:
+    //process() transposes tiles of kChunk frames by kTile strips, which stay in L1
+    enum{
+        kChunk = 64,
+        kTile = 32
+    };
+
+    compressorBank(){
+        init(0, 44100);
+    }
+
+    ~compressorBank(){}
+
+    //count strips at sampleRate, each with the compressor defaults (5 ms attack, 50 ms release,
+    //no hold, 4:1, hard knee, 0 dB threshold) and a cleared envelope. Allocates, not real time safe
+    void init(int count, double sampleRate){
+        n = std::max(0, count);
+        sr = sampleRate;
+        kernels = &getDSPKernels();
+
+        env.assign(n, (T) 0);
+        timer.assign(n, (T) 0);
+        attack.assign(n, (T) 0);
+        release.assign(n, (T) 0);
+        hold.assign(n, (T) 0);
+        threshold.assign(n, (T) 0);
+        slope.assign(n, (T) 0);
+        kneeL.assign(n, (T) 0);
+        kneeU.assign(n, (T) 0);
+        kneeScale.assign(n, (T) 0);
+        settings.assign(n, stripSettings());
+        std::vector<T>(kChunk * kTile).swap(scratch);
+
+        for(int k = 0; k < n; ++k){
+            setAttack(k, 5.);
+            setRelease(k, 50.);
+            setHold(k, 0.);
+            updateCurve(k);
+        }
+    }
+
+    int getCount() const { return n; }
+
+    //Clears every envelope and hold timer, settings stay
+    void reset(){
+        std::fill(env.begin(), env.end(), (T) 0);
+        std::fill(timer.begin(), timer.end(), (T) 0);
+    }
+
+    //Per strip settings, in the units compressor takes. strip must be below getCount()
+    void setAttack(int strip, double attackMS){
+        attack[strip] = (T) pow(0.01, 1.0/(attackMS * sr * 0.001));
+    }
+
+    void setRelease(int strip, double releaseMS){
+        release[strip] = (T) pow(0.01, 1.0/(releaseMS * sr * 0.001));
+    }
+
+    void setHold(int strip, double holdMS){
+        hold[strip] = (T) (int) (holdMS / 1000. * sr);
+    }
+
+    void setThreshold(int strip, double thresholdDB){
+        settings[strip].threshold = thresholdDB;
+        updateCurve(strip);
+    }
+
+    void setRatio(int strip, double ratio){
+        settings[strip].ratio = ratio;
+        updateCurve(strip);
+    }
+
+    void setKnee(int strip, double knee){
+        settings[strip].knee = knee;
+        updateCurve(strip);
+    }
+
+    //compressor::kCompressor or compressor::kLimiter
+    void setMode(int strip, int mode){
+        settings[strip].mode = mode;
+        updateCurve(strip);
+    }
+
+    //Envelope of strip, linear
+    T getEnvelope(int strip) const { return env[strip]; }
+
+    //Frame major, sample i of strip k at i * getCount() + k, the layout the kernel runs on.
+    //level and grOut may be the same buffer
+    void processInterleaved(const T* level, T* grOut, int nFrames){
+        kernels->compressBank(level, grOut, nFrames, n, n, lanes());
+    }
+
+    //One buffer per strip, transposed through a scratch tile. level[k] and grOut[k] may be the same buffer
+    void process(const T* const* level, T* const* grOut, int nFrames){
+        T* x = scratch.data();
+        for(int first = 0; first < n; first += kTile){
+            const int strips = std::min((int) kTile, n - first);
+            const compressorLanes<T> s = lanes(first);
+
+            for(int offset = 0; offset < nFrames; offset += kChunk){
+                const int len = std::min((int) kChunk, nFrames - offset);
+
+                for(int k = 0; k < strips; ++k){
+                    const T* in = level[first + k] + offset;
+                    for(int i = 0; i < len; ++i) x[i * strips + k] = in[i];
+                }
+
+                kernels->compressBank(x, x, len, strips, strips, s);
+
+                for(int k = 0; k < strips; ++k){
+                    T* out = grOut[first + k] + offset;
+                    for(int i = 0; i < len; ++i) out[i] = x[i * strips + k];
+                }
+            }
+        }
+    }
+
+private:
+    struct stripSettings{
+        double threshold = 0., ratio = 4., knee = 0.;
+        int mode = compressor::kCompressor;
+    };
+
+    int n;
+    double sr;
+    const dspKernels* kernels;
+
+    std::vector<T> env, timer, attack, release, hold;
+    std::vector<T> threshold, slope, kneeL, kneeU, kneeScale;
+    std::vector<stripSettings> settings;
+    std::vector<T> scratch;
+
+    //State of the strips from first on
+    compressorLanes<T> lanes(int first = 0){
+        const compressorLanes<T> s = {env.data() + first, timer.data() + first, attack.data() + first, release.data() + first, hold.data() + first,
+                                      threshold.data() + first, slope.data() + first, kneeL.data() + first, kneeU.data() + first, kneeScale.data() + first};
+        return s;
+    }
+
+    //Same curve as compressor's calcKnee() and calcSlope()
+    void updateCurve(int strip){
+        const stripSettings& c = settings[strip];
+        const double s = c.mode == compressor::kCompressor ? 1 - (1 / c.ratio) : 1;
+        const double kneeWidth = c.threshold * c.knee * -1.;
+        threshold[strip] = (T) c.threshold;
+        slope[strip] = (T) s;
+        kneeL[strip] = (T) (c.threshold - (kneeWidth / 2.));
+        kneeU[strip] = (T) (c.threshold + (kneeWidth / 2.));
+        kneeScale[strip] = (T) (kneeWidth > 0. ? -0.5 * s / kneeWidth : 0.);
+    }
+};
+
+#endif /* CompressorBank_h */
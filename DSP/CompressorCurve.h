@@ -0,0 +1,47 @@
+//
+//  CompressorCurve.h
+//
+//  Static curve settings (threshold, ratio, knee) of a compressor, published by the
+//  audio thread and picked up by the GUI at its own frame rate.
+//
+
+#ifndef CompressorCurve_h
+#define CompressorCurve_h
+
+#include <atomic>
+#include "EnvelopeFollower.h"
+
+class compressorCurve{
+public:
+    compressorCurve() : threshold(0.), ratio(1.), knee(0.) {}
+    
+    ~compressorCurve(){}
+    
+    //Audio thread. Call when the effective (smoothed) settings have changed
+    void publish(double thresholdDB, double newRatio, double newKnee){
+        threshold.store(thresholdDB, std::memory_order_relaxed);
+        ratio.store(newRatio, std::memory_order_relaxed);
+        knee.store(newKnee, std::memory_order_relaxed);
+    }
+    
+    //GUI thread. Copies the published settings into comp, returns false if comp was already up to date
+    bool update(compressor& comp) const{
+        double t = threshold.load(std::memory_order_relaxed);
+        double r = ratio.load(std::memory_order_relaxed);
+        double k = knee.load(std::memory_order_relaxed);
+        
+        if(t == comp.getThreshold() && r == comp.getRatio() && k == comp.getKnee()){
+            return false;
+        }
+        
+        comp.setThreshold(t);
+        comp.setRatio(r);
+        comp.setKnee(k);
+        return true;
+    }
+    
+private:
+    std::atomic<double> threshold, ratio, knee;
+};
+
+#endif /* CompressorCurve_h */
@@ -0,0 +1,670 @@
+//
+//  DCompEngine.cpp
+//
+//
+
+#include "DCompEngine.h"
+#include "DSPMath.h"
+#include <cstring>
+
+template <typename T>
+DCompEngineT<T>::DCompEngineT()
+: mSampleRate(44100.), mGain(0.), mThreshold(0.), mAttack(10.), mHold(0.), mRelease(250.), mRatio(4), mKnee(.5), mMix(1.), mCutoffLP(20000.), mCutoffHP(20.), mLookahead(5.), mRMSWindow(50.), mMode(kClean), mDetector(envFollower::kPeak), mControlInterval(1), mInterpolation(kInterpolateDB), mSidechainEnable(false), mSCAudition(false), mLPEnable(false), mHPEnable(false), mReferenceKernel(false), mChannels(kMaxChannels), mGroups(kMaxChannels), mLatency(0), mLookaheadLatency(0), mLimiterActive(false), mLinkMode(kLinkMax), mNumActive(1), mChannelsInUse(0), mFactor(1), mCurve(0), mGainTable(0), mMeterTap(0), mKernels(&getDSPKernels())
+{
+    static_assert(kSubBlockSize <= oversampler<T>::kMaxBlockSize, "sub-blocks must fit the oversampler");
+    mOversampling[kClean] = mOversampling[kColored] = mOversampling[kLimiter] = 1;
+
+    //Everything linked in group 0, which leads until the first process()
+    for(int c = 0; c < kMaxChannels; ++c){
+        mLinkGroup[c] = 0;
+        mLinkWeight[c] = 1.;
+        mLinkScale[c] = 1.;
+        mGroupActive[c] = c == 0;
+    }
+    mActiveGroups[0] = 0;
+
+    init(mSampleRate);
+}
+
+template <typename T>
+void DCompEngineT<T>::init(double sampleRate){
+    mSampleRate = sampleRate;
+
+    //Param Smoothers, started at their targets so nothing ramps in after a reset
+    mGainSmoother.init(5., mSampleRate);
+    mThresholdSmoother.init(5., mSampleRate);
+    mAttackSmoother.init(5., mSampleRate);
+    mReleaseSmoother.init(5., mSampleRate);
+    mHoldSmoother.init(5., mSampleRate);
+    mRatioSmoother.init(5., mSampleRate);
+    mMixSmoother.init(5., mSampleRate);
+    mHPSmoother.init(5., mSampleRate);
+    mLPSmoother.init(5., mSampleRate);
+    mKneeSmoother.init(5., mSampleRate);
+    mGainSmoother.reset(mGain);
+    mThresholdSmoother.reset(mThreshold);
+    mAttackSmoother.reset(mAttack);
+    mReleaseSmoother.reset(mRelease);
+    mHoldSmoother.reset(mHold);
+    mRatioSmoother.reset(mRatio);
+    mMixSmoother.reset(mMix);
+    mHPSmoother.reset(mCutoffHP);
+    mLPSmoother.reset(mCutoffLP);
+    mKneeSmoother.reset(mKnee);
+
+    //Initialize the compressor and limiter of every group, and allocate the delay lines for the
+    //longest lookahead and oversampling delay at this rate, both are applied on the next process()
+    const int maxLookahead = lookaheadLimiter::getLookaheadSamples(kMaxLookaheadMS, mSampleRate);
+    const int maxOversamplingLatency = oversampler<T>::getLatency(kMaxOversampling);
+    for(int g = 0; g < kMaxChannels; ++g){
+        linkGroup& group = mGroups[g];
+        group.comp.init(mAttack, mRelease, mHold, mRatio, mKnee, mSampleRate);
+        group.comp.setThreshold(mThreshold);
+        group.limiter.init(kMaxLookaheadMS, mSampleRate);
+        group.gainDelay.init(oversampler<T>::getUpLatency(kMaxOversampling));
+        group.lastGR = 0.;
+        group.lastGainDB = mGain;
+        group.lastGainAmp = 1;
+    }
+    prepareDetector();
+    if(mCurve) mCurve->publish(mThreshold, mRatio, mKnee);
+
+    for(int c = 0; c < kMaxChannels; ++c){
+        channelState& channel = mChannels[c];
+        channel.delay.init(maxLookahead);
+        channel.detectorDelay.init(maxLookahead + maxOversamplingLatency);
+        channel.dryDelay.init(maxOversamplingLatency);
+        channel.os.setFactor(1);
+        channel.lastSaturated = 0;
+    }
+    mLatency = mLookaheadLatency = 0;
+    mLimiterActive = false;
+    mFactor = 1;
+
+    //Initalize filters, fresh objects clear the filter state
+    for(int p = 0; p < kMaxChannels / 2; ++p){
+        mHighpass[p] = VAStateVariableFilter();
+        mHighpass[p].setSampleRate(mSampleRate);
+        mHighpass[p].setFilter(SVFHighpass, mCutoffHP, 0.707, 0.);
+        mLowpass[p] = VAStateVariableFilter();
+        mLowpass[p].setSampleRate(mSampleRate);
+        mLowpass[p].setFilter(SVFLowpass, mCutoffLP, 0.707, 0.);
+    }
+
+    if(mMeterTap) mMeterTap->reset();
+}
+
+template <typename T>
+void DCompEngineT<T>::prepareDetector(){
+    bool used[kMaxChannels] = {};
+    for(int c = 0; c < kMaxChannels; ++c) used[mLinkGroup[c]] = true;
+
+    for(int g = 0; g < kMaxChannels; ++g){
+        compressor& comp = mGroups[g].comp;
+        comp.initRMS(used[g] && mDetector == envFollower::kRMS ? kMaxRMSWindowMS : 0.);
+        comp.setDetectMode(mDetector);
+        comp.setRMSWindow(mRMSWindow);
+    }
+}
+
+template <typename T>
+void DCompEngineT<T>::allocateRMSRings(rmsRings& rings, double sampleRate, int groups){
+    rings.sampleRate = sampleRate;
+    const size_t length = envFollower::getRMSRingLength(kMaxRMSWindowMS, sampleRate);
+    for(int g = 0; g < kMaxChannels; ++g) std::vector<double>(g < groups ? length : 0).swap(rings.ring[g]);
+}
+
+template <typename T>
+void DCompEngineT<T>::swapRMSRings(rmsRings& rings){
+    if(rings.sampleRate != mSampleRate) return;
+    for(int g = 0; g < kMaxChannels; ++g){
+        compressor& comp = mGroups[g].comp;
+        if(!comp.canDetectRMS() && !rings.ring[g].empty()) comp.swapRMS(rings.ring[g]);
+    }
+}
+
+template <typename T>
+void DCompEngineT<T>::setLinkGroup(int channel, int group){
+    if(channel < 0 || channel >= kMaxChannels) return;
+    mLinkGroup[channel] = std::max(0, std::min(group, kMaxChannels - 1));
+}
+
+template <typename T>
+void DCompEngineT<T>::setLinkWeight(int channel, double weight){
+    if(channel < 0 || channel >= kMaxChannels) return;
+    mLinkWeight[channel] = std::max(0., weight);
+}
+
+template <typename T>
+int DCompEngineT<T>::getLatency(int mode, double lookaheadMS, double sampleRate, int oversampling){
+    const int lookahead = mode == kLimiter ? lookaheadLimiter::getLookaheadSamples(std::min<double>(lookaheadMS, kMaxLookaheadMS), sampleRate) : 0;
+    return lookahead + oversampler<T>::getLatency(oversampling);
+}
+
+template <typename T>
+void DCompEngineT<T>::setOversampling(int mode, int factor){
+    if(mode < kClean || mode > kLimiter) return;
+    //Rounded down to a power of two, as the oversampler does
+    int f = 1;
+    while(f < kMaxOversampling && f * 2 <= factor) f *= 2;
+    mOversampling[mode] = f;
+}
+
+template <typename T>
+void DCompEngineT<T>::setControlRate(int interval, int interpolation){
+    //Power of two no longer than a sub-block, so intervals line up with the sub-blocks
+    int i = 1;
+    while(i < kSubBlockSize && i * 2 <= interval) i *= 2;
+    mControlInterval = i;
+    mInterpolation = interpolation;
+}
+
+template <typename T>
+void DCompEngineT<T>::setCurve(compressorCurve* curve){
+    mCurve = curve;
+    compressor& lead = mGroups[mActiveGroups[0]].comp;
+    if(mCurve) mCurve->publish(lead.getThreshold(), lead.getRatio(), lead.getKnee());
+}
+
+//Works out which groups have channels among the first nChannels, and each channel's weight
+//in its group. Groups that just got channels take over the lead's parameters
+template <typename T>
+void DCompEngineT<T>::updateLinks(int nChannels){
+    bool used[kMaxChannels] = {};
+    double weightSum[kMaxChannels] = {};
+    for(int c = 0; c < nChannels; ++c){
+        used[mLinkGroup[c]] = true;
+        weightSum[mLinkGroup[c]] += mLinkWeight[c];
+    }
+
+    linkGroup& lead = mGroups[mActiveGroups[0]];
+    int active = 0;
+    for(int g = 0; g < kMaxChannels; ++g){
+        if(used[g] && !mGroupActive[g]) activateGroup(mGroups[g], lead);
+        if(used[g]) mActiveGroups[active++] = g;
+        mGroupSize[g] = 0;
+    }
+    for(int g = 0; g < kMaxChannels; ++g) mGroupActive[g] = used[g];
+    mNumActive = active;
+
+    for(int c = 0; c < nChannels; ++c){
+        const int g = mLinkGroup[c];
+        mGroupChannels[g][mGroupSize[g]++] = c;
+        if(mLinkMode == kLinkSum) mLinkScale[c] = weightSum[g] > 0. ? mLinkWeight[c] / weightSum[g] : 0.;
+        else mLinkScale[c] = mLinkWeight[c];
+    }
+
+    //Channel pairs that were idle pick up the sidechain filters' current cutoff
+    if(nChannels != mChannelsInUse){
+        for(int p = 1; p < kMaxChannels / 2; ++p){
+            if(mLowpass[p].getCutoff() != mLowpass[0].getCutoff()) mLowpass[p].setCutoffFreq(mLowpass[0].getCutoff());
+            if(mHighpass[p].getCutoff() != mHighpass[0].getCutoff()) mHighpass[p].setCutoffFreq(mHighpass[0].getCutoff());
+        }
+        mChannelsInUse = nChannels;
+    }
+}
+
+//The envelope is left where it was, only the parameters and the gain interpolation follow from
+template <typename T>
+void DCompEngineT<T>::activateGroup(linkGroup& group, linkGroup& from){
+    compressor& comp = group.comp;
+    comp.setAttack(from.comp.getAttack());
+    comp.setRelease(from.comp.getRelease());
+    comp.setHold(from.comp.getHold());
+    comp.setRatio(from.comp.getRatio());
+    comp.setThreshold(from.comp.getThreshold());
+    comp.setKnee(from.comp.getKnee());
+    comp.setDetectMode(mDetector);
+    if(comp.getRMSWindow() != mRMSWindow) comp.setRMSWindow(mRMSWindow);
+    group.lastGR = from.lastGR;
+    group.lastGainDB = from.lastGainDB;
+    group.lastGainAmp = from.lastGainAmp;
+}
+
+//Fills the group's gr and gainAmp from its linked level, gain computer (or limiter) at audio rate
+template <typename T>
+void DCompEngineT<T>::computeGain(linkGroup& group, int n){
+    if(mLimiterActive){
+        group.limiter.processBlock(group.level, group.gr, n);
+        mKernels->ampToDB(group.gr, group.gr, n);
+    }
+    else{
+        group.comp.processBlock(group.level, group.gr, n);
+    }
+
+    //Combine gain reduction and makeup gain, then convert the whole sub-block to linear gain at once
+    for(int s = 0; s < n; ++s){
+        group.gainAmp[s] = (T) (group.gr[s] + mMakeup[s]);
+    }
+    group.lastGR = group.gr[n - 1];
+    group.lastGainDB = group.gainAmp[n - 1];
+    mKernels->dbToAmp(group.gainAmp, group.gainAmp, n);
+}
+
+//Same as computeGain with the detector and gain computer run once per control interval.
+//Gain is interpolated between control points, in dB or in linear gain
+template <typename T>
+void DCompEngineT<T>::computeGainControlRate(linkGroup& group, int n){
+    const int points = group.comp.processControlBlock(group.level, group.controlGR, n, mControlInterval);
+
+    //Makeup gain is still smoothed per sample and sampled at the end of each interval
+    for(int s = 0, p = 0; s < n; ++s){
+        if(s == n - 1 || (s + 1) % mControlInterval == 0){
+            group.controlGain[p] = (T) (group.controlGR[p] + mMakeup[s]);
+            ++p;
+        }
+    }
+
+    //Linear interpolation converts only the control points, dB interpolation converts every sample afterwards
+    const bool linear = mInterpolation == kInterpolateLinear;
+    double lastGain = linear ? dbToAmp(group.lastGainDB) : group.lastGainDB;
+    group.lastGainDB = group.controlGain[points - 1];
+    if(linear) mKernels->dbToAmp(group.controlGain, group.controlGain, points);
+
+    for(int p = 0, s = 0; p < points; ++p){
+        const int len = std::min(mControlInterval, n - s);
+        const double grStep = (group.controlGR[p] - group.lastGR) / len;
+        const double gainStep = (group.controlGain[p] - lastGain) / len;
+        for(int k = 1; k <= len; ++k, ++s){
+            group.gr[s] = (T) (group.lastGR + grStep * k);
+            group.gainAmp[s] = (T) (lastGain + gainStep * k);
+        }
+        group.lastGR = group.controlGR[p];
+        lastGain = group.controlGain[p];
+    }
+
+    if(!linear) mKernels->dbToAmp(group.gainAmp, group.gainAmp, n);
+}
+
+//Saturation (in Colored mode) and gain at mFactor times the rate, writes each channel's wet
+//buffer. The upsampled audio lags by the up filters' delay, so each group's gain is
+//interpolated to the high rate and delayed to match. Interpolating towards each new value
+//already delays it by mFactor - 1
+template <typename T>
+template <bool Colored>
+void DCompEngineT<T>::processOversampled(const T* const* in, int nChannels, int n){
+    const int nOversampled = n * mFactor;
+    const T step = (T) 1 / mFactor;
+    for(int a = 0; a < mNumActive; ++a){
+        linkGroup& group = mGroups[mActiveGroups[a]];
+        T previous = group.lastGainAmp;
+        for(int s = 0, i = 0; s < n; ++s){
+            const T delta = (group.gainAmp[s] - previous) * step;
+            for(int p = 1; p <= mFactor; ++p, ++i) group.oversampledGain[i] = previous + delta * p;
+            previous = group.gainAmp[s];
+        }
+        group.gainDelay.process(group.oversampledGain, group.oversampledGain, nOversampled);
+    }
+
+    //Oversampling takes care of the aliasing, so the plain shaper is enough
+    const double upper = Colored ? dbToAmp(mThreshold * .9) : 0.;
+    const double lower = Colored ? -1 * dbToAmp(mThreshold) : 0.;
+    for(int c = 0; c < nChannels; ++c){
+        channelState& channel = mChannels[c];
+        channel.os.up(in[c], channel.oversampled, n);
+        if(Colored) mKernels->saturate(channel.oversampled, channel.oversampled, nOversampled, upper, lower);
+        channel.lastSaturated = in[c][n - 1];
+
+        mKernels->applyGain(channel.oversampled, mGroups[mLinkGroup[c]].oversampledGain, channel.oversampled, nOversampled);
+        channel.os.down(channel.oversampled, channel.wet, n);
+    }
+}
+
+//Processes one sub-block. Every flag is a template parameter, so each of the 32
+//configurations compiles to its own loops without per-sample branches on the flags
+template <typename T>
+template <bool Colored, bool Sidechain, bool LP, bool HP, bool Audition>
+void DCompEngineT<T>::processKernel(const T* const* in, const T* const* sc, T* const* out, int nChannels, int n){
+    //Filter samples for compressor envelope detector, each filter object runs a pair of channels.
+    //Both channels of a pair go through the loop together, so their independent filter
+    //recursions overlap. An odd last channel runs on its own
+    int c = 0;
+    for(; c + 1 < nChannels; c += 2){
+        const T* detL = Sidechain ? sc[c] : in[c];
+        const T* detR = Sidechain ? sc[c + 1] : in[c + 1];
+        T* detectorL = mChannels[c].detector;
+        T* detectorR = mChannels[c + 1].detector;
+        VAStateVariableFilter& lowpass = mLowpass[c >> 1];
+        VAStateVariableFilter& highpass = mHighpass[c >> 1];
+
+        for(int s = 0; s < n; ++s){
+            double sampleFilteredL = detL[s];
+            double sampleFilteredR = detR[s];
+            if(LP){
+                sampleFilteredL = lowpass.processAudioSample(sampleFilteredL, 0);
+                sampleFilteredR = lowpass.processAudioSample(sampleFilteredR, 1);
+            }
+            if(HP){
+                sampleFilteredL = highpass.processAudioSample(sampleFilteredL, 0);
+                sampleFilteredR = highpass.processAudioSample(sampleFilteredR, 1);
+            }
+            detectorL[s] = (T) sampleFilteredL;
+            detectorR[s] = (T) sampleFilteredR;
+        }
+    }
+    if(c < nChannels){
+        const T* det = Sidechain ? sc[c] : in[c];
+        T* detector = mChannels[c].detector;
+        for(int s = 0; s < n; ++s){
+            double sampleFiltered = det[s];
+            if(LP) sampleFiltered = mLowpass[c >> 1].processAudioSample(sampleFiltered, 0);
+            if(HP) sampleFiltered = mHighpass[c >> 1].processAudioSample(sampleFiltered, 0);
+            detector[s] = (T) sampleFiltered;
+        }
+    }
+
+    computeGroups(n);
+
+    //Dry signal of each channel, lined up with the gain
+    const T* dry[kMaxChannels] = {};
+    delayDry(in, dry, nChannels, n);
+
+    if(mFactor > 1){
+        //The wet signal comes back from the oversampler late, delay the dry signal to match
+        processOversampled<Colored>(dry, nChannels, n);
+        for(int c = 0; c < nChannels; ++c){
+            channelState& channel = mChannels[c];
+            channel.dryDelay.process(dry[c], channel.dry, n);
+            dry[c] = channel.dry;
+        }
+    }
+    else{
+        //Apply antialiased saturation, clip points only depend on the threshold. The shaper's
+        //previous input is tracked in every mode so switching to Colored starts from the right sample
+        const double upper = Colored ? dbToAmp(mThreshold * .9) : 0.;
+        const double lower = Colored ? -1 * dbToAmp(mThreshold) : 0.;
+        for(int c = 0; c < nChannels; ++c){
+            channelState& channel = mChannels[c];
+            const T* wetIn = dry[c];
+            if(Colored){
+                mKernels->saturateADAA(dry[c], channel.wet, n, upper, lower, &channel.lastSaturated);
+                wetIn = channel.wet;
+            }
+            else{
+                channel.lastSaturated = dry[c][n - 1];
+            }
+
+            //Apply gain reduction from compressor and makeup gain
+            mKernels->applyGain(wetIn, mGroups[mLinkGroup[c]].gainAmp, channel.wet, n);
+        }
+    }
+    for(int a = 0; a < mNumActive; ++a){
+        linkGroup& group = mGroups[mActiveGroups[a]];
+        group.lastGainAmp = group.gainAmp[n - 1];
+    }
+
+    //Feed the plot tap before the outputs are written, they may alias the inputs
+    feedMeter(dry, nChannels, n);
+
+    //If sidechain audition enabled, output the filtered detector signal
+    for(int c = 0; c < nChannels; ++c){
+        if(!Audition) mKernels->mixDryWet(dry[c], mChannels[c].wet, mMixAmount, out[c], n);
+        else memcpy(out[c], mChannels[c].detector, n * sizeof(T));
+    }
+}
+
+//The same sub-block as processKernel with the flags tested at every sample, as process() ran
+//before they were resolved per sub-block. Saturation and mix are done a sample at a time too,
+//so the output only matches processKernel's to rounding
+template <typename T>
+void DCompEngineT<T>::processReference(int config, const T* const* in, const T* const* sc, T* const* out, int nChannels, int n){
+    for(int s = 0; s < n; ++s){
+        for(int c = 0; c < nChannels; ++c){
+            double sampleFiltered = config & kKernelSidechain ? sc[c][s] : in[c][s];
+            if(config & kKernelLowpass) sampleFiltered = mLowpass[c >> 1].processAudioSample(sampleFiltered, c & 1);
+            if(config & kKernelHighpass) sampleFiltered = mHighpass[c >> 1].processAudioSample(sampleFiltered, c & 1);
+            mChannels[c].detector[s] = (T) sampleFiltered;
+        }
+    }
+
+    computeGroups(n);
+
+    const T* dry[kMaxChannels] = {};
+    delayDry(in, dry, nChannels, n);
+
+    if(mFactor > 1){
+        if(config & kKernelColored) processOversampled<true>(dry, nChannels, n);
+        else processOversampled<false>(dry, nChannels, n);
+        for(int c = 0; c < nChannels; ++c){
+            channelState& channel = mChannels[c];
+            channel.dryDelay.process(dry[c], channel.dry, n);
+            dry[c] = channel.dry;
+        }
+    }
+    else{
+        //The same block saturation as processKernel, so only the flag handling differs
+        const double upper = dbToAmp(mThreshold * .9);
+        const double lower = -1 * dbToAmp(mThreshold);
+        for(int c = 0; c < nChannels; ++c){
+            channelState& channel = mChannels[c];
+            if(config & kKernelColored) mKernels->saturateADAA(dry[c], channel.wet, n, upper, lower, &channel.lastSaturated);
+            else channel.lastSaturated = dry[c][n - 1];
+        }
+        for(int s = 0; s < n; ++s){
+            for(int c = 0; c < nChannels; ++c){
+                channelState& channel = mChannels[c];
+                const T wet = config & kKernelColored ? channel.wet[s] : dry[c][s];
+                channel.wet[s] = wet * mGroups[mLinkGroup[c]].gainAmp[s];
+            }
+        }
+    }
+    for(int a = 0; a < mNumActive; ++a){
+        linkGroup& group = mGroups[mActiveGroups[a]];
+        group.lastGainAmp = group.gainAmp[n - 1];
+    }
+
+    feedMeter(dry, nChannels, n);
+
+    for(int s = 0; s < n; ++s){
+        for(int c = 0; c < nChannels; ++c){
+            const T wet = mChannels[c].wet[s], mix = mMixAmount[s];
+            out[c][s] = config & kKernelAudition ? mChannels[c].detector[s] : wet * mix + dry[c][s] * (1 - mix);
+        }
+    }
+}
+
+//Smooths makeup gain and mix once for all groups, then links each group's channels into one
+//level and computes its gain reduction for the whole sub-block
+template <typename T>
+void DCompEngineT<T>::computeGroups(int n){
+    for(int s = 0; s < n; ++s){
+        mMakeup[s] = mGainSmoother.process(mGain);
+        mMixAmount[s] = (T) mMixSmoother.process(mMix);
+    }
+
+    const bool controlRate = mControlInterval > 1 && !mLimiterActive;
+    for(int a = 0; a < mNumActive; ++a){
+        const int g = mActiveGroups[a];
+        linkGroup& group = mGroups[g];
+        std::fill(group.level, group.level + n, (T) 0);
+        for(int i = 0; i < mGroupSize[g]; ++i){
+            const int c = mGroupChannels[g][i];
+            if(mLinkMode == kLinkSum) mKernels->linkSum(mChannels[c].detector, group.level, n, mLinkScale[c]);
+            else mKernels->linkMax(mChannels[c].detector, group.level, n, mLinkScale[c]);
+        }
+
+        if(controlRate) computeGainControlRate(group, n);
+        else computeGain(group, n);
+    }
+}
+
+//Points dry at each channel's input, or at the input delayed by the lookahead in Limiter mode,
+//and delays the detector signal (for audition) by the full latency
+template <typename T>
+void DCompEngineT<T>::delayDry(const T* const* in, const T** dry, int nChannels, int n){
+    for(int c = 0; c < nChannels; ++c){
+        channelState& channel = mChannels[c];
+        dry[c] = in[c];
+
+        //The limiter's gain is for audio one lookahead ago, delay the audio to match
+        if(mLimiterActive){
+            channel.delay.process(in[c], channel.delayed, n);
+            dry[c] = channel.delayed;
+        }
+
+        if(mLatency) channel.detectorDelay.process(channel.detector, channel.detector, n);
+    }
+}
+
+//The plot shows the first two channels and the first channel's gain reduction
+template <typename T>
+void DCompEngineT<T>::feedMeter(const T* const* dry, int nChannels, int n){
+    if(!mMeterTap) return;
+    const int second = nChannels > 1 ? 1 : 0;
+    const T* gr = mGroups[mLinkGroup[0]].gr;
+    for(int s = 0; s < n; ++s){
+        mMeterTap->write(dry[0][s], dry[second][s], mChannels[0].wet[s], mChannels[second].wet[s], gr[s]);
+    }
+}
+
+template <typename T>
+void DCompEngineT<T>::process(const T* in1, const T* in2, const T* sc1, const T* sc2, T* out1, T* out2, int nFrames){
+    const T* in[2] = {in1, in2};
+    const T* sc[2] = {sc1, sc2};
+    T* out[2] = {out1, out2};
+    process(in, sc1 && sc2 ? sc : 0, out, 2, nFrames);
+}
+
+template <typename T>
+void DCompEngineT<T>::process(const T* const* in, const T* const* sc, T* const* out, int nChannels, int nFrames){
+    nChannels = std::min(nChannels, (int) kMaxChannels);
+    if(nChannels <= 0) return;
+
+    //Without a sidechain the detector reads the main input, sc is never dereferenced
+    const bool sidechain = mSidechainEnable && sc;
+    if(!sidechain) sc = in;
+
+    updateLinks(nChannels);
+
+    //Entering or leaving Limiter mode or moving the lookahead changes the latency and restarts the limiter
+    const bool limiter = mMode == kLimiter;
+    const int lookahead = getLatency(mMode, mLookahead, mSampleRate);
+    if(limiter != mLimiterActive || lookahead != mLookaheadLatency){
+        mLimiterActive = limiter;
+        mLookaheadLatency = lookahead;
+        for(int g = 0; g < kMaxChannels; ++g) mGroups[g].limiter.setLookahead(lookahead);
+        for(int c = 0; c < kMaxChannels; ++c) mChannels[c].delay.setDelay(lookahead);
+    }
+
+    //A new oversampling factor restarts the oversamplers and changes the latency too
+    const int factor = getOversampling(mMode);
+    if(factor != mFactor){
+        mFactor = factor;
+        for(int c = 0; c < kMaxChannels; ++c){
+            mChannels[c].os.setFactor(factor);
+            mChannels[c].dryDelay.setDelay(oversampler<T>::getLatency(factor));
+        }
+        for(int g = 0; g < kMaxChannels; ++g) mGroups[g].gainDelay.setDelay(oversampler<T>::getUpLatency(factor) - (factor - 1));
+    }
+
+    const int latency = mLookaheadLatency + oversampler<T>::getLatency(mFactor);
+    if(latency != mLatency){
+        mLatency = latency;
+        for(int c = 0; c < kMaxChannels; ++c) mChannels[c].detectorDelay.setDelay(latency);
+    }
+
+    //The gain table can be swapped between blocks but not during one
+    const gainCurveTable* table = mGainTable ? mGainTable->acquire() : 0;
+    for(int a = 0; a < mNumActive; ++a) mGroups[mActiveGroups[a]].comp.setGainTable(table);
+
+    //Sidechain filter pairs with channels in this block
+    const int pairs = (nChannels + 1) / 2;
+
+    //Main processing loop, runs in sub-blocks of at most kSubBlockSize samples
+    for(int offset = 0; offset < nFrames; offset += kSubBlockSize){
+        const int n = std::min(kSubBlockSize, nFrames - offset);
+
+        /////////////////////////////////////////////////////////////////////////////////////////////////
+        //Parameter smoothing
+        //Compressor and filter coefficients are updated once per sub-block. The lead group's
+        //compressor tells whether a parameter is still moving, every active group follows it
+
+        bool curveChanged = false;
+        compressor& lead = mGroups[mActiveGroups[0]].comp;
+
+        if(lead.getAttack() != mAttack){
+            const double attack = mAttackSmoother.processBlock(mAttack, n);
+            for(int a = 0; a < mNumActive; ++a) mGroups[mActiveGroups[a]].comp.setAttack(attack);
+        }
+        if(lead.getRelease() != mRelease){
+            const double release = mReleaseSmoother.processBlock(mRelease, n);
+            for(int a = 0; a < mNumActive; ++a) mGroups[mActiveGroups[a]].comp.setRelease(release);
+        }
+        if(lead.getHold() != mHold){
+            const double hold = mHoldSmoother.processBlock(mHold, n);
+            for(int a = 0; a < mNumActive; ++a) mGroups[mActiveGroups[a]].comp.setHold(hold);
+        }
+        if(lead.getRatio() != mRatio){
+            const double ratio = mRatioSmoother.processBlock(mRatio, n);
+            for(int a = 0; a < mNumActive; ++a) mGroups[mActiveGroups[a]].comp.setRatio(ratio);
+            curveChanged = true;
+        }
+        if(lead.getThreshold() != mThreshold){
+            const double threshold = mThresholdSmoother.processBlock(mThreshold, n);
+            for(int a = 0; a < mNumActive; ++a) mGroups[mActiveGroups[a]].comp.setThreshold(threshold);
+            curveChanged = true;
+        }
+        if(lead.getKnee() != mKnee){
+            const double knee = mKneeSmoother.processBlock(mKnee, n);
+            for(int a = 0; a < mNumActive; ++a) mGroups[mActiveGroups[a]].comp.setKnee(knee);
+            curveChanged = true;
+        }
+        for(int a = 0; a < mNumActive; ++a){
+            linkGroup& group = mGroups[mActiveGroups[a]];
+            //Falls back to peak while the group has no RMS ring, see swapRMSRings()
+            if(group.comp.getDetectMode() != mDetector) group.comp.setDetectMode(mDetector);
+            if(group.comp.getRMSWindow() != mRMSWindow) group.comp.setRMSWindow(mRMSWindow);
+            if(mLimiterActive){
+                group.limiter.setCeiling(lead.getThreshold());
+                group.limiter.setRelease(lead.getRelease());
+            }
+        }
+        if(curveChanged && mCurve) mCurve->publish(lead.getThreshold(), lead.getRatio(), lead.getKnee());
+        if(mLowpass[0].getCutoff() != mCutoffLP){
+            const double cutoff = mLPSmoother.processBlock(mCutoffLP, n);
+            for(int p = 0; p < pairs; ++p) mLowpass[p].setCutoffFreq(cutoff);
+        }
+        if(mHighpass[0].getCutoff() != mCutoffHP){
+            const double cutoff = mHPSmoother.processBlock(mCutoffHP, n);
+            for(int p = 0; p < pairs; ++p) mHighpass[p].setCutoffFreq(cutoff);
+        }
+
+        //end parameter smoothing
+        /////////////////////////////////////////////////////////////////////////////////////////////////
+
+        //Resolve the processing flags once per sub-block and run the matching specialized kernel
+        const int config = (mMode == kColored ? kKernelColored : 0) | (sidechain ? kKernelSidechain : 0) | (mLPEnable ? kKernelLowpass : 0) | (mHPEnable ? kKernelHighpass : 0) | (mSCAudition ? kKernelAudition : 0);
+
+        const T* i[kMaxChannels];
+        const T* s[kMaxChannels];
+        T* o[kMaxChannels];
+        for(int c = 0; c < nChannels; ++c){
+            i[c] = in[c] + offset;
+            s[c] = sc[c] + offset;
+            o[c] = out[c] + offset;
+        }
+
+        if(mReferenceKernel){
+            processReference(config, i, s, o, nChannels, n);
+            continue;
+        }
+
+        switch(config){
+#define DCOMP_KERNEL_CASE(c) case c: processKernel<(c & kKernelColored) != 0, (c & kKernelSidechain) != 0, (c & kKernelLowpass) != 0, (c & kKernelHighpass) != 0, (c & kKernelAudition) != 0>(i, s, o, nChannels, n); break;
+            DCOMP_KERNEL_CASE(0)  DCOMP_KERNEL_CASE(1)  DCOMP_KERNEL_CASE(2)  DCOMP_KERNEL_CASE(3)
+            DCOMP_KERNEL_CASE(4)  DCOMP_KERNEL_CASE(5)  DCOMP_KERNEL_CASE(6)  DCOMP_KERNEL_CASE(7)
+            DCOMP_KERNEL_CASE(8)  DCOMP_KERNEL_CASE(9)  DCOMP_KERNEL_CASE(10) DCOMP_KERNEL_CASE(11)
+            DCOMP_KERNEL_CASE(12) DCOMP_KERNEL_CASE(13) DCOMP_KERNEL_CASE(14) DCOMP_KERNEL_CASE(15)
+            DCOMP_KERNEL_CASE(16) DCOMP_KERNEL_CASE(17) DCOMP_KERNEL_CASE(18) DCOMP_KERNEL_CASE(19)
+            DCOMP_KERNEL_CASE(20) DCOMP_KERNEL_CASE(21) DCOMP_KERNEL_CASE(22) DCOMP_KERNEL_CASE(23)
+            DCOMP_KERNEL_CASE(24) DCOMP_KERNEL_CASE(25) DCOMP_KERNEL_CASE(26) DCOMP_KERNEL_CASE(27)
+            DCOMP_KERNEL_CASE(28) DCOMP_KERNEL_CASE(29) DCOMP_KERNEL_CASE(30) DCOMP_KERNEL_CASE(31)
+#undef DCOMP_KERNEL_CASE
+        }
+    }
+
+    if(mGainTable) mGainTable->release();
+}
+
+template class DCompEngineT<double>;
+template class DCompEngineT<float>;
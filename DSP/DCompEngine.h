@@ -0,0 +1,303 @@
+//
+//  DCompEngine.h
+//
+//  The complete DComp processing chain (sidechain filters, compressor, saturation,
+//  makeup gain and mix) with no IPlug, GUI or Cairo dependency. The plugin wraps one
+//  of these, and the Makefile builds it on its own as libdcomp_dsp.
+//
+//  One engine processes 1 to kMaxChannels channels. Channels are split into link groups:
+//  each group runs one detector on the linked level of its channels and applies the same
+//  gain to all of them, so a fully linked immersive bus pays for one envelope and gain
+//  computer instead of one per channel. By default every channel is in group 0.
+//
+//  DCompEngineT<T> processes double or float buffers. Only the audio buffers and the
+//  block kernels follow T: parameter smoothing, envelope and filter state stay double in
+//  both, so the float engine tracks the double one to within float resolution.
+//  IPlug always hands the plugin doubles, so DComp uses DCompEngine (double); the float
+//  engine is for hosts and tools that already work in float.
+//
+
+#ifndef DCompEngine_h
+#define DCompEngine_h
+
+#include <vector>
+#include "CParamSmooth.h"
+#include "EnvelopeFollower.h"
+#include "MeterTap.h"
+#include "CompressorCurve.h"
+#include "GainCurveTable.h"
+#include "LookaheadLimiter.h"
+#include "Oversampler.h"
+#include "DSPKernels.h"
+#include "VAStateVariableFilter/VAStateVariableFilter.h"
+
+template <typename T>
+class DCompEngineT{
+public:
+    enum kMode{
+        kClean,
+        kColored,
+        kLimiter    //Brickwall at the threshold with lookahead, ratio, knee, attack and hold are unused
+    };
+
+    //How gain moves between control points when the gain computer runs at control rate
+    enum kInterpolation{
+        kInterpolateDB,
+        kInterpolateLinear
+    };
+
+    //Audio is processed in sub-blocks of at most this many samples
+    static const int kSubBlockSize = 64;
+
+    //Longest lookahead the Limiter mode allocates for
+    static const int kMaxLookaheadMS = 10;
+
+    //Longest RMS detector window
+    static const int kMaxRMSWindowMS = 300;
+
+    //Highest oversampling factor
+    static const int kMaxOversampling = 8;
+
+    //Most channels process() takes, enough for 7.1.4 and third order Ambisonics. Also the
+    //number of link groups
+    static const int kMaxChannels = 16;
+
+    //How a link group combines its channels into one detector level
+    enum kLink{
+        kLinkMax,   //Loudest channel, each scaled by its weight
+        kLinkSum    //Weighted mean of the channel levels, weights normalized over the group
+    };
+
+    DCompEngineT();
+
+    ~DCompEngineT(){}
+
+    //Sets the sample rate, recomputes every time constant and filter coefficient and clears
+    //all state. Parameters jump to their current targets. Allocates every buffer process()
+    //needs at this rate, so it is not real time safe; process() itself never allocates
+    void init(double sampleRate);
+
+    //Parameter setters. Not thread safe, call them from the thread that calls process().
+    //Continuous parameters are smoothed towards the new value inside process()
+    void setGain(double gainDB){ mGain = gainDB; }
+    void setThreshold(double thresholdDB){ mThreshold = thresholdDB; }
+    void setAttack(double attackMS){ mAttack = attackMS; }
+    void setRelease(double releaseMS){ mRelease = releaseMS; }
+    void setHold(double holdMS){ mHold = holdMS; }
+    void setRatio(double ratio){ mRatio = ratio; }
+    void setKnee(double knee){ mKnee = knee; }
+    void setMode(int mode){ mMode = mode; }
+    void setMix(double mix){ mMix = mix; }
+    void setSidechainEnable(bool enable){ mSidechainEnable = enable; }
+    void setSidechainAudition(bool enable){ mSCAudition = enable; }
+    void setCutoffLP(double cutoffHz){ mCutoffLP = cutoffHz; }
+    void setCutoffHP(double cutoffHz){ mCutoffHP = cutoffHz; }
+    void setLPEnable(bool enable){ mLPEnable = enable; }
+    void setHPEnable(bool enable){ mHPEnable = enable; }
+    void setLookahead(double lookaheadMS){ mLookahead = lookaheadMS; }
+    void setRMSWindow(double windowMS){ mRMSWindow = windowMS; }
+
+    //Runs saturation and gain in mode at factor (1, 2, 4 or 8, rounded down) times the sample rate, the detector
+    //stays at the base rate. Each mode keeps its own factor; a change restarts the oversampler
+    //and adds oversampler<T>::getLatency(factor) to the latency
+    void setOversampling(int mode, int factor);
+    int getOversampling(int mode) const { return mOversampling[std::max(0, std::min(mode, (int) kLimiter))]; }
+
+    //Peak or RMS detection, envFollower::kPeak or envFollower::kRMS. RMS needs a ring buffer in
+    //each link group. init() and prepareDetector() allocate them, swapRMSRings() hands over rings
+    //allocated elsewhere. A group without one detects peak until it gets one
+    void setDetector(int detector){ mDetector = detector; }
+
+    //Allocates the RMS buffers of the link groups that have channels when the RMS detector is
+    //selected and frees the rest. Not real time safe, call it where the host allows allocation
+    //(init() calls it too)
+    void prepareDetector();
+
+    //RMS rings for the longest window, one per link group, made for one sample rate
+    struct rmsRings{
+        double sampleRate;
+        std::vector<double> ring[kMaxChannels];
+    };
+
+    //Fills the first groups rings of rings for sampleRate. Allocates, call it off the audio thread
+    static void allocateRMSRings(rmsRings& rings, double sampleRate, int groups);
+
+    //Moves rings into the link groups that have none, so switching to RMS (or giving a group
+    //its first channel) takes effect in the next process(). Real time safe: rings gets back the
+    //empty buffers, free them off the audio thread. Does nothing if rings were made for
+    //another sample rate than init()'s
+    void swapRMSRings(rmsRings& rings);
+
+    //Detector linking, kLinkMax or kLinkSum
+    void setLinkMode(int mode){ mLinkMode = mode; }
+
+    //Puts channel in link group group (0 to kMaxChannels - 1). A group that had no channels
+    //takes over the others' parameters but starts from its own envelope
+    void setLinkGroup(int channel, int group);
+    int getLinkGroup(int channel) const { return mLinkGroup[std::max(0, std::min(channel, kMaxChannels - 1))]; }
+
+    //Weight of channel in its group's detector, 1 by default. 0 leaves the channel out of the
+    //detector, it still gets the group's gain
+    void setLinkWeight(int channel, double weight);
+
+    //Runs the detector and gain computer once every interval samples instead of every sample.
+    //interval is rounded down to a power of two up to kSubBlockSize, 1 is full rate (the default)
+    void setControlRate(int interval, int interpolation = kInterpolateDB);
+    int getControlInterval() const { return mControlInterval; }
+
+    //Runs every sub-block through a loop that tests the mode, sidechain, filter and audition
+    //flags at every sample instead of the kernel specialized for them. The saturation runs on
+    //the same block kernel in both, so dcomp-bench --kernels measures only the flag handling
+    void setReferenceKernel(bool enable){ mReferenceKernel = enable; }
+
+    //Optional plot tap, fed from process() when set. Pass 0 to disable
+    void setMeterTap(meterTap* tap){ mMeterTap = tap; }
+
+    //Optional curve, published from process() whenever threshold, ratio or knee move. Pass 0 to disable
+    void setCurve(compressorCurve* curve);
+
+    //Optional gain table. While set, the compressor reads its gain reduction from the newest
+    //table in the buffer instead of the closed form curve, so whoever calls table->update()
+    //decides the curve (typically from the compressorCurve this engine publishes). Pass 0 to disable
+    void setGainTable(gainCurveBuffer* table){ mGainTable = table; }
+
+    double getSampleRate() const { return mSampleRate; }
+
+    //Samples the output is currently delayed by: the lookahead in Limiter mode plus the oversampler's delay
+    int getLatency() const { return mLatency; }
+
+    //Latency the engine will have with these settings, for reporting it before process() runs
+    static int getLatency(int mode, double lookaheadMS, double sampleRate, int oversampling = 1);
+
+    //Processes nFrames of nChannels (1 to kMaxChannels) channels, one buffer per channel. sc
+    //holds one sidechain buffer per channel, it is only read when the sidechain is enabled and
+    //may be 0, which runs without one. out[c] may alias in[c]
+    void process(const T* const* in, const T* const* sc, T* const* out, int nChannels, int nFrames);
+
+    //Stereo, sc1 and sc2 may be 0 while the sidechain is disabled
+    void process(const T* in1, const T* in2, const T* sc1, const T* sc2, T* out1, T* out2, int nFrames);
+
+private:
+    //Flags selecting a processKernel specialization
+    enum EKernelFlags{
+        kKernelColored = 1,
+        kKernelSidechain = 2,
+        kKernelLowpass = 4,
+        kKernelHighpass = 8,
+        kKernelAudition = 16
+    };
+
+    //Per channel state and sub-block buffers: the filtered detector signal, the delayed input
+    //in Limiter mode, the dry signal delayed to match the oversampler, the processed (wet)
+    //signal and the oversampled audio
+    struct channelState{
+        delayLine<T> delay, detectorDelay, dryDelay;
+        oversampler<T> os;
+
+        //Previous input sample of the saturator, for antiderivative antialiasing
+        T lastSaturated;
+
+        T detector[kSubBlockSize];
+        T delayed[kSubBlockSize];
+        T dry[kSubBlockSize];
+        T wet[kSubBlockSize];
+        T oversampled[kSubBlockSize * kMaxOversampling];
+    };
+
+    //Per link group state: the detector, the linked level, gain reduction (dB) and total
+    //linear gain, and the gain at the oversampled rate delayed to line up with the upsampled audio
+    struct linkGroup{
+        compressor comp;
+        lookaheadLimiter limiter;
+        delayLine<T> gainDelay;
+
+        T level[kSubBlockSize];
+        T gr[kSubBlockSize];
+        T gainAmp[kSubBlockSize];
+        T oversampledGain[kSubBlockSize * kMaxOversampling];
+
+        //Control rate gain reduction (dB) and total gain at each control point, plus the values
+        //at the last sample processed, where interpolation resumes
+        T controlGR[kSubBlockSize];
+        T controlGain[kSubBlockSize];
+        double lastGR, lastGainDB;
+        T lastGainAmp;
+    };
+
+    void updateLinks(int nChannels);
+    void activateGroup(linkGroup& group, linkGroup& from);
+
+    void computeGain(linkGroup& group, int n);
+    void computeGainControlRate(linkGroup& group, int n);
+
+    template <bool Colored>
+    void processOversampled(const T* const* in, int nChannels, int n);
+
+    template <bool Colored, bool Sidechain, bool LP, bool HP, bool Audition>
+    void processKernel(const T* const* in, const T* const* sc, T* const* out, int nChannels, int n);
+    void processReference(int config, const T* const* in, const T* const* sc, T* const* out, int nChannels, int n);
+
+    void computeGroups(int n);
+    void delayDry(const T* const* in, const T** dry, int nChannels, int n);
+    void feedMeter(const T* const* dry, int nChannels, int n);
+
+    double mSampleRate;
+
+    //Parameter targets
+    double mGain, mThreshold, mAttack, mHold, mRelease, mRatio, mKnee, mMix, mCutoffLP, mCutoffHP, mLookahead, mRMSWindow;
+    int mMode, mDetector, mControlInterval, mInterpolation;
+    bool mSidechainEnable, mSCAudition, mLPEnable, mHPEnable, mReferenceKernel;
+
+    //kMaxChannels of each, allocated once by the constructor. The channel delays hold the
+    //lookahead in Limiter mode, the full latency for the detector signal (for audition) and
+    //the oversampler's delay for the dry signal
+    std::vector<channelState> mChannels;
+    std::vector<linkGroup> mGroups;
+    int mLatency, mLookaheadLatency;
+    bool mLimiterActive;
+
+    //Link settings, and the groups that had channels in the last process(): their indices, each
+    //one's channels and every channel's scaled weight. The first active group is the lead, whose
+    //compressor holds the current parameters for the curve and for groups that become active
+    int mLinkMode;
+    int mLinkGroup[kMaxChannels];
+    double mLinkWeight[kMaxChannels];
+    int mActiveGroups[kMaxChannels], mNumActive;
+    bool mGroupActive[kMaxChannels];
+    int mGroupChannels[kMaxChannels][kMaxChannels], mGroupSize[kMaxChannels];
+    double mLinkScale[kMaxChannels];
+    int mChannelsInUse;
+
+    //Oversampling factor per mode and the one in use
+    int mOversampling[3], mFactor;
+    compressorCurve* mCurve;
+    gainCurveBuffer* mGainTable;
+    meterTap* mMeterTap;
+
+    //Block kernels for this CPU, picked at construction
+    const dspKernels* mKernels;
+
+    //Sidechain filters, each filters a pair of channels
+    VAStateVariableFilter mLowpass[kMaxChannels / 2];
+    VAStateVariableFilter mHighpass[kMaxChannels / 2];
+
+    //Sub-block makeup gain (dB) and smoothed mix, shared by all groups
+    double mMakeup[kSubBlockSize];
+    T mMixAmount[kSubBlockSize];
+
+    CParamSmooth mGainSmoother;
+    CParamSmooth mThresholdSmoother;
+    CParamSmooth mAttackSmoother;
+    CParamSmooth mReleaseSmoother;
+    CParamSmooth mHoldSmoother;
+    CParamSmooth mRatioSmoother;
+    CParamSmooth mKneeSmoother;
+    CParamSmooth mMixSmoother;
+    CParamSmooth mHPSmoother;
+    CParamSmooth mLPSmoother;
+};
+
+typedef DCompEngineT<double> DCompEngine;
+typedef DCompEngineT<float> DCompEngineFloat;
+
+#endif /* DCompEngine_h */
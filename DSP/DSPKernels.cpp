@@ -0,0 +1,128 @@
+//
+//  DSPKernels.cpp
+//
+//  Scalar reference kernels and runtime tier selection.
+//
+
+#include "DSPKernelsImpl.h"
+#include <stdlib.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define DSPKERNELS_X86 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace{
+
+#ifdef DSPKERNELS_X86
+    void cpuid(unsigned int leaf, unsigned int subleaf, unsigned int regs[4]){
+#if defined(_MSC_VER)
+        __cpuidex((int*) regs, (int) leaf, (int) subleaf);
+#else
+        __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+    }
+
+    //Register state the OS saves on context switch, AVX is unusable without it
+    unsigned long long xgetbv0(){
+#if defined(_MSC_VER)
+        return _xgetbv(0);
+#else
+        unsigned int eax, edx;
+        __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+        return ((unsigned long long) edx << 32) | eax;
+#endif
+    }
+#endif
+
+    int detectTier(){
+#ifdef DSPKERNELS_X86
+        unsigned int regs[4] = {0, 0, 0, 0};
+        cpuid(0, 0, regs);
+        const unsigned int maxLeaf = regs[0];
+
+        cpuid(1, 0, regs);
+        const bool sse2 = (regs[3] >> 26) & 1;
+        const bool osxsave = (regs[2] >> 27) & 1;
+        const bool avx = (regs[2] >> 28) & 1;
+        const bool fma = (regs[2] >> 12) & 1;
+        if(!sse2) return kTierScalar;
+
+        const unsigned long long xcr0 = osxsave ? xgetbv0() : 0;
+        const bool osAVX = (xcr0 & 0x6) == 0x6;
+        const bool osAVX512 = (xcr0 & 0xE6) == 0xE6;
+
+        bool avx2 = false, avx512f = false;
+        if(maxLeaf >= 7){
+            cpuid(7, 0, regs);
+            avx2 = (regs[1] >> 5) & 1;
+            avx512f = (regs[1] >> 16) & 1;
+        }
+
+        if(avx512f && osAVX512) return kTierAVX512;
+        if(avx && avx2 && fma && osAVX) return kTierAVX2;
+        return kTierSSE2;
+#else
+        return kTierScalar;
+#endif
+    }
+
+    struct kernelTable{
+        dspKernels tiers[kNumDSPTiers];
+        bool available[kNumDSPTiers];
+        int supported;
+        int selected;
+
+        kernelTable(){
+            supported = detectTier();
+
+            tiers[kTierScalar] = makeKernels<vecScalar<double>, vecScalar<float> >(kTierScalar, "scalar");
+            available[kTierScalar] = true;
+            available[kTierSSE2] = supported >= kTierSSE2 && makeDSPKernelsSSE2(tiers[kTierSSE2]);
+            available[kTierAVX2] = supported >= kTierAVX2 && makeDSPKernelsAVX2(tiers[kTierAVX2]);
+            available[kTierAVX512] = supported >= kTierAVX512 && makeDSPKernelsAVX512(tiers[kTierAVX512]);
+
+            //DCOMP_SIMD caps the tier for A/B comparisons
+            int cap = kNumDSPTiers - 1;
+            if(const char* force = getenv("DCOMP_SIMD")){
+                for(int t = 0; t < kNumDSPTiers; ++t){
+                    if(!strcmp(force, tierName(t))) cap = t;
+                }
+            }
+
+            selected = kTierScalar;
+            for(int t = 0; t <= cap; ++t){
+                if(available[t]) selected = t;
+            }
+        }
+
+        static const char* tierName(int tier){
+            static const char* names[kNumDSPTiers] = {"scalar", "sse2", "avx2", "avx512"};
+            return names[tier];
+        }
+    };
+
+    const kernelTable& getTable(){
+        static kernelTable table;
+        return table;
+    }
+}
+
+const dspKernels& getDSPKernels(){
+    const kernelTable& table = getTable();
+    return table.tiers[table.selected];
+}
+
+const dspKernels* getDSPKernels(int tier){
+    const kernelTable& table = getTable();
+    if(tier < 0 || tier >= kNumDSPTiers || !table.available[tier]) return 0;
+    return &table.tiers[tier];
+}
+
+int getSupportedDSPTier(){
+    return getTable().supported;
+}
@@ -0,0 +1,128 @@
+//
+//  DSPKernels.h
+//
+//  Block kernels for the hot loops, compiled once per instruction set and picked at
+//  runtime from CPUID. Set DCOMP_SIMD=scalar|sse2|avx2|avx512 to force a tier (it is
+//  lowered to the best one the machine supports).
+//
+//  Error bounds, every tier, measured against libm:
+//    ampToDB: absolute error < 1e-11 dB (double), < 5e-5 dB (float). Inputs are taken as |x|,
+//             anything below the smallest normal (including 0) reads as -6153 dB (double)
+//             or -758 dB (float) instead of -inf
+//    dbToAmp: relative error < 1e-11 (double), < 2e-6 (float). Inputs are clamped to the
+//             normal range, about +-6150 dB (double) or +-760 dB (float)
+//  The other kernels are plain arithmetic. Tiers with FMA can differ from the scalar
+//  tier in the last bits.
+//
+
+#ifndef DSPKernels_h
+#define DSPKernels_h
+
+enum kDSPTier{
+    kTierScalar,
+    kTierSSE2,
+    kTierAVX2,
+    kTierAVX512,
+    kNumDSPTiers
+};
+
+//Per lane state and settings of a bank of independent peak compressors, one array entry per
+//lane, see compressorBank. env and timer are updated by compressBank(), the rest only read
+template <typename S>
+struct compressorLanes{
+    S* env;             //Envelope, linear
+    S* timer;           //Samples held since the last attack
+    const S* attack;    //Envelope coefficients, as in envFollower
+    const S* release;
+    const S* hold;      //Hold in whole samples
+    const S* threshold; //Gain computer settings, as passed to gainComputer()
+    const S* slope;
+    const S* kneeL;
+    const S* kneeU;
+    const S* kneeScale;
+};
+
+//All kernels accept in == out. Each exists for double and float samples, call them
+//through the overloaded members, the pointers are filled per tier
+struct dspKernels{
+    int tier;
+    const char* name;
+
+    //20*log10(|x|) and 10^(x/20)
+    void ampToDB(const double* in, double* out, int n) const { ampToDB64(in, out, n); }
+    void ampToDB(const float* in, float* out, int n) const { ampToDB32(in, out, n); }
+    void dbToAmp(const double* in, double* out, int n) const { dbToAmp64(in, out, n); }
+    void dbToAmp(const float* in, float* out, int n) const { dbToAmp32(in, out, n); }
+
+    //Static compressor curve, envelope in dB to gain reduction in dB, see compressor::processBlock
+    void gainComputer(const double* envDB, double* grOut, int n, double threshold, double slope, double kneeL, double kneeU, double kneeScale) const { gainComputer64(envDB, grOut, n, threshold, slope, kneeL, kneeU, kneeScale); }
+    void gainComputer(const float* envDB, float* grOut, int n, double threshold, double slope, double kneeL, double kneeU, double kneeScale) const { gainComputer32(envDB, grOut, n, threshold, slope, kneeL, kneeU, kneeScale); }
+
+    //Colored mode saturation, atan shaping outside [lower, upper]
+    void saturate(const double* in, double* out, int n, double upper, double lower) const { saturate64(in, out, n, upper, lower); }
+    void saturate(const float* in, float* out, int n, double upper, double lower) const { saturate32(in, out, n, upper, lower); }
+
+    //The same curve with first order antiderivative antialiasing, the distortion lags the input by
+    //half a sample. last is the previous input sample, updated on return
+    void saturateADAA(const double* in, double* out, int n, double upper, double lower, double* last) const { saturateADAA64(in, out, n, upper, lower, last); }
+    void saturateADAA(const float* in, float* out, int n, double upper, double lower, float* last) const { saturateADAA32(in, out, n, upper, lower, last); }
+
+    //out[k] = sum of coeffs[i] * in[k - i] for i < taps. in[-taps + 1] to in[-1] must hold the
+    //history, out must not overlap in
+    void fir(const double* in, double* out, int n, const double* coeffs, int taps) const { fir64(in, out, n, coeffs, taps); }
+    void fir(const float* in, float* out, int n, const double* coeffs, int taps) const { fir32(in, out, n, coeffs, taps); }
+
+    //Detector linking, level = max(level, weight * |in|) and level = level + weight * |in|
+    void linkMax(const double* in, double* level, int n, double weight) const { linkMax64(in, level, n, weight); }
+    void linkMax(const float* in, float* level, int n, double weight) const { linkMax32(in, level, n, weight); }
+    void linkSum(const double* in, double* level, int n, double weight) const { linkSum64(in, level, n, weight); }
+    void linkSum(const float* in, float* level, int n, double weight) const { linkSum32(in, level, n, weight); }
+
+    //Runs lanes compressors side by side, a register of lanes per instruction. level and grOut are
+    //frame major, sample i of lane k at i * stride + k, and grOut gets the gain reduction in dB
+    void compressBank(const double* level, double* grOut, int n, int stride, int lanes, const compressorLanes<double>& s) const { compressBank64(level, grOut, n, stride, lanes, s); }
+    void compressBank(const float* level, float* grOut, int n, int stride, int lanes, const compressorLanes<float>& s) const { compressBank32(level, grOut, n, stride, lanes, s); }
+
+    //out = in * gain
+    void applyGain(const double* in, const double* gain, double* out, int n) const { applyGain64(in, gain, out, n); }
+    void applyGain(const float* in, const float* gain, float* out, int n) const { applyGain32(in, gain, out, n); }
+
+    //out = wet * mix + dry * (1 - mix)
+    void mixDryWet(const double* dry, const double* wet, const double* mix, double* out, int n) const { mixDryWet64(dry, wet, mix, out, n); }
+    void mixDryWet(const float* dry, const float* wet, const float* mix, float* out, int n) const { mixDryWet32(dry, wet, mix, out, n); }
+
+    void (*ampToDB64)(const double* in, double* out, int n);
+    void (*dbToAmp64)(const double* in, double* out, int n);
+    void (*gainComputer64)(const double* envDB, double* grOut, int n, double threshold, double slope, double kneeL, double kneeU, double kneeScale);
+    void (*saturate64)(const double* in, double* out, int n, double upper, double lower);
+    void (*saturateADAA64)(const double* in, double* out, int n, double upper, double lower, double* last);
+    void (*fir64)(const double* in, double* out, int n, const double* coeffs, int taps);
+    void (*linkMax64)(const double* in, double* level, int n, double weight);
+    void (*linkSum64)(const double* in, double* level, int n, double weight);
+    void (*compressBank64)(const double* level, double* grOut, int n, int stride, int lanes, const compressorLanes<double>& s);
+    void (*applyGain64)(const double* in, const double* gain, double* out, int n);
+    void (*mixDryWet64)(const double* dry, const double* wet, const double* mix, double* out, int n);
+
+    void (*ampToDB32)(const float* in, float* out, int n);
+    void (*dbToAmp32)(const float* in, float* out, int n);
+    void (*gainComputer32)(const float* envDB, float* grOut, int n, double threshold, double slope, double kneeL, double kneeU, double kneeScale);
+    void (*saturate32)(const float* in, float* out, int n, double upper, double lower);
+    void (*saturateADAA32)(const float* in, float* out, int n, double upper, double lower, float* last);
+    void (*fir32)(const float* in, float* out, int n, const double* coeffs, int taps);
+    void (*linkMax32)(const float* in, float* level, int n, double weight);
+    void (*linkSum32)(const float* in, float* level, int n, double weight);
+    void (*compressBank32)(const float* level, float* grOut, int n, int stride, int lanes, const compressorLanes<float>& s);
+    void (*applyGain32)(const float* in, const float* gain, float* out, int n);
+    void (*mixDryWet32)(const float* dry, const float* wet, const float* mix, float* out, int n);
+};
+
+//Kernels selected for this process. Chosen on first call, safe to call from any thread
+const dspKernels& getDSPKernels();
+
+//Kernels for a specific tier, 0 if this build or this CPU does not support it
+const dspKernels* getDSPKernels(int tier);
+
+//Best tier this CPU and OS support
+int getSupportedDSPTier();
+
+#endif /* DSPKernels_h */
@@ -0,0 +1,94 @@
+//
+//  DSPKernelsAVX2.cpp
+//
+//  Four doubles or eight floats per register, with FMA. Build this file with -mavx2 -mfma (/arch:AVX2 on MSVC),
+//  it is only called after getDSPKernels() has checked the CPU.
+//
+
+#include "DSPKernelsImpl.h"
+
+#if defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))
+#include <immintrin.h>
+
+namespace{
+    struct vecAVX2{
+        typedef double scalar;
+        typedef __m256d type;
+        typedef __m256i itype;
+        typedef __m256d mask;
+        enum{ width = 4 };
+
+        static inline type set1(double x){ return _mm256_set1_pd(x); }
+        static inline type load(const double* p){ return _mm256_loadu_pd(p); }
+        static inline void store(double* p, type x){ _mm256_storeu_pd(p, x); }
+        static inline type add(type a, type b){ return _mm256_add_pd(a, b); }
+        static inline type sub(type a, type b){ return _mm256_sub_pd(a, b); }
+        static inline type mul(type a, type b){ return _mm256_mul_pd(a, b); }
+        static inline type div(type a, type b){ return _mm256_div_pd(a, b); }
+        static inline type madd(type a, type b, type c){ return _mm256_fmadd_pd(a, b, c); }
+        static inline type min(type a, type b){ return _mm256_min_pd(a, b); }
+        static inline type max(type a, type b){ return _mm256_max_pd(a, b); }
+
+        static inline mask cmpgt(type a, type b){ return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+        static inline mask cmplt(type a, type b){ return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+        static inline mask andm(mask a, mask b){ return _mm256_and_pd(a, b); }
+        static inline mask orm(mask a, mask b){ return _mm256_or_pd(a, b); }
+        static inline type select(mask m, type a, type b){ return _mm256_blendv_pd(b, a, m); }
+
+        static inline itype asInt(type x){ return _mm256_castpd_si256(x); }
+        static inline type asFloat(itype i){ return _mm256_castsi256_pd(i); }
+        static inline itype set1i(uint64_t x){ return _mm256_set1_epi64x((long long) x); }
+        static inline itype andi(itype a, itype b){ return _mm256_and_si256(a, b); }
+        static inline itype ori(itype a, itype b){ return _mm256_or_si256(a, b); }
+        static inline itype addi(itype a, itype b){ return _mm256_add_epi64(a, b); }
+        template <int S> static inline itype shr(itype a){ return _mm256_srli_epi64(a, S); }
+        template <int S> static inline itype shl(itype a){ return _mm256_slli_epi64(a, S); }
+    };
+
+    struct vecAVX2f{
+        typedef float scalar;
+        typedef __m256 type;
+        typedef __m256i itype;
+        typedef __m256 mask;
+        enum{ width = 8 };
+
+        static inline type set1(float x){ return _mm256_set1_ps(x); }
+        static inline type load(const float* p){ return _mm256_loadu_ps(p); }
+        static inline void store(float* p, type x){ _mm256_storeu_ps(p, x); }
+        static inline type add(type a, type b){ return _mm256_add_ps(a, b); }
+        static inline type sub(type a, type b){ return _mm256_sub_ps(a, b); }
+        static inline type mul(type a, type b){ return _mm256_mul_ps(a, b); }
+        static inline type div(type a, type b){ return _mm256_div_ps(a, b); }
+        static inline type madd(type a, type b, type c){ return _mm256_fmadd_ps(a, b, c); }
+        static inline type min(type a, type b){ return _mm256_min_ps(a, b); }
+        static inline type max(type a, type b){ return _mm256_max_ps(a, b); }
+
+        static inline mask cmpgt(type a, type b){ return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+        static inline mask cmplt(type a, type b){ return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+        static inline mask andm(mask a, mask b){ return _mm256_and_ps(a, b); }
+        static inline mask orm(mask a, mask b){ return _mm256_or_ps(a, b); }
+        static inline type select(mask m, type a, type b){ return _mm256_blendv_ps(b, a, m); }
+
+        static inline itype asInt(type x){ return _mm256_castps_si256(x); }
+        static inline type asFloat(itype i){ return _mm256_castsi256_ps(i); }
+        static inline itype set1i(uint32_t x){ return _mm256_set1_epi32((int) x); }
+        static inline itype andi(itype a, itype b){ return _mm256_and_si256(a, b); }
+        static inline itype ori(itype a, itype b){ return _mm256_or_si256(a, b); }
+        static inline itype addi(itype a, itype b){ return _mm256_add_epi32(a, b); }
+        template <int S> static inline itype shr(itype a){ return _mm256_srli_epi32(a, S); }
+        template <int S> static inline itype shl(itype a){ return _mm256_slli_epi32(a, S); }
+    };
+}
+
+bool makeDSPKernelsAVX2(dspKernels& k){
+    k = makeKernels<vecAVX2, vecAVX2f>(kTierAVX2, "avx2");
+    return true;
+}
+
+#else
+
+bool makeDSPKernelsAVX2(dspKernels& k){
+    return false;
+}
+
+#endif
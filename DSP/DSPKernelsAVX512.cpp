@@ -0,0 +1,106 @@
+//
+//  DSPKernelsAVX512.cpp
+//
+//  Eight doubles or sixteen floats per register, AVX-512F only. Build this file with -mavx512f -mfma
+//  (/arch:AVX512 on MSVC), it is only called after getDSPKernels() has checked the CPU.
+//
+
+#include "DSPKernelsImpl.h"
+
+#if defined(__AVX512F__)
+
+//GCC 12 reports '__Y' may be used uninitialized inside avx512fintrin.h for the masked
+//intrinsics' undefined passthrough operands, a false positive in the header itself
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+#include <immintrin.h>
+
+namespace{
+    struct vecAVX512{
+        typedef double scalar;
+        typedef __m512d type;
+        typedef __m512i itype;
+        typedef __mmask8 mask;
+        enum{ width = 8 };
+
+        static inline type set1(double x){ return _mm512_set1_pd(x); }
+        static inline type load(const double* p){ return _mm512_loadu_pd(p); }
+        static inline void store(double* p, type x){ _mm512_storeu_pd(p, x); }
+        static inline type add(type a, type b){ return _mm512_add_pd(a, b); }
+        static inline type sub(type a, type b){ return _mm512_sub_pd(a, b); }
+        static inline type mul(type a, type b){ return _mm512_mul_pd(a, b); }
+        static inline type div(type a, type b){ return _mm512_div_pd(a, b); }
+        static inline type madd(type a, type b, type c){ return _mm512_fmadd_pd(a, b, c); }
+        static inline type min(type a, type b){ return _mm512_min_pd(a, b); }
+        static inline type max(type a, type b){ return _mm512_max_pd(a, b); }
+
+        static inline mask cmpgt(type a, type b){ return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ); }
+        static inline mask cmplt(type a, type b){ return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ); }
+        static inline mask andm(mask a, mask b){ return a & b; }
+        static inline mask orm(mask a, mask b){ return a | b; }
+        static inline type select(mask m, type a, type b){ return _mm512_mask_blend_pd(m, b, a); }
+
+        static inline itype asInt(type x){ return _mm512_castpd_si512(x); }
+        static inline type asFloat(itype i){ return _mm512_castsi512_pd(i); }
+        static inline itype set1i(uint64_t x){ return _mm512_set1_epi64((long long) x); }
+        static inline itype andi(itype a, itype b){ return _mm512_and_si512(a, b); }
+        static inline itype ori(itype a, itype b){ return _mm512_or_si512(a, b); }
+        static inline itype addi(itype a, itype b){ return _mm512_add_epi64(a, b); }
+        template <int S> static inline itype shr(itype a){ return _mm512_srli_epi64(a, S); }
+        template <int S> static inline itype shl(itype a){ return _mm512_slli_epi64(a, S); }
+    };
+
+    struct vecAVX512f{
+        typedef float scalar;
+        typedef __m512 type;
+        typedef __m512i itype;
+        typedef __mmask16 mask;
+        enum{ width = 16 };
+
+        static inline type set1(float x){ return _mm512_set1_ps(x); }
+        static inline type load(const float* p){ return _mm512_loadu_ps(p); }
+        static inline void store(float* p, type x){ _mm512_storeu_ps(p, x); }
+        static inline type add(type a, type b){ return _mm512_add_ps(a, b); }
+        static inline type sub(type a, type b){ return _mm512_sub_ps(a, b); }
+        static inline type mul(type a, type b){ return _mm512_mul_ps(a, b); }
+        static inline type div(type a, type b){ return _mm512_div_ps(a, b); }
+        static inline type madd(type a, type b, type c){ return _mm512_fmadd_ps(a, b, c); }
+        static inline type min(type a, type b){ return _mm512_min_ps(a, b); }
+        static inline type max(type a, type b){ return _mm512_max_ps(a, b); }
+
+        static inline mask cmpgt(type a, type b){ return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+        static inline mask cmplt(type a, type b){ return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+        static inline mask andm(mask a, mask b){ return a & b; }
+        static inline mask orm(mask a, mask b){ return a | b; }
+        static inline type select(mask m, type a, type b){ return _mm512_mask_blend_ps(m, b, a); }
+
+        static inline itype asInt(type x){ return _mm512_castps_si512(x); }
+        static inline type asFloat(itype i){ return _mm512_castsi512_ps(i); }
+        static inline itype set1i(uint32_t x){ return _mm512_set1_epi32((int) x); }
+        static inline itype andi(itype a, itype b){ return _mm512_and_si512(a, b); }
+        static inline itype ori(itype a, itype b){ return _mm512_or_si512(a, b); }
+        static inline itype addi(itype a, itype b){ return _mm512_add_epi32(a, b); }
+        template <int S> static inline itype shr(itype a){ return _mm512_srli_epi32(a, S); }
+        template <int S> static inline itype shl(itype a){ return _mm512_slli_epi32(a, S); }
+    };
+}
+
+bool makeDSPKernelsAVX512(dspKernels& k){
+    k = makeKernels<vecAVX512, vecAVX512f>(kTierAVX512, "avx512");
+    return true;
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#else
+
+bool makeDSPKernelsAVX512(dspKernels& k){
+    return false;
+}
+
+#endif
@@ -0,0 +1,408 @@
+//
+//  DSPKernelsImpl.h
+//
+//  Generic kernel bodies, written once against a small vector interface (V) and
+//  instantiated by each DSPKernels*.cpp with that file's instruction set, for both
+//  float and double lanes.
+//
+//  Only include this from the DSPKernels*.cpp files. Everything here has internal
+//  linkage on purpose: the files are built with different -m flags, and a shared
+//  inline symbol could let the linker pick an AVX copy for the scalar path.
+//  For the same reason nothing here uses std:: templates.
+//
+
+#ifndef DSPKernelsImpl_h
+#define DSPKernelsImpl_h
+
+#include <stdint.h>
+#include <string.h>
+#include "DSPKernels.h"
+
+namespace{
+
+    //20*log10(2) and log2(10)/20
+    const double kLog2ToDB = 6.0205999132796239042747778944899;
+    const double kDBToLog2 = 0.16609640474436811739351597147447;
+
+    const double kSqrt2 = 1.4142135623730950488;
+    const double kLog2E = 1.4426950408889634074;
+
+    //ln(2)/14, turns log2 into the 1/14 ln of the shaper's antiderivative
+    const double kLn2Over14 = 0.049510512897138950673;
+
+    //Consecutive samples closer than this make the ADAA quotient ill-conditioned
+    const double kADAAMinStep = 1e-4;
+
+    //Samples per pass of saturateADAA, which works on stack copies
+    const int kADAAChunk = 64;
+
+    //Taylor coefficients of 2^f = e^(f ln2) up to f^9, |f| <= 0.5
+    const double kExp2C[10] = {
+        1.,
+        0.69314718055994530942,
+        0.24022650695910071233,
+        0.055504108664821579953,
+        0.0096181291076284771620,
+        0.0013333558146428443423,
+        1.5403530393381609954e-4,
+        1.5252733804059840280e-5,
+        1.3215486790144309489e-6,
+        1.0178086009239699728e-7
+    };
+
+    //IEEE layout of each sample type
+    template <typename S> struct sampleTraits;
+
+    template <> struct sampleTraits<double>{
+        typedef uint64_t bits;
+        enum{ kMantissaBits = 52, kExponentBias = 1023, kExp2Terms = 9 };
+        static double minAmp(){ return 2.2250738585072014e-308; }   //Smallest normal
+        static double roundMagic(){ return 6755399441055744.; }     //1.5 * 2^52
+        static double intMagic(){ return 4503599627370496.; }       //2^52
+        static const uint64_t kSignMask = 0x8000000000000000ULL;
+        static const uint64_t kMantissaMask = 0x000FFFFFFFFFFFFFULL;
+        static const uint64_t kExponentOne = 0x3FF0000000000000ULL;
+        static const uint64_t kIntMagicBits = 0x4330000000000000ULL;
+    };
+
+    //Float drops the two highest Taylor terms, they are below float resolution
+    template <> struct sampleTraits<float>{
+        typedef uint32_t bits;
+        enum{ kMantissaBits = 23, kExponentBias = 127, kExp2Terms = 7 };
+        static float minAmp(){ return 1.17549435e-38f; }
+        static float roundMagic(){ return 12582912.f; }
+        static float intMagic(){ return 8388608.f; }
+        static const uint32_t kSignMask = 0x80000000U;
+        static const uint32_t kMantissaMask = 0x007FFFFFU;
+        static const uint32_t kExponentOne = 0x3F800000U;
+        static const uint32_t kIntMagicBits = 0x4B000000U;
+    };
+
+    //One sample per lane, the reference every other tier is checked against
+    template <typename S>
+    struct vecScalar{
+        typedef S scalar;
+        typedef S type;
+        typedef typename sampleTraits<S>::bits itype;
+        typedef bool mask;
+        enum{ width = 1 };
+
+        static inline type set1(S x){ return x; }
+        static inline type load(const S* p){ return *p; }
+        static inline void store(S* p, type x){ *p = x; }
+        static inline type add(type a, type b){ return a + b; }
+        static inline type sub(type a, type b){ return a - b; }
+        static inline type mul(type a, type b){ return a * b; }
+        static inline type div(type a, type b){ return a / b; }
+        static inline type madd(type a, type b, type c){ return a * b + c; }
+        //Same operand order as minps/maxps, b is returned when either is NaN
+        static inline type min(type a, type b){ return a < b ? a : b; }
+        static inline type max(type a, type b){ return a > b ? a : b; }
+
+        static inline mask cmpgt(type a, type b){ return a > b; }
+        static inline mask cmplt(type a, type b){ return a < b; }
+        static inline mask andm(mask a, mask b){ return a && b; }
+        static inline mask orm(mask a, mask b){ return a || b; }
+        static inline type select(mask m, type a, type b){ return m ? a : b; }
+
+        static inline itype asInt(type x){ itype i; memcpy(&i, &x, sizeof(i)); return i; }
+        static inline type asFloat(itype i){ type x; memcpy(&x, &i, sizeof(x)); return x; }
+        static inline itype set1i(itype x){ return x; }
+        static inline itype andi(itype a, itype b){ return a & b; }
+        static inline itype ori(itype a, itype b){ return a | b; }
+        static inline itype addi(itype a, itype b){ return a + b; }
+        template <int N> static inline itype shr(itype a){ return a >> N; }
+        template <int N> static inline itype shl(itype a){ return a << N; }
+    };
+
+    template <class V>
+    struct kernelsImpl{
+        typedef typename V::scalar S;
+        typedef typename V::type T;
+        typedef typename V::mask M;
+        typedef sampleTraits<S> K;
+        typedef kernelsImpl<vecScalar<S> > tail;
+
+        static inline T set(double x){ return V::set1((S) x); }
+
+        static inline T absolute(T x){
+            return V::asFloat(V::andi(V::asInt(x), V::set1i(~K::kSignMask)));
+        }
+
+        //ln(m) for m in [sqrt(0.5), sqrt(2)] as 2*atanh(s), s = (m-1)/(m+1), |s| <= 0.172
+        static inline T logPoly(T m){
+            const T one = set(1.);
+            T s = V::div(V::sub(m, one), V::add(m, one));
+            T z = V::mul(s, s);
+            T p = set(1./13.);
+            p = V::madd(p, z, set(1./11.));
+            p = V::madd(p, z, set(1./9.));
+            p = V::madd(p, z, set(1./7.));
+            p = V::madd(p, z, set(1./5.));
+            p = V::madd(p, z, set(1./3.));
+            p = V::madd(p, z, one);
+            return V::mul(V::mul(set(2.), s), p);
+        }
+
+        static inline T exp2Poly(T f){
+            T p = set(kExp2C[K::kExp2Terms]);
+            for(int k = K::kExp2Terms - 1; k >= 0; --k) p = V::madd(p, f, set(kExp2C[k]));
+            return p;
+        }
+
+        static inline T log2(T x){
+            x = V::max(absolute(x), V::set1(K::minAmp()));
+
+            typename V::itype bits = V::asInt(x);
+            T e = V::asFloat(V::ori(V::template shr<K::kMantissaBits>(bits), V::set1i(K::kIntMagicBits)));
+            e = V::sub(e, V::set1(K::intMagic() + K::kExponentBias));
+            T m = V::asFloat(V::ori(V::andi(bits, V::set1i(K::kMantissaMask)), V::set1i(K::kExponentOne)));
+
+            M big = V::cmpgt(m, set(kSqrt2));
+            m = V::select(big, V::mul(m, set(0.5)), m);
+            e = V::select(big, V::add(e, set(1.)), e);
+
+            return V::madd(logPoly(m), set(kLog2E), e);
+        }
+
+        //Exponents are clamped so 2^x stays normal
+        static inline T exp2(T x){
+            x = V::min(V::max(x, set(1 - K::kExponentBias)), set(K::kExponentBias));
+
+            const T magic = V::set1(K::roundMagic());
+            T t = V::add(x, magic);
+            T f = V::sub(x, V::sub(t, magic));
+            T scale = V::asFloat(V::template shl<K::kMantissaBits>(V::addi(V::asInt(t), V::set1i(K::kExponentBias))));
+            return V::mul(exp2Poly(f), scale);
+        }
+
+        static void ampToDB(const S* in, S* out, int n){
+            int i = 0;
+            for(; i + V::width <= n; i += V::width){
+                V::store(out + i, V::mul(log2(V::load(in + i)), set(kLog2ToDB)));
+            }
+            if(V::width > 1) tail::ampToDB(in + i, out + i, n - i);
+        }
+
+        static void dbToAmp(const S* in, S* out, int n){
+            int i = 0;
+            for(; i + V::width <= n; i += V::width){
+                V::store(out + i, exp2(V::mul(V::load(in + i), set(kDBToLog2))));
+            }
+            if(V::width > 1) tail::dbToAmp(in + i, out + i, n - i);
+        }
+
+        static void gainComputer(const S* envDB, S* grOut, int n, double threshold, double slope, double kneeL, double kneeU, double kneeScale){
+            const T t = set(threshold), s = set(slope), kl = set(kneeL), ku = set(kneeU), ks = set(kneeScale);
+            int i = 0;
+            for(; i + V::width <= n; i += V::width){
+                T e = V::load(envDB + i);
+                T d = V::sub(e, kl);
+                T hard = V::min(set(0.), V::mul(s, V::sub(t, e)));
+                T soft = V::mul(V::mul(ks, d), d);
+                V::store(grOut + i, V::select(V::andm(V::cmpgt(e, kl), V::cmplt(e, ku)), soft, hard));
+            }
+            if(V::width > 1) tail::gainComputer(envDB + i, grOut + i, n - i, threshold, slope, kneeL, kneeU, kneeScale);
+        }
+
+        //1/5 * fastAtan(5x) outside [lower, upper], the Colored mode saturation
+        static void saturate(const S* in, S* out, int n, double upper, double lower){
+            const T u = set(upper), l = set(lower);
+            int i = 0;
+            for(; i + V::width <= n; i += V::width){
+                T x = V::load(in + i);
+                T y = V::mul(x, set(5.));
+                T shaped = V::mul(set(1/5.), V::div(y, V::madd(V::mul(y, y), set(0.28), set(1.))));
+                V::store(out + i, V::select(V::orm(V::cmpgt(x, u), V::cmplt(x, l)), shaped, x));
+            }
+            if(V::width > 1) tail::saturate(in + i, out + i, n - i, upper, lower);
+        }
+
+        //Antiderivative of the shaper's deviation from linear, r(x) = x/(1 + 7x^2) - x outside
+        //[lower, upper] and 0 inside, integrated from the bound b that x is past:
+        //  R(x) = ln((1 + 7x^2) / (1 + 7b^2)) / 14 - (x^2 - b^2) / 2
+        static void adaaAntiderivative(const S* x, S* r, int n, double upper, double lower){
+            const T u = set(upper), l = set(lower), seven = set(7.), one = set(1.);
+            int i = 0;
+            for(; i + V::width <= n; i += V::width){
+                T v = V::load(x + i);
+                M above = V::cmpgt(v, u);
+                M outside = V::orm(above, V::cmplt(v, l));
+                T b = V::select(above, u, l);
+                T v2 = V::mul(v, v), b2 = V::mul(b, b);
+                T q = V::div(V::madd(v2, seven, one), V::madd(b2, seven, one));
+                T R = V::madd(log2(q), set(kLn2Over14), V::mul(set(-0.5), V::sub(v2, b2)));
+                V::store(r + i, V::select(outside, R, set(0.)));
+            }
+            if(V::width > 1) tail::adaaAntiderivative(x + i, r + i, n - i, upper, lower);
+        }
+
+        //out[i] = x[i+1] + the mean of r over [x[i], x[i+1]], or r at the midpoint when the step is tiny
+        static void adaaMean(const S* x, const S* r, S* out, int n, double upper, double lower){
+            const T u = set(upper), l = set(lower), eps = set(kADAAMinStep);
+            int i = 0;
+            for(; i + V::width <= n; i += V::width){
+                T x0 = V::load(x + i), x1 = V::load(x + i + 1);
+                T d = V::sub(x1, x0);
+                T mean = V::div(V::sub(V::load(r + i + 1), V::load(r + i)), d);
+                T mid = V::mul(V::add(x0, x1), set(0.5));
+                T shaped = V::div(mid, V::madd(V::mul(mid, mid), set(7.), set(1.)));
+                T rMid = V::select(V::orm(V::cmpgt(mid, u), V::cmplt(mid, l)), V::sub(shaped, mid), set(0.));
+                M steep = V::orm(V::cmpgt(d, eps), V::cmplt(d, V::sub(set(0.), eps)));
+                V::store(out + i, V::add(x1, V::select(steep, mean, rMid)));
+            }
+            if(V::width > 1) tail::adaaMean(x + i, r + i, out + i, n - i, upper, lower);
+        }
+
+        //First order antiderivative antialiased saturate. Only the deviation from linear goes
+        //through ADAA, so the linear part is not delayed and the dry/wet mix stays aligned; the
+        //distortion lags by half a sample. Works in S whatever In is, last holds the previous
+        //input sample between calls
+        template <typename In>
+        static void saturateADAA(const In* in, In* out, int n, double upper, double lower, In* last){
+            S x[kADAAChunk + 1], r[kADAAChunk + 1], y[kADAAChunk];
+            for(int i = 0; i < n; i += kADAAChunk){
+                const int m = n - i < kADAAChunk ? n - i : kADAAChunk;
+                x[0] = (S) *last;
+                bool linear = x[0] <= upper && x[0] >= lower;
+                for(int j = 0; j < m; ++j){
+                    x[j + 1] = (S) in[i + j];
+                    linear &= (x[j + 1] <= upper) & (x[j + 1] >= lower);
+                }
+                *last = (In) x[m];
+
+                //r is 0 between the bounds, so a chunk that never leaves them passes through exactly
+                if(linear){
+                    if(in != out) for(int j = 0; j < m; ++j) out[i + j] = in[i + j];
+                    continue;
+                }
+
+                adaaAntiderivative(x, r, m + 1, upper, lower);
+                adaaMean(x, r, y, m, upper, lower);
+                for(int j = 0; j < m; ++j) out[i + j] = (In) y[j];
+            }
+        }
+
+        //Each output lane keeps its own accumulator, so the taps are summed in the same order on every tier
+        static void fir(const S* in, S* out, int n, const double* coeffs, int taps){
+            int k = 0;
+            for(; k + V::width <= n; k += V::width){
+                T acc = set(0.);
+                for(int i = 0; i < taps; ++i) acc = V::madd(set(coeffs[i]), V::load(in + k - i), acc);
+                V::store(out + k, acc);
+            }
+            if(V::width > 1) tail::fir(in + k, out + k, n - k, coeffs, taps);
+        }
+
+        static void linkMax(const S* in, S* level, int n, double weight){
+            const T w = set(weight);
+            int i = 0;
+            for(; i + V::width <= n; i += V::width){
+                V::store(level + i, V::max(V::mul(absolute(V::load(in + i)), w), V::load(level + i)));
+            }
+            if(V::width > 1) tail::linkMax(in + i, level + i, n - i, weight);
+        }
+
+        static void linkSum(const S* in, S* level, int n, double weight){
+            const T w = set(weight);
+            int i = 0;
+            for(; i + V::width <= n; i += V::width){
+                V::store(level + i, V::madd(absolute(V::load(in + i)), w, V::load(level + i)));
+            }
+            if(V::width > 1) tail::linkSum(in + i, level + i, n - i, weight);
+        }
+
+        //envFollower::process followed by the gain computer, with every lane on its own settings.
+        //The branches become selects, the hold timer counts in S
+        static void compressBank(const S* level, S* grOut, int n, int stride, int lanes, const compressorLanes<S>& s){
+            const T zero = set(0.), one = set(1.), toDB = set(kLog2ToDB);
+            int k = 0;
+            for(; k + V::width <= lanes; k += V::width){
+                const T attack = V::load(s.attack + k), release = V::load(s.release + k), hold = V::load(s.hold + k);
+                const T t = V::load(s.threshold + k), sl = V::load(s.slope + k);
+                const T kl = V::load(s.kneeL + k), ku = V::load(s.kneeU + k), ks = V::load(s.kneeScale + k);
+                T env = V::load(s.env + k), timer = V::load(s.timer + k);
+
+                for(int i = 0; i < n; ++i){
+                    const T mag = absolute(V::load(level + i * stride + k));
+                    const T d = V::sub(env, mag);
+                    const M up = V::cmpgt(mag, env);
+                    const M holding = V::cmplt(timer, hold);
+                    env = V::select(up, V::madd(attack, d, mag), V::select(holding, env, V::madd(release, d, mag)));
+                    timer = V::select(up, zero, V::select(holding, V::add(timer, one), timer));
+
+                    const T e = V::mul(log2(env), toDB);
+                    const T dk = V::sub(e, kl);
+                    const T hard = V::min(zero, V::mul(sl, V::sub(t, e)));
+                    const T soft = V::mul(V::mul(ks, dk), dk);
+                    V::store(grOut + i * stride + k, V::select(V::andm(V::cmpgt(e, kl), V::cmplt(e, ku)), soft, hard));
+                }
+
+                V::store(s.env + k, env);
+                V::store(s.timer + k, timer);
+            }
+            if(V::width > 1 && k < lanes){
+                const compressorLanes<S> rest = {s.env + k, s.timer + k, s.attack + k, s.release + k, s.hold + k,
+                                                 s.threshold + k, s.slope + k, s.kneeL + k, s.kneeU + k, s.kneeScale + k};
+                tail::compressBank(level + k, grOut + k, n, stride, lanes - k, rest);
+            }
+        }
+
+        static void applyGain(const S* in, const S* gain, S* out, int n){
+            int i = 0;
+            for(; i + V::width <= n; i += V::width){
+                V::store(out + i, V::mul(V::load(in + i), V::load(gain + i)));
+            }
+            if(V::width > 1) tail::applyGain(in + i, gain + i, out + i, n - i);
+        }
+
+        static void mixDryWet(const S* dry, const S* wet, const S* mix, S* out, int n){
+            int i = 0;
+            for(; i + V::width <= n; i += V::width){
+                T d = V::load(dry + i);
+                T m = V::load(mix + i);
+                V::store(out + i, V::madd(V::load(wet + i), m, V::mul(d, V::sub(set(1.), m))));
+            }
+            if(V::width > 1) tail::mixDryWet(dry + i, wet + i, mix + i, out + i, n - i);
+        }
+    };
+
+    //Fills a table from one double and one float vector type of the same instruction set.
+    //ADAA runs on double lanes for float samples too, its quotient needs the precision
+    template <class VD, class VF>
+    dspKernels makeKernels(int tier, const char* name){
+        dspKernels k;
+        k.tier = tier;
+        k.name = name;
+        k.ampToDB64 = kernelsImpl<VD>::ampToDB;
+        k.dbToAmp64 = kernelsImpl<VD>::dbToAmp;
+        k.gainComputer64 = kernelsImpl<VD>::gainComputer;
+        k.saturate64 = kernelsImpl<VD>::saturate;
+        k.saturateADAA64 = kernelsImpl<VD>::template saturateADAA<double>;
+        k.fir64 = kernelsImpl<VD>::fir;
+        k.linkMax64 = kernelsImpl<VD>::linkMax;
+        k.linkSum64 = kernelsImpl<VD>::linkSum;
+        k.compressBank64 = kernelsImpl<VD>::compressBank;
+        k.applyGain64 = kernelsImpl<VD>::applyGain;
+        k.mixDryWet64 = kernelsImpl<VD>::mixDryWet;
+        k.ampToDB32 = kernelsImpl<VF>::ampToDB;
+        k.dbToAmp32 = kernelsImpl<VF>::dbToAmp;
+        k.gainComputer32 = kernelsImpl<VF>::gainComputer;
+        k.saturate32 = kernelsImpl<VF>::saturate;
+        k.saturateADAA32 = kernelsImpl<VD>::template saturateADAA<float>;
+        k.fir32 = kernelsImpl<VF>::fir;
+        k.linkMax32 = kernelsImpl<VF>::linkMax;
+        k.linkSum32 = kernelsImpl<VF>::linkSum;
+        k.compressBank32 = kernelsImpl<VF>::compressBank;
+        k.applyGain32 = kernelsImpl<VF>::applyGain;
+        k.mixDryWet32 = kernelsImpl<VF>::mixDryWet;
+        return k;
+    }
+}
+
+//Implemented in the per tier files, return false when the tier was not built
+bool makeDSPKernelsSSE2(dspKernels& k);
+bool makeDSPKernelsAVX2(dspKernels& k);
+bool makeDSPKernelsAVX512(dspKernels& k);
+
+#endif /* DSPKernelsImpl_h */
@@ -0,0 +1,93 @@
+//
+//  DSPKernelsSSE2.cpp
+//
+//  Two doubles or four floats per register. SSE2 is the x86-64 baseline, no extra compiler flags needed.
+//
+
+#include "DSPKernelsImpl.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+
+namespace{
+    struct vecSSE2{
+        typedef double scalar;
+        typedef __m128d type;
+        typedef __m128i itype;
+        typedef __m128d mask;
+        enum{ width = 2 };
+
+        static inline type set1(double x){ return _mm_set1_pd(x); }
+        static inline type load(const double* p){ return _mm_loadu_pd(p); }
+        static inline void store(double* p, type x){ _mm_storeu_pd(p, x); }
+        static inline type add(type a, type b){ return _mm_add_pd(a, b); }
+        static inline type sub(type a, type b){ return _mm_sub_pd(a, b); }
+        static inline type mul(type a, type b){ return _mm_mul_pd(a, b); }
+        static inline type div(type a, type b){ return _mm_div_pd(a, b); }
+        static inline type madd(type a, type b, type c){ return _mm_add_pd(_mm_mul_pd(a, b), c); }
+        static inline type min(type a, type b){ return _mm_min_pd(a, b); }
+        static inline type max(type a, type b){ return _mm_max_pd(a, b); }
+
+        static inline mask cmpgt(type a, type b){ return _mm_cmpgt_pd(a, b); }
+        static inline mask cmplt(type a, type b){ return _mm_cmplt_pd(a, b); }
+        static inline mask andm(mask a, mask b){ return _mm_and_pd(a, b); }
+        static inline mask orm(mask a, mask b){ return _mm_or_pd(a, b); }
+        static inline type select(mask m, type a, type b){ return _mm_or_pd(_mm_and_pd(m, a), _mm_andnot_pd(m, b)); }
+
+        static inline itype asInt(type x){ return _mm_castpd_si128(x); }
+        static inline type asFloat(itype i){ return _mm_castsi128_pd(i); }
+        static inline itype set1i(uint64_t x){ return _mm_set1_epi64x((long long) x); }
+        static inline itype andi(itype a, itype b){ return _mm_and_si128(a, b); }
+        static inline itype ori(itype a, itype b){ return _mm_or_si128(a, b); }
+        static inline itype addi(itype a, itype b){ return _mm_add_epi64(a, b); }
+        template <int S> static inline itype shr(itype a){ return _mm_srli_epi64(a, S); }
+        template <int S> static inline itype shl(itype a){ return _mm_slli_epi64(a, S); }
+    };
+
+    struct vecSSE2f{
+        typedef float scalar;
+        typedef __m128 type;
+        typedef __m128i itype;
+        typedef __m128 mask;
+        enum{ width = 4 };
+
+        static inline type set1(float x){ return _mm_set1_ps(x); }
+        static inline type load(const float* p){ return _mm_loadu_ps(p); }
+        static inline void store(float* p, type x){ _mm_storeu_ps(p, x); }
+        static inline type add(type a, type b){ return _mm_add_ps(a, b); }
+        static inline type sub(type a, type b){ return _mm_sub_ps(a, b); }
+        static inline type mul(type a, type b){ return _mm_mul_ps(a, b); }
+        static inline type div(type a, type b){ return _mm_div_ps(a, b); }
+        static inline type madd(type a, type b, type c){ return _mm_add_ps(_mm_mul_ps(a, b), c); }
+        static inline type min(type a, type b){ return _mm_min_ps(a, b); }
+        static inline type max(type a, type b){ return _mm_max_ps(a, b); }
+
+        static inline mask cmpgt(type a, type b){ return _mm_cmpgt_ps(a, b); }
+        static inline mask cmplt(type a, type b){ return _mm_cmplt_ps(a, b); }
+        static inline mask andm(mask a, mask b){ return _mm_and_ps(a, b); }
+        static inline mask orm(mask a, mask b){ return _mm_or_ps(a, b); }
+        static inline type select(mask m, type a, type b){ return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+
+        static inline itype asInt(type x){ return _mm_castps_si128(x); }
+        static inline type asFloat(itype i){ return _mm_castsi128_ps(i); }
+        static inline itype set1i(uint32_t x){ return _mm_set1_epi32((int) x); }
+        static inline itype andi(itype a, itype b){ return _mm_and_si128(a, b); }
+        static inline itype ori(itype a, itype b){ return _mm_or_si128(a, b); }
+        static inline itype addi(itype a, itype b){ return _mm_add_epi32(a, b); }
+        template <int S> static inline itype shr(itype a){ return _mm_srli_epi32(a, S); }
+        template <int S> static inline itype shl(itype a){ return _mm_slli_epi32(a, S); }
+    };
+}
+
+bool makeDSPKernelsSSE2(dspKernels& k){
+    k = makeKernels<vecSSE2, vecSSE2f>(kTierSSE2, "sse2");
+    return true;
+}
+
+#else
+
+bool makeDSPKernelsSSE2(dspKernels& k){
+    return false;
+}
+
+#endif
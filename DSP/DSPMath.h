@@ -0,0 +1,30 @@
+//
+//  DSPMath.h
+//
+//  Small math helpers shared by the DSP code. Kept free of IPlug so the engine
+//  can be built on its own.
+//
+
+#ifndef DSPMath_h
+#define DSPMath_h
+
+#include <cmath>
+
+//Same constants as IPlug's AmpToDB/DBToAmp
+const double kAmpToDBFactor = 8.685889638065036553;
+const double kDBToAmpFactor = 0.11512925464970;
+
+inline double ampToDB(double amp){
+    return kAmpToDBFactor * std::log(std::fabs(amp));
+}
+
+inline double dbToAmp(double dB){
+    return std::exp(kDBToAmpFactor * dB);
+}
+
+//Cheap arctangent approximation, accurate for small |x|
+inline double fastAtan(double x){
+    return (x / (1.0 + 0.28 * (x * x)));
+}
+
+#endif /* DSPMath_h */
@@ -10,6 +10,9 @@
 
 #include <algorithm>
 #include <vector>
+#include "DSPMath.h"
+#include "DSPKernels.h"
+#include "GainCurveTable.h"
 //#include "utils.h"
 
 using std::vector;
@@ -40,12 +43,48 @@ public:
         hold = holdMS / 1000. * sr;
         env = 0;
         timer = 0;
-        rmsWindowLength = SampleRate * 0.2;
-        buffer.resize(rmsWindowLength);
-        index = 0;
+        sumSquares = 0.;
+        rmsWindowLength = 1;
+        rmsWindowMS = 50.;
+        initRMS(mode == kRMS ? rmsWindowMS : 0.);
+    }
+    
+    //Allocates the RMS ring for windows up to maxWindowMS, 0 frees it. Only the RMS mode
+    //needs it, so peak followers never pay for it. Not real time safe
+    void initRMS(double maxWindowMS){
+        vector<double>(getRMSRingLength(maxWindowMS, sr)).swap(buffer);
+        setRMSWindow(rmsWindowMS);
+    }
+    
+    //Length of the ring initRMS() allocates for maxWindowMS at sampleRate
+    static size_t getRMSRingLength(double maxWindowMS, double sampleRate){
+        return (size_t) std::max(0., maxWindowMS * 0.001 * sampleRate + 0.5);
+    }
+    
+    //Takes ring as the RMS ring and hands back the old one, without allocating, so a ring
+    //allocated on another thread can be put in while processing. ring must hold
+    //getRMSRingLength() samples for the longest window at this sample rate
+    void swapRMS(vector<double>& ring){
+        buffer.swap(ring);
+        setRMSWindow(rmsWindowMS);
     }
     
+    //True when the ring is allocated, RMS detection needs it
+    bool canDetectRMS() const { return !buffer.empty(); }
     
+    //RMS averaging window, clamped to the length given to initRMS(). The new window starts
+    //out filled with the current mean square, so the level does not jump when it changes
+    void setRMSWindow(double windowMS){
+        const double meanSquare = buffer.empty() ? 0. : std::max(0., sumSquares) / rmsWindowLength;
+        rmsWindowMS = windowMS;
+        rmsWindowLength = std::max(1, std::min((int) (windowMS * 0.001 * sr + 0.5), (int) buffer.size()));
+        std::fill(buffer.begin(), buffer.begin() + std::min(rmsWindowLength, (int) buffer.size()), meanSquare);
+        index = 0;
+        sumSquares = meanSquare * rmsWindowLength;
+        freshSum = 0.;
+    }
+    
+    double getRMSWindow() const { return rmsWindowMS; }
     
     void setAttack(double attackMS){
         attack = attackMS;
@@ -59,18 +98,37 @@ public:
         hold = holdMS;
     }
     
+    //RMS falls back to peak detection while no ring is allocated, see initRMS()
     void setDetectMode(int detectorMode){
-        mode = detectorMode;
+        mode = detectorMode == kRMS && canDetectRMS() ? kRMS : kPeak;
     }
     
-    virtual double process(double sample){
-        double mag;
-        if(mode == kRMS){
-            
-        }
-        else{
-            mag = fabs(sample);
+    int getDetectMode() const { return mode; }
+    
+    //Level fed to the envelope: |sample|, or the RMS over the window. The window keeps a running
+    //sum of squares, so each sample costs the same whatever the window length
+    inline double detect(double sample){
+        if(mode != kRMS) return fabs(sample);
+        
+        const double square = sample * sample;
+        sumSquares += square - buffer[index];
+        buffer[index] = square;
+        
+        //The running sum picks up rounding error with every add and subtract. freshSum restarts
+        //at each pass through the window, so at the end of a pass it holds exactly the window's
+        //squares and replaces the drifted sum
+        freshSum += square;
+        if(++index == rmsWindowLength){
+            index = 0;
+            sumSquares = freshSum;
+            freshSum = 0.;
         }
+        
+        return sqrt(std::max(0., sumSquares) / rmsWindowLength);
+    }
+    
+    virtual double process(double sample){
+        const double mag = detect(sample);
         if(mag > env){
             env = attack * (env - mag) + mag;
             timer=0;
@@ -86,8 +144,10 @@ public:
     }
     
 protected:
-    double attack, release, env, sr;
+    double attack, release, env, sr, rmsWindowMS, sumSquares, freshSum;
     int index, timer, hold, mode, rmsWindowLength;
+    
+    //Squares of the last rmsWindowLength samples, RMS mode only
     vector<double> buffer;
 };
 
@@ -111,6 +171,11 @@ public:
     
     void init(double attackMS, double releaseMS, double holdMS, double ratio, double knee, double SampleRate){
         envFollower::init(kPeak, attackMS, releaseMS, holdMS, SampleRate);
+        mAttackMS = attackMS;
+        mReleaseMS = releaseMS;
+        mHoldMS = holdMS;
+        kernels = &getDSPKernels();
+        table = 0;
         mCompMode = 0;
         gainReduction = 0;
         mKnee = knee;
@@ -121,14 +186,17 @@ public:
     }
     
     void setAttack(double attackMS){
+        mAttackMS = attackMS;
         attack = pow(0.01, 1.0/(attackMS * sr * 0.001));
     }
     
     void setRelease(double releaseMS){
+        mReleaseMS = releaseMS;
         release = pow(0.01, 1.0/(releaseMS * sr * 0.001));
     }
     
     void setHold(double holdMS){
+        mHoldMS = holdMS;
         hold = holdMS / 1000. * sr;
     }
     
@@ -156,54 +224,122 @@ public:
     }
     
     double getThreshold(){ return mThreshold; }
-    double getAttack(){ return attack; }
-    double getRelease(){ return release; }
-    double getHold(){ return hold; }
+    //Times as last set, in ms
+    double getAttack(){ return mAttackMS; }
+    double getRelease(){ return mReleaseMS; }
+    double getHold(){ return mHoldMS; }
     double getKnee() { return mKnee; }
     double getRatio() { return mRatio; }
     double getGainReductionDB(){return gainReduction;}
     double getKneeBoundL(){ return kneeBoundL; }
     double getKneeBoundU(){ return kneeBoundU; }
 
+    //Static curve only, gain reduction in dB for an envelope level in dB. Used to build gain tables
+    double getGainReduction(double envDB) const { return gainComputer(envDB); }
+    
+    //Block processing reads the gain reduction from table instead of computing it from threshold,
+    //ratio and knee while one is set. Pass 0 to go back, init() does too
+    void setGainTable(const gainCurveTable* gainTable){
+        table = gainTable;
+    }
     
     
     double process(double sample){
-        double e = AmpToDB(envFollower::process(sample));
-        
-        if(kneeWidth > 0. && e > kneeBoundL && e < kneeBoundU){
-            slope *= ((e - kneeBoundL) / kneeWidth) * 0.5;
-            gainReduction = slope * (kneeBoundL  - e);
-        }
-        else{
-            gainReduction = slope * (mThreshold - e);
-            gainReduction = std::min(0., gainReduction);
-        }
+        double e = ampToDB(envFollower::process(sample));
+        gainReduction = gainComputer(e);
         
-        return sample * DBToAmp(gainReduction);
+        return sample * dbToAmp(gainReduction);
     }
     
     //Takes in two samples, processes them, and returns gain reduction in dB
     double processStereo(double sample1, double sample2){
-        double e = AmpToDB(envFollower::process(std::max(sample1, sample2)));
-        calcSlope();
-        
-        if(kneeWidth > 0. && e > kneeBoundL && e < kneeBoundU){
-            slope *= ((e - kneeBoundL) / kneeWidth) * 0.5;
-            gainReduction = slope * (kneeBoundL  - e);
-        }
-        else{
-            gainReduction = slope * (mThreshold - e);
-            gainReduction = std::min(0., gainReduction);
-        }
+        double e = ampToDB(envFollower::process(std::max(fabs(sample1), fabs(sample2))));
+        gainReduction = gainComputer(e);
 
         return gainReduction;
     }
     
+    //Takes in a block of detector level (the linked level of all channels it controls, see
+    //dspKernels::linkMax) and writes n gain reduction values in dB to grOut
+    //Envelope runs first (recursive, scalar), then the whole block goes through the dB conversion
+    //and gain computer kernels selected for this CPU, or the gain table if one is set. T is double or float, the envelope state
+    //stays double either way
+    template <typename T>
+    void processBlock(const T* level, T* grOut, int n){
+        for(int i = 0; i < n; ++i){
+            grOut[i] = (T) envFollower::process(level[i]);
+        }
+        
+        const double kneeScale = kneeWidth > 0. ? -0.5 * slope / kneeWidth : 0.;
+        
+        kernels->ampToDB(grOut, grOut, n);
+        if(table) table->process(grOut, grOut, n);
+        else kernels->gainComputer(grOut, grOut, n, mThreshold, slope, kneeBoundL, kneeBoundU, kneeScale);
+        
+        if(n > 0) gainReduction = grOut[n - 1];
+    }
+
+    //Control rate version of processBlock. The envelope advances once per interval by the sum of
+    //the steps the per-sample follower would take with the envelope held at its starting value,
+    //which tracks it closely while attack and release are long compared to the interval.
+    //Writes one gain reduction value (dB) per interval to grOut, the last interval may be
+    //shorter, and returns how many were written
+    template <typename T>
+    int processControlBlock(const T* level, T* grOut, int n, int interval){
+        const double attackStep = 1. - attack;
+        const double releaseStep = 1. - release;
+
+        int points = 0;
+        for(int start = 0; start < n; start += interval, ++points){
+            const int len = std::min(interval, n - start);
+
+            //Steps above and below the envelope from sum(d) and sum(|d|), d = mag - env.
+            //Plain sums and fabs keep the compiler from branching on noisy input
+            const double e = env;
+            double sum = 0., sumAbs = 0., peak = 0.;
+            for(int i = start; i < start + len; ++i){
+                const double mag = detect(level[i]);
+                const double d = mag - e;
+                sum += d;
+                sumAbs += fabs(d);
+                peak = std::max(peak, mag);
+            }
+            const double up = 0.5 * (sum + sumAbs);
+            const double down = 0.5 * (sum - sumAbs);
+
+            //Attack is capped at the interval peak
+            if(peak > env){
+                env = std::min(peak, env + attackStep * up + (timer < hold ? 0. : releaseStep * down));
+                timer = 0;
+            }
+            else if(timer < hold){
+                timer += len;
+            }
+            else{
+                env = std::max(0., env + releaseStep * down);
+            }
+
+            grOut[points] = (T) env;
+        }
+
+        const double kneeScale = kneeWidth > 0. ? -0.5 * slope / kneeWidth : 0.;
+
+        kernels->ampToDB(grOut, grOut, points);
+        if(table) table->process(grOut, grOut, points);
+        else kernels->gainComputer(grOut, grOut, points, mThreshold, slope, kneeBoundL, kneeBoundU, kneeScale);
+
+        if(points > 0) gainReduction = grOut[points - 1];
+        return points;
+    }
+
 
     
 private:
     double gainReduction, mKnee, mRatio, mThreshold, kneeWidth, kneeBoundL, kneeBoundU, slope;
+    double mAttackMS, mReleaseMS, mHoldMS;
     int mCompMode;
+    const dspKernels* kernels;
+    const gainCurveTable* table;
     
     inline void calcKnee(){
         kneeWidth = mThreshold * mKnee * -1.;
@@ -211,6 +347,15 @@ private:
         kneeBoundU = mThreshold + (kneeWidth / 2.);
     }
     
+    //Static gain computer, returns gain reduction in dB for an envelope level in dB
+    inline double gainComputer(double e) const{
+        if(kneeWidth > 0. && e > kneeBoundL && e < kneeBoundU){
+            double d = e - kneeBoundL;
+            return -0.5 * slope * d * d / kneeWidth;
+        }
+        return std::min(0., slope * (mThreshold - e));
+    }
+    
     inline void calcSlope(){
         if(mCompMode == kCompressor){
             slope = 1 - (1 / mRatio);
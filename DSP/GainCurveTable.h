@@ -0,0 +1,104 @@
+//
+//  GainCurveTable.h
+//
+//  A compressor's static curve (envelope in dB to gain reduction in dB) sampled into a
+//  table, and a double buffer that lets a non real time thread rebuild the table while
+//  the audio thread keeps reading the previous one.
+//
+//  The closed form gain computer kernel is cheaper per sample than a table lookup on
+//  every tier (see dcomp-bench --gain-table), so the engine only uses a table when one
+//  is attached with DCompEngineT::setGainTable().
+//
+
+#ifndef GainCurveTable_h
+#define GainCurveTable_h
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+class gainCurveTable{
+public:
+    //Range and resolution. Below kMinDB the curve is flat, above kMaxDB it continues with
+    //the slope of the last segment, which is exact for any curve whose knee ends below kMaxDB
+    enum{
+        kMinDB = -120,
+        kMaxDB = 24,
+        kStepsPerDB = 16,
+        kSize = (kMaxDB - kMinDB) * kStepsPerDB + 1
+    };
+
+    gainCurveTable(){
+        std::fill(values, values + kSize, 0.);
+    }
+
+    ~gainCurveTable(){}
+
+    //Samples curve.getGainReduction(dB) at every step, a compressor or anything with the same method
+    template <class Curve>
+    void build(const Curve& curve){
+        for(int i = 0; i < kSize; ++i) values[i] = curve.getGainReduction(kMinDB + (double) i / kStepsPerDB);
+    }
+
+    //Gain reduction in dB for an envelope level in dB, linearly interpolated between steps
+    inline double lookup(double envDB) const{
+        const double x = (std::max(envDB, (double) kMinDB) - kMinDB) * kStepsPerDB;
+        const int i = (int) std::min(x, (double) (kSize - 2));
+        return values[i] + (x - i) * (values[i + 1] - values[i]);
+    }
+
+    //Block version, envDB and grOut may be the same buffer
+    template <typename T>
+    void process(const T* envDB, T* grOut, int n) const{
+        for(int i = 0; i < n; ++i) grOut[i] = (T) lookup(envDB[i]);
+    }
+
+private:
+    double values[kSize];
+};
+
+//Two tables, one the audio thread reads and one the builder writes. The builder swaps them
+//once the new curve is complete, and never writes the one the audio thread currently holds.
+//Both tables are flat (no gain reduction) until the first update()
+class gainCurveBuffer{
+public:
+    gainCurveBuffer() : front(0), reading(-1) {}
+
+    ~gainCurveBuffer(){}
+
+    //Builder thread, never the audio thread. Builds curve into the back table and makes it the
+    //front one. Yields while the audio thread still holds the back table from before the last
+    //swap, which lasts at most until the end of its current block. Only one thread may call this
+    template <class Curve>
+    void update(const Curve& curve){
+        const int back = 1 - front.load();
+        while(reading.load() == back) std::this_thread::yield();
+        tables[back].build(curve);
+        front.store(back);
+    }
+
+    //Audio thread, once per block. Returns the newest complete table, which stays valid until
+    //release(). Never blocks: it only repeats when a swap lands between its two loads
+    const gainCurveTable* acquire(){
+        int f;
+        do{
+            f = front.load();
+            reading.store(f);
+        } while(front.load() != f);
+        return &tables[f];
+    }
+
+    //Audio thread, when done with the table from acquire()
+    void release(){
+        reading.store(-1);
+    }
+
+private:
+    gainCurveTable tables[2];
+
+    //Sequentially consistent on purpose: the builder must see the audio thread's reading
+    //store if the audio thread saw the old front after making it
+    std::atomic<int> front, reading;
+};
+
+#endif /* GainCurveTable_h */
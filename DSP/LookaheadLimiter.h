@@ -0,0 +1,212 @@
+//
+//  LookaheadLimiter.h
+//
+//  Brickwall limiter for DCompEngine's Limiter mode. The gain is computed from a
+//  sliding window peak and applied to audio delayed by the lookahead, so it has
+//  already come down by the time a peak reaches the output and never lets one
+//  through above the ceiling.
+//
+
+#ifndef LookaheadLimiter_h
+#define LookaheadLimiter_h
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include "DSPMath.h"
+
+//Maximum over the last window samples in O(1) amortized time per sample, whatever the window.
+//Keeps a monotonic deque of candidates: a new value drops every older value it is not smaller
+//than, since those can never be the maximum again, and the front is dropped once it leaves the window
+class slidingMax{
+public:
+    slidingMax(){
+        init(1);
+    }
+
+    ~slidingMax(){}
+
+    //Allocates room for windows up to maxWindow samples. Not real time safe
+    void init(int maxWindow){
+        unsigned int size = 1;
+        while(size < (unsigned int) maxWindow + 1) size *= 2;
+        entries.assign(size, entry());
+        mask = size - 1;
+        window = 1;
+        reset();
+    }
+
+    //Window length in samples, clamped to the size given to init(). Clears the history
+    void setWindow(int length){
+        window = (unsigned int) std::max(1, std::min(length, (int) mask));
+        reset();
+    }
+
+    int getWindow() const { return (int) window; }
+
+    void reset(){
+        head = tail = 0;
+        count = 0;
+    }
+
+    //Pushes x and returns the maximum of the last window values, x included
+    inline double process(double x){
+        while(tail != head && entries[(tail - 1) & mask].value <= x) --tail;
+        entry& e = entries[tail & mask];
+        e.value = x;
+        e.index = count;
+        ++tail;
+
+        //Unsigned differences stay correct when count wraps
+        if(count - entries[head & mask].index >= window) ++head;
+        ++count;
+
+        return entries[head & mask].value;
+    }
+
+private:
+    struct entry{
+        double value;
+        unsigned int index;
+    };
+
+    std::vector<entry> entries;
+    unsigned int mask, head, tail, count, window;
+};
+
+//Fixed delay of up to the length given to init(). in and out may be the same buffer
+template <typename T>
+class delayLine{
+public:
+    delayLine(){
+        init(0);
+    }
+
+    ~delayLine(){}
+
+    //Not real time safe
+    void init(int maxDelay){
+        buffer.assign(maxDelay + 1, (T) 0);
+        delay = 0;
+        pos = 0;
+    }
+
+    //Delay in samples, clamped to the size given to init(). Clears the line
+    void setDelay(int samples){
+        delay = std::max(0, std::min(samples, (int) buffer.size() - 1));
+        reset();
+    }
+
+    void reset(){
+        std::fill(buffer.begin(), buffer.end(), (T) 0);
+        pos = 0;
+    }
+
+    void process(const T* in, T* out, int n){
+        if(delay == 0){
+            if(in != out) memmove(out, in, n * sizeof(T));
+            return;
+        }
+        for(int i = 0; i < n; ++i){
+            const T x = in[i];
+            out[i] = buffer[pos];
+            buffer[pos] = x;
+            if(++pos == delay) pos = 0;
+        }
+    }
+
+private:
+    std::vector<T> buffer;
+    int delay, pos;
+};
+
+class lookaheadLimiter{
+public:
+    lookaheadLimiter(){
+        init(0, 44100.);
+    }
+
+    ~lookaheadLimiter(){}
+
+    //Allocates for lookaheads up to maxLookaheadMS. Not real time safe
+    void init(double maxLookaheadMS, double sampleRate){
+        sr = sampleRate;
+        const int maxLength = getLookaheadSamples(maxLookaheadMS, sr);
+        peak.init(maxLength + 1);
+        box.assign(std::max(1, maxLength), 1.);
+        ceiling = 1.;
+        releaseMS = -1.;
+        setRelease(250.);
+        setLookahead(0);
+    }
+
+    //Lookahead rounded to whole samples, the latency the limiter adds
+    static int getLookaheadSamples(double lookaheadMS, double sampleRate){
+        return (int) std::floor(std::max(0., lookaheadMS) * 0.001 * sampleRate + 0.5);
+    }
+
+    //Lookahead in samples, clamped to the maximum given to init(). Clears the state
+    void setLookahead(int samples){
+        lookahead = std::max(0, std::min(samples, (int) box.size()));
+        peak.setWindow(lookahead + 1);
+        boxLength = std::max(1, lookahead);
+        reset();
+    }
+
+    int getLatency() const { return lookahead; }
+
+    void setCeiling(double ceilingDB){
+        ceiling = dbToAmp(ceilingDB);
+    }
+
+    //Time for the gain to recover after the peak has passed
+    void setRelease(double ms){
+        if(ms == releaseMS) return;
+        releaseMS = ms;
+        release = pow(0.01, 1.0/(std::max(ms, 1.) * sr * 0.001));
+    }
+
+    void reset(){
+        peak.reset();
+        std::fill(box.begin(), box.begin() + boxLength, 1.);
+        boxSum = boxLength;
+        boxPos = 0;
+        held = 1.;
+    }
+
+    //Writes the linear gain for n samples of detector level (the linked level of all channels it
+    //controls). gainOut[i] is meant for the audio that arrived getLatency() samples before level[i]
+    template <typename T>
+    void processBlock(const T* level, T* gainOut, int n){
+        for(int i = 0; i < n; ++i){
+            //Gain needed for the loudest sample in the lookahead window
+            const double p = peak.process(fabs((double) level[i]));
+            const double target = p > ceiling ? ceiling / p : 1.;
+
+            //Instant attack, exponential release, never above target
+            held = target < held ? target : release * (held - target) + target;
+
+            //Moving average over the lookahead turns the steps into ramps. Every value in the
+            //average is at most the gain the peak needs, so the peak still gets it
+            boxSum += held - box[boxPos];
+            box[boxPos] = held;
+            if(++boxPos == boxLength){
+                boxPos = 0;
+                //Resum once per pass so rounding in the running sum cannot build up
+                boxSum = 0.;
+                for(int k = 0; k < boxLength; ++k) boxSum += box[k];
+            }
+
+            gainOut[i] = (T) (boxSum / boxLength);
+        }
+    }
+
+private:
+    slidingMax peak;
+    std::vector<double> box;
+    double sr, ceiling, release, releaseMS, held, boxSum;
+    int lookahead, boxLength, boxPos;
+};
+
+#endif /* LookaheadLimiter_h */
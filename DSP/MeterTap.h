@@ -0,0 +1,82 @@
+//
+//  MeterTap.h
+//
+//  Carries decimated level and gain reduction summaries from the audio thread to the GUI.
+//  The audio thread only tracks peaks and pushes one frame every kDecimation samples,
+//  envelope following and dB conversion are left to the consumer.
+//
+
+#ifndef MeterTap_h
+#define MeterTap_h
+
+#include <atomic>
+#include <cmath>
+#include "SPSCQueue.h"
+
+struct meterFrame{
+    float in;   //Peak input level, linear
+    float out;  //Peak output level, linear
+    float gr;   //Maximum gain reduction, dB (<= 0)
+};
+
+class meterTap{
+public:
+    enum{
+        kDecimation = 32,
+        kQueueSize = 2048
+    };
+    
+    meterTap() : sampleRate(44100.){
+        reset();
+    }
+    
+    ~meterTap(){}
+    
+    //Any thread. Sample rate of the audio being written, the consumer rescales its time constants when it changes
+    void setSampleRate(double rate){
+        sampleRate.store(rate, std::memory_order_relaxed);
+    }
+    
+    double getSampleRate() const{
+        return sampleRate.load(std::memory_order_relaxed);
+    }
+    
+    //Audio thread. Clears the partially accumulated frame
+    void reset(){
+        peakIn = 0;
+        peakOut = 0;
+        minGR = 0;
+        count = 0;
+    }
+    
+    //Audio thread. Accumulates one stereo sample pair and its gain reduction in dB
+    inline void write(double in1, double in2, double out1, double out2, double gr){
+        peakIn = std::fmax(peakIn, std::fmax(std::fabs(in1), std::fabs(in2)));
+        peakOut = std::fmax(peakOut, std::fmax(std::fabs(out1), std::fabs(out2)));
+        minGR = std::fmin(minGR, gr);
+        
+        if(++count == kDecimation){
+            meterFrame frame = {(float) peakIn, (float) peakOut, (float) minGR};
+            queue.push(frame);
+            reset();
+        }
+    }
+    
+    //GUI thread. Returns false when no more frames are waiting
+    bool read(meterFrame& frame){
+        return queue.pop(frame);
+    }
+    
+    //Rate at which frames are produced for a given audio sample rate
+    static double getFrameRate(double sampleRate){
+        return sampleRate / kDecimation;
+    }
+    
+private:
+    double peakIn, peakOut, minGR;
+    int count;
+    std::atomic<double> sampleRate;
+    spscQueue<meterFrame, kQueueSize> queue;
+};
+
+#endif /* MeterTap_h */
@@ -0,0 +1,241 @@
+//
+//  Oversampler.h
+//
+//  2x/4x/8x up and down sampling for the nonlinear stages, built from cascaded half-band
+//  FIR stages. Every other tap of a half-band filter is zero, so each stage splits into a
+//  pure delay and one short FIR (the polyphase branches), and the FIR runs on the block
+//  kernels selected for this CPU. Later stages only have to reject images of what is
+//  already band limited, so they get shorter filters and the cost grows more slowly than
+//  the factor.
+//
+//  Everything is fixed size, nothing allocates after construction.
+//
+
+#ifndef Oversampler_h
+#define Oversampler_h
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "DSPKernels.h"
+#include "LookaheadLimiter.h"
+
+//One 2x stage: a linear phase half-band filter of length 4 * halfLength - 1 around a rate change
+template <typename T>
+class halfbandStage{
+public:
+    enum{
+        kMaxHalfLength = 16,
+        kMaxTaps = 2 * kMaxHalfLength,
+        kMaxFrames = 256        //Most samples per call at the lower rate
+    };
+
+    halfbandStage(){
+        init(1);
+    }
+
+    ~halfbandStage(){}
+
+    //Kaiser windowed (beta 8, about 80 dB stopband) half-band lowpass. Clears the state
+    void init(int halfLength){
+        m = std::max(1, std::min(halfLength, (int) kMaxHalfLength));
+        taps = 2 * m;
+
+        //Odd offsets from the centre are the only nonzero taps besides the centre (0.5),
+        //they are scaled to sum to 0.5 so the DC gain is exactly 1
+        const int center = 2 * m - 1;
+        double sum = 0.;
+        for(int i = 0; i < taps; ++i){
+            const double t = 2 * i - center;
+            const double r = t / (center + 1);
+            const double sinc = std::sin(M_PI * t / 2.) / (M_PI * t / 2.);
+            coeffsDown[i] = 0.5 * sinc * besselI0(8. * std::sqrt(1. - r * r));
+            sum += coeffsDown[i];
+        }
+        for(int i = 0; i < taps; ++i){
+            coeffsDown[i] *= 0.5 / sum;
+            coeffsUp[i] = 2. * coeffsDown[i];
+        }
+
+        kernels = &getDSPKernels();
+        reset();
+    }
+
+    void reset(){
+        std::fill(upHistory, upHistory + kMaxTaps + kMaxFrames, (T) 0);
+        std::fill(even, even + kMaxTaps + kMaxFrames, (T) 0);
+        std::fill(odd, odd + kMaxHalfLength + kMaxFrames, (T) 0);
+    }
+
+    //Delay of one up and one down pass together, in samples at the higher rate
+    int getLatency() const { return 4 * m - 2; }
+
+    //Delay of the up pass alone, in samples at the higher rate
+    int getUpLatency() const { return 2 * m - 1; }
+
+    //n samples in, 2n out, n at most kMaxFrames. in and out must not overlap
+    void up(const T* in, T* out, int n){
+        T* x = upHistory + taps - 1;
+        memcpy(x, in, n * sizeof(T));
+
+        //Even outputs are the FIR branch, odd outputs the centre tap, a plain delay
+        T filtered[kMaxFrames];
+        kernels->fir(x, filtered, n, coeffsUp, taps);
+        for(int k = 0; k < n; ++k){
+            out[2 * k] = filtered[k];
+            out[2 * k + 1] = x[k - (m - 1)];
+        }
+
+        memmove(upHistory, upHistory + n, (taps - 1) * sizeof(T));
+    }
+
+    //2n samples in, n out, n at most kMaxFrames. in and out may be the same buffer
+    void down(const T* in, T* out, int n){
+        T* e = even + taps - 1;
+        T* o = odd + m;
+        for(int k = 0; k < n; ++k){
+            e[k] = in[2 * k];
+            o[k] = in[2 * k + 1];
+        }
+
+        //FIR branch on the even samples, centre tap on the odd ones m samples back
+        kernels->fir(e, out, n, coeffsDown, taps);
+        for(int k = 0; k < n; ++k) out[k] += (T) 0.5 * odd[k];
+
+        memmove(even, even + n, (taps - 1) * sizeof(T));
+        memmove(odd, odd + n, m * sizeof(T));
+    }
+
+private:
+    int m, taps;
+    double coeffsUp[kMaxTaps], coeffsDown[kMaxTaps];
+    const dspKernels* kernels;
+
+    //History followed by the current block
+    T upHistory[kMaxTaps + kMaxFrames];
+    T even[kMaxTaps + kMaxFrames];
+    T odd[kMaxHalfLength + kMaxFrames];
+
+    static double besselI0(double x){
+        double sum = 1., term = 1.;
+        for(int k = 1; k < 30; ++k){
+            term *= (x / (2. * k)) * (x / (2. * k));
+            sum += term;
+        }
+        return sum;
+    }
+};
+
+//One channel of 1x, 2x, 4x or 8x oversampling
+template <typename T>
+class oversampler{
+public:
+    enum{
+        kMaxFactor = 8,
+        kMaxStages = 3,
+        kMaxBlockSize = 2 * halfbandStage<T>::kMaxFrames / kMaxFactor   //Base rate samples per call
+    };
+
+    oversampler() : factor(1), stages(0){
+        for(int s = 0; s < kMaxStages; ++s) stage[s].init(getHalfLength(s));
+        pad.init(kMaxFactor);
+    }
+
+    ~oversampler(){}
+
+    //Rounded down to a power of two from 1 to kMaxFactor. Clears the state
+    void setFactor(int newFactor){
+        factor = 1;
+        stages = 0;
+        while(factor < kMaxFactor && factor * 2 <= newFactor){
+            factor *= 2;
+            ++stages;
+        }
+        pad.setDelay(getPadding(factor));
+        reset();
+    }
+
+    int getFactor() const { return factor; }
+
+    void reset(){
+        for(int s = 0; s < kMaxStages; ++s) stage[s].reset();
+        pad.reset();
+    }
+
+    //Delay of up() followed by down(), in base rate samples. Padded to a whole sample so the
+    //dry signal can be delayed to match
+    static int getLatency(int factor){
+        int stages = 0;
+        while((1 << stages) < kMaxFactor && (2 << stages) <= factor) ++stages;
+        return (getRawLatency(stages) + getPadding(1 << stages)) >> stages;
+    }
+
+    //Delay of up() alone, in samples at the oversampled rate
+    static int getUpLatency(int factor){
+        int latency = 0;
+        for(int s = 0; (2 << s) <= std::min(factor, (int) kMaxFactor); ++s){
+            latency = 2 * latency + 2 * getHalfLength(s) - 1;
+        }
+        return latency;
+    }
+
+    //n base rate samples in, n * getFactor() out, n at most kMaxBlockSize. in and out must not overlap
+    void up(const T* in, T* out, int n){
+        if(stages == 0){
+            memcpy(out, in, n * sizeof(T));
+            return;
+        }
+
+        //Ping-pong between out and scratch so the last stage lands in out
+        T* buffers[2] = {out, scratch};
+        const T* src = in;
+        for(int s = 0; s < stages; ++s){
+            T* dst = buffers[(stages - 1 - s) & 1];
+            stage[s].up(src, dst, n << s);
+            src = dst;
+        }
+    }
+
+    //n * getFactor() samples in, n base rate samples out. in is used as scratch and out may be in
+    void down(T* in, T* out, int n){
+        if(stages == 0){
+            if(in != out) memcpy(out, in, n * sizeof(T));
+            return;
+        }
+
+        pad.process(in, in, n * factor);
+        for(int s = stages - 1; s >= 0; --s){
+            stage[s].down(in, s == 0 ? out : in, n << s);
+        }
+    }
+
+private:
+    halfbandStage<T> stage[kMaxStages];
+    int factor, stages;
+
+    //Extra delay at the oversampled rate that rounds the latency up to whole base rate samples
+    delayLine<T> pad;
+
+    T scratch[kMaxBlockSize * kMaxFactor];
+
+    //The first stage sits next to the base rate and needs the steepest filter
+    static int getHalfLength(int stage){
+        static const int halfLengths[kMaxStages] = {16, 5, 4};
+        return halfLengths[stage];
+    }
+
+    //Up and down delay of the first stages stages, in samples at the oversampled rate
+    static int getRawLatency(int stages){
+        int latency = 0;
+        for(int s = 0; s < stages; ++s) latency = 2 * latency + 4 * getHalfLength(s) - 2;
+        return latency;
+    }
+
+    static int getPadding(int factor){
+        int stages = 0;
+        while((2 << stages) <= factor) ++stages;
+        return (factor - getRawLatency(stages) % factor) % factor;
+    }
+};
+
+#endif /* Oversampler_h */
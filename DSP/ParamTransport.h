@@ -0,0 +1,46 @@
+//
+//  ParamTransport.h
+//
+//  Latest value parameter transport into the audio thread. Any thread may set() a value;
+//  the audio thread calls consume() at the start of each block and, if something changed,
+//  reads the values with get(). Neither side ever blocks, locks or allocates. Only the
+//  latest value of each parameter is kept, changes in between are dropped.
+//
+
+#ifndef ParamTransport_h
+#define ParamTransport_h
+
+#include <atomic>
+
+template <int Size>
+class paramTransport{
+public:
+    paramTransport() : changed(false){
+        for(int i = 0; i < Size; ++i) values[i].store(0., std::memory_order_relaxed);
+    }
+
+    ~paramTransport(){}
+
+    //Any thread. Publishes value for parameter index (below Size)
+    void set(int index, double value){
+        values[index].store(value, std::memory_order_relaxed);
+        changed.store(true, std::memory_order_release);
+    }
+
+    //Audio thread. True if anything was set since the last call, the values set before it are
+    //then visible to get(). A set() racing with the reads shows up again at the next call
+    bool consume(){
+        return changed.exchange(false, std::memory_order_acquire);
+    }
+
+    //Latest value of parameter index
+    double get(int index) const { return values[index].load(std::memory_order_relaxed); }
+
+    static int getSize(){ return Size; }
+
+private:
+    std::atomic<double> values[Size];
+    std::atomic<bool> changed;
+};
+
+#endif /* ParamTransport_h */
@@ -0,0 +1,97 @@
+//
+//  PlotHistory.h
+//
+//  The scrolling history behind the level and gain reduction plots. Each lane (input,
+//  output, gain reduction, say) keeps a running sum that becomes one column, the mean of
+//  columnLength samples, and a ring of the last columns. Columns are stored through a
+//  linear map, the plot's dB to pixel mapping, so drawing reads them as they are.
+//
+//  Only init() allocates. add() and the getters never do, so the history can be fed once
+//  per sample or meter frame from whichever single thread owns it.
+//
+
+#ifndef PlotHistory_h
+#define PlotHistory_h
+
+#include <algorithm>
+#include <vector>
+
+class plotHistory{
+public:
+    enum{
+        kMaxLanes = 3
+    };
+
+    plotHistory(){
+        init(1, 1, 1);
+    }
+
+    ~plotHistory(){}
+
+    //lanes (up to kMaxLanes) rings of columns each, every column the mean of columnLength samples.
+    //Every column starts at 0 and the mapping is the identity. Allocates, not real time safe
+    void init(int lanes, int columns, int columnLength){
+        nLanes = std::max(1, std::min(lanes, (int) kMaxLanes));
+        nColumns = std::max(1, columns);
+        length = std::max(1, columnLength);
+        scale = 1.;
+        offset = 0.;
+        for(int l = 0; l < kMaxLanes; ++l) std::vector<double>(l < nLanes ? nColumns : 0, 0.).swap(ring[l]);
+        head = 0;
+        clear();
+    }
+
+    //Drops the samples of the column in progress
+    void clear(){
+        count = 0;
+        std::fill(sums, sums + kMaxLanes, 0.);
+    }
+
+    //Sets every column of lane to value, as stored (already mapped)
+    void fill(int lane, double value){
+        std::fill(ring[lane].begin(), ring[lane].end(), value);
+    }
+
+    //Columns are stored as offset + scale * mean. Applies to columns completed from now on
+    void setMapping(double mapScale, double mapOffset){
+        scale = mapScale;
+        offset = mapOffset;
+    }
+
+    //One sample per lane, values[lane]. Returns true if it completed a column
+    bool add(const double* values){
+        for(int l = 0; l < nLanes; ++l) sums[l] += values[l];
+        if(++count < length) return false;
+
+        for(int l = 0; l < nLanes; ++l) ring[l][head] = offset + scale * (sums[l] / count);
+        head = head + 1 == nColumns ? 0 : head + 1;
+        clear();
+        return true;
+    }
+
+    bool add(double value){
+        return add(&value);
+    }
+
+    bool add(double a, double b, double c){
+        const double values[kMaxLanes] = {a, b, c};
+        return add(values);
+    }
+
+    int getColumns() const { return nColumns; }
+    int getColumnLength() const { return length; }
+
+    //Column i of lane, 0 the oldest and getColumns() - 1 the newest
+    double get(int lane, int i) const {
+        const int k = head + i;
+        return ring[lane][k < nColumns ? k : k - nColumns];
+    }
+
+private:
+    int nLanes, nColumns, length, count, head;
+    double scale, offset;
+    double sums[kMaxLanes];
+    std::vector<double> ring[kMaxLanes];
+};
+
+#endif /* PlotHistory_h */
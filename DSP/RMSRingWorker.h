@@ -0,0 +1,88 @@
+//
+//  RMSRingWorker.h
+//
+//  Allocates RMS rings for a DCompEngineT on a thread of its own, so selecting the RMS
+//  detector or relinking channels takes effect at the next block without the audio thread
+//  (or a parameter callback the host runs on it) ever allocating or locking. request() only
+//  stores the sample rate and group count and raises a flag. The worker polls the flag,
+//  allocates the rings and queues them; apply() swaps them into the engine at block start
+//  and queues the empty buffers back to the worker, which frees them.
+//
+
+#ifndef RMSRingWorker_h
+#define RMSRingWorker_h
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "DCompEngine.h"
+#include "SPSCQueue.h"
+
+template <typename T>
+class rmsRingWorker{
+public:
+    typedef typename DCompEngineT<T>::rmsRings rings;
+
+    enum{
+        kPollMS = 5     //How often the worker looks for a request
+    };
+
+    rmsRingWorker() : sampleRate(0.), groups(0), wanted(false), stop(false), worker(&rmsRingWorker::run, this) {}
+
+    //Stops the worker and frees every ring still queued. The audio thread must not be in apply()
+    ~rmsRingWorker(){
+        stop.store(true);
+        worker.join();
+
+        rings* r;
+        while(ready.pop(r)) delete r;
+        while(spent.pop(r)) delete r;
+    }
+
+    //Any thread, real time safe. Asks for rings for the first groups link groups at sampleRate,
+    //a request made before the worker got to the last one replaces it
+    void request(double rate, int nGroups){
+        sampleRate.store(rate, std::memory_order_relaxed);
+        groups.store(nGroups, std::memory_order_relaxed);
+        wanted.store(true, std::memory_order_release);
+    }
+
+    //Audio thread, real time safe. Swaps every queued set of rings into engine, see
+    //DCompEngineT::swapRMSRings(), and hands them back to be freed
+    void apply(DCompEngineT<T>& engine){
+        rings* r;
+        while(ready.pop(r)){
+            engine.swapRMSRings(*r);
+            //Never full, the worker empties it before every push to ready. Leaking beats freeing here
+            spent.push(r);
+        }
+    }
+
+private:
+    spscQueue<rings*, 4> ready;     //Worker to audio thread
+    spscQueue<rings*, 8> spent;     //Audio thread to worker, at most one more than ready holds
+    std::atomic<double> sampleRate;
+    std::atomic<int> groups;
+    std::atomic<bool> wanted, stop;
+    std::thread worker;             //Last, so it starts after everything it reads
+
+    void run(){
+        while(!stop.load()){
+            rings* r;
+            while(spent.pop(r)) delete r;
+
+            if(wanted.exchange(false, std::memory_order_acquire)){
+                r = new rings;
+                DCompEngineT<T>::allocateRMSRings(*r, sampleRate.load(std::memory_order_relaxed), groups.load(std::memory_order_relaxed));
+                if(!ready.push(r)) delete r;
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(kPollMS));
+        }
+    }
+
+    rmsRingWorker(const rmsRingWorker&);
+    rmsRingWorker& operator=(const rmsRingWorker&);
+};
+
+#endif /* RMSRingWorker_h */
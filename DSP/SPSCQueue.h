@@ -0,0 +1,54 @@
+//
+//  SPSCQueue.h
+//
+//  Wait-free single producer, single consumer ring buffer.
+//  One thread may push and one other thread may pop, neither ever blocks or allocates.
+//
+
+#ifndef SPSCQueue_h
+#define SPSCQueue_h
+
+#include <atomic>
+
+template <typename T, unsigned int Capacity>
+class spscQueue{
+public:
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+    
+    spscQueue() : head(0), tail(0) {}
+    
+    ~spscQueue(){}
+    
+    //Producer only. Returns false and drops the item if the queue is full
+    bool push(const T& item){
+        const unsigned int t = tail.load(std::memory_order_relaxed);
+        if(t - head.load(std::memory_order_acquire) == Capacity){
+            return false;
+        }
+        buffer[t & (Capacity - 1)] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+    
+    //Consumer only. Returns false if the queue is empty
+    bool pop(T& item){
+        const unsigned int h = head.load(std::memory_order_relaxed);
+        if(h == tail.load(std::memory_order_acquire)){
+            return false;
+        }
+        item = buffer[h & (Capacity - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+    
+    //Consumer only. Discards everything currently in the queue
+    void clear(){
+        head.store(tail.load(std::memory_order_acquire), std::memory_order_release);
+    }
+    
+private:
+    T buffer[Capacity];
+    std::atomic<unsigned int> head, tail;
+};
+
+#endif /* SPSCQueue_h */
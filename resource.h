@@ -48,7 +48,11 @@ instrument determined by PLUG _IS _INST
 #define PLUG_CHANNEL_IO "3-2"
 #define PLUG_SC_CHANS 1
 
-#else // AU & VST2
+#else // AU, VST2 & VST3
+// Stereo only. AU and VST3 would size the main bus of a 16-16 layout as 14 inputs plus the
+// sidechain, and VST2 reports every declared pin as connected until the host sends
+// effSetSpeakerArrangement, so a 4-2 instance cannot tell its sidechain from surround inputs.
+// DCompEngine and dcomp-render handle up to 16 channels
 #define PLUG_CHANNEL_IO "2-2 4-2"
 #define PLUG_SC_CHANS 2
 #endif
@@ -0,0 +1,415 @@
+//
+//  RTCheck.cpp
+//
+//  Replaces operator new/delete and, on Linux/glibc, defines malloc, pthread locking,
+//  stdio and syscall entry points in the executable so they take precedence over the
+//  C library's. Each one reports a violation when its thread is armed and then calls
+//  the real function.
+//
+
+//Fortified headers turn some of the interposed functions into inline wrappers
+#undef _FORTIFY_SOURCE
+
+#include "RTCheck.h"
+#include <atomic>
+#include <cerrno>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#if defined(__linux__) && defined(__GLIBC__)
+#define RTCHECK_INTERPOSE_LIBC 1
+#else
+#define RTCHECK_INTERPOSE_LIBC 0
+#endif
+
+#if RTCHECK_INTERPOSE_LIBC || defined(__APPLE__)
+#define RTCHECK_BACKTRACE 1
+#include <execinfo.h>
+#else
+#define RTCHECK_BACKTRACE 0
+#endif
+
+#include <unistd.h>
+
+#if RTCHECK_INTERPOSE_LIBC
+#include <dlfcn.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+//glibc's own allocator, so the checked entry points can allocate without reporting themselves
+extern "C"{
+    void* __libc_malloc(size_t size);
+    void* __libc_calloc(size_t n, size_t size);
+    void* __libc_realloc(void* p, size_t size);
+    void* __libc_memalign(size_t alignment, size_t size);
+    void __libc_free(void* p);
+}
+#endif
+
+namespace{
+    //Name of the innermost scope, 0 when the thread is not armed
+    thread_local const char* tScope = 0;
+
+    //Set while a violation is reported or a real function is looked up, suppresses reports
+    thread_local bool tBusy = false;
+
+    std::atomic<int> gViolations(0);
+    std::atomic<int> gMaxReports(10);
+
+    void writeError(const char* s, int n){
+        if(n <= 0) return;
+#if RTCHECK_INTERPOSE_LIBC
+        //Straight to the kernel, write() itself is interposed
+        if(syscall(SYS_write, 2, s, (size_t) n) < 0) return;
+#else
+        if(::write(2, s, (size_t) n) < 0) return;
+#endif
+    }
+
+    void violation(const char* what){
+        if(!tScope || tBusy) return;
+        tBusy = true;
+
+        const int count = ++gViolations;
+        if(count <= gMaxReports.load()){
+            char message[256];
+            writeError(message, snprintf(message, sizeof(message), "rtcheck: %s inside %s\n", what, tScope));
+#if RTCHECK_BACKTRACE
+            //Skip this frame, the interposed function is the first one shown
+            void* frames[64];
+            const int depth = backtrace(frames, 64);
+            backtrace_symbols_fd(frames + 1, depth - 1, 2);
+#endif
+            writeError("\n", 1);
+        }
+        else if(count == gMaxReports.load() + 1 && count > 1){
+            const char* more = "rtcheck: further violations are counted but not shown\n";
+            writeError(more, (int) strlen(more));
+        }
+
+        tBusy = false;
+    }
+
+    void* allocate(size_t size){
+#if RTCHECK_INTERPOSE_LIBC
+        return __libc_malloc(size);
+#else
+        return malloc(size);
+#endif
+    }
+
+    void release(void* p){
+#if RTCHECK_INTERPOSE_LIBC
+        __libc_free(p);
+#else
+        free(p);
+#endif
+    }
+
+#if RTCHECK_INTERPOSE_LIBC
+    //dlsym can allocate the first time a thread calls it, which is the checker's doing
+    void* resolve(const char* name){
+        const bool busy = tBusy;
+        tBusy = true;
+        void* p = dlsym(RTLD_NEXT, name);
+        tBusy = busy;
+        return p;
+    }
+#endif
+}
+
+void rtCheckInit(){
+#if RTCHECK_BACKTRACE
+    //The first backtrace() loads the unwinder
+    void* frames[4];
+    backtrace(frames, 4);
+#endif
+}
+
+int rtCheckViolations(){
+    return gViolations.load();
+}
+
+void rtCheckSetMaxReports(int maxReports){
+    gMaxReports.store(maxReports);
+}
+
+bool rtCheckInterposesLibC(){
+    return RTCHECK_INTERPOSE_LIBC != 0;
+}
+
+rtCheckScope::rtCheckScope(const char* name) : mPrevious(tScope){
+    tScope = name;
+}
+
+rtCheckScope::~rtCheckScope(){
+    tScope = mPrevious;
+}
+
+//Global allocation functions, replaceable on every platform
+
+void* operator new(std::size_t size){
+    violation("operator new");
+    void* p = allocate(size ? size : 1);
+    if(!p) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](std::size_t size){
+    violation("operator new[]");
+    void* p = allocate(size ? size : 1);
+    if(!p) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept{
+    violation("operator new");
+    return allocate(size ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept{
+    violation("operator new[]");
+    return allocate(size ? size : 1);
+}
+
+void operator delete(void* p) noexcept{
+    if(p) violation("operator delete");
+    release(p);
+}
+
+void operator delete[](void* p) noexcept{
+    if(p) violation("operator delete[]");
+    release(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept{
+    if(p) violation("operator delete");
+    release(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept{
+    if(p) violation("operator delete[]");
+    release(p);
+}
+
+#if RTCHECK_INTERPOSE_LIBC
+
+//Declares real as the C library's version of the enclosing function
+#define RTCHECK_REAL(name) static decltype(&name) real = 0; if(!real) real = (decltype(&name)) resolve(#name)
+
+extern "C"{
+
+    //Heap
+
+    void* malloc(size_t size){
+        violation("malloc");
+        return __libc_malloc(size);
+    }
+
+    void* calloc(size_t n, size_t size){
+        violation("calloc");
+        return __libc_calloc(n, size);
+    }
+
+    void* realloc(void* p, size_t size){
+        violation("realloc");
+        return __libc_realloc(p, size);
+    }
+
+    void free(void* p){
+        if(p) violation("free");
+        __libc_free(p);
+    }
+
+    int posix_memalign(void** out, size_t alignment, size_t size){
+        violation("posix_memalign");
+        if(alignment < sizeof(void*) || (alignment & (alignment - 1))) return EINVAL;
+        void* p = __libc_memalign(alignment, size);
+        if(!p) return ENOMEM;
+        *out = p;
+        return 0;
+    }
+
+    void* aligned_alloc(size_t alignment, size_t size){
+        violation("aligned_alloc");
+        return __libc_memalign(alignment, size);
+    }
+
+    void* memalign(size_t alignment, size_t size){
+        violation("memalign");
+        return __libc_memalign(alignment, size);
+    }
+
+    //Locks and waits
+
+    int pthread_mutex_lock(pthread_mutex_t* mutex){
+        RTCHECK_REAL(pthread_mutex_lock);
+        violation("pthread_mutex_lock");
+        return real(mutex);
+    }
+
+    int pthread_mutex_trylock(pthread_mutex_t* mutex){
+        RTCHECK_REAL(pthread_mutex_trylock);
+        violation("pthread_mutex_trylock");
+        return real(mutex);
+    }
+
+    int pthread_rwlock_rdlock(pthread_rwlock_t* lock){
+        RTCHECK_REAL(pthread_rwlock_rdlock);
+        violation("pthread_rwlock_rdlock");
+        return real(lock);
+    }
+
+    int pthread_rwlock_wrlock(pthread_rwlock_t* lock){
+        RTCHECK_REAL(pthread_rwlock_wrlock);
+        violation("pthread_rwlock_wrlock");
+        return real(lock);
+    }
+
+    int pthread_cond_wait(pthread_cond_t* cond, pthread_mutex_t* mutex){
+        RTCHECK_REAL(pthread_cond_wait);
+        violation("pthread_cond_wait");
+        return real(cond, mutex);
+    }
+
+    int pthread_cond_timedwait(pthread_cond_t* cond, pthread_mutex_t* mutex, const struct timespec* abstime){
+        RTCHECK_REAL(pthread_cond_timedwait);
+        violation("pthread_cond_timedwait");
+        return real(cond, mutex, abstime);
+    }
+
+    int pthread_join(pthread_t thread, void** result){
+        RTCHECK_REAL(pthread_join);
+        violation("pthread_join");
+        return real(thread, result);
+    }
+
+    int sem_wait(sem_t* sem){
+        RTCHECK_REAL(sem_wait);
+        violation("sem_wait");
+        return real(sem);
+    }
+
+    //Syscalls
+
+    ssize_t read(int fd, void* buffer, size_t count){
+        RTCHECK_REAL(read);
+        violation("read");
+        return real(fd, buffer, count);
+    }
+
+    ssize_t write(int fd, const void* buffer, size_t count){
+        RTCHECK_REAL(write);
+        violation("write");
+        return real(fd, buffer, count);
+    }
+
+    int close(int fd){
+        RTCHECK_REAL(close);
+        violation("close");
+        return real(fd);
+    }
+
+    void* mmap(void* address, size_t length, int protection, int flags, int fd, off_t offset){
+        RTCHECK_REAL(mmap);
+        violation("mmap");
+        return real(address, length, protection, flags, fd, offset);
+    }
+
+    int munmap(void* address, size_t length){
+        RTCHECK_REAL(munmap);
+        violation("munmap");
+        return real(address, length);
+    }
+
+    int nanosleep(const struct timespec* duration, struct timespec* remaining){
+        RTCHECK_REAL(nanosleep);
+        violation("nanosleep");
+        return real(duration, remaining);
+    }
+
+    int usleep(useconds_t usec){
+        RTCHECK_REAL(usleep);
+        violation("usleep");
+        return real(usec);
+    }
+
+    int sched_yield(){
+        RTCHECK_REAL(sched_yield);
+        violation("sched_yield");
+        return real();
+    }
+
+    //stdio, including the forms the compiler rewrites printf into and the fortified ones
+
+    int printf(const char* format, ...){
+        violation("printf");
+        va_list args;
+        va_start(args, format);
+        const int result = vprintf(format, args);
+        va_end(args);
+        return result;
+    }
+
+    int fprintf(FILE* stream, const char* format, ...){
+        violation("fprintf");
+        va_list args;
+        va_start(args, format);
+        const int result = vfprintf(stream, format, args);
+        va_end(args);
+        return result;
+    }
+
+    int __printf_chk(int flag, const char* format, ...){
+        violation("printf");
+        va_list args;
+        va_start(args, format);
+        const int result = vprintf(format, args);
+        va_end(args);
+        return result;
+    }
+
+    int __fprintf_chk(FILE* stream, int flag, const char* format, ...){
+        violation("fprintf");
+        va_list args;
+        va_start(args, format);
+        const int result = vfprintf(stream, format, args);
+        va_end(args);
+        return result;
+    }
+
+    int puts(const char* s){
+        RTCHECK_REAL(puts);
+        violation("puts");
+        return real(s);
+    }
+
+    int putchar(int c){
+        RTCHECK_REAL(putchar);
+        violation("putchar");
+        return real(c);
+    }
+
+    int fputs(const char* s, FILE* stream){
+        RTCHECK_REAL(fputs);
+        violation("fputs");
+        return real(s, stream);
+    }
+
+    size_t fwrite(const void* data, size_t size, size_t count, FILE* stream){
+        RTCHECK_REAL(fwrite);
+        violation("fwrite");
+        return real(data, size, count, stream);
+    }
+}
+
+#undef RTCHECK_REAL
+
+#endif
@@ -0,0 +1,43 @@
+//
+//  RTCheck.h
+//
+//  Real time safety checker for the command line tools. Any thread that holds an
+//  rtCheckScope is treated as the audio callback: heap allocation, mutex locking,
+//  stdio and blocking syscalls on that thread are reported with a stack trace.
+//
+//  Allocation is caught everywhere through the global operator new/delete. malloc and
+//  friends, pthread locking, stdio and syscalls are interposed on Linux/glibc only.
+//
+
+#ifndef RTCheck_h
+#define RTCheck_h
+
+//Call once from main before arming anything. Warms up the stack trace machinery, which
+//allocates the first time it runs
+void rtCheckInit();
+
+//Violations seen so far on all threads
+int rtCheckViolations();
+
+//Stack traces are printed for the first this many violations, later ones are only counted
+void rtCheckSetMaxReports(int maxReports);
+
+//True when the checker interposes the C library as well as operator new/delete
+bool rtCheckInterposesLibC();
+
+//Arms the checker on the calling thread until destroyed. Scopes nest, name is printed
+//with each violation and must outlive the scope
+class rtCheckScope{
+public:
+    explicit rtCheckScope(const char* name);
+
+    ~rtCheckScope();
+
+private:
+    const char* mPrevious;
+
+    rtCheckScope(const rtCheckScope&);
+    rtCheckScope& operator=(const rtCheckScope&);
+};
+
+#endif /* RTCheck_h */
@@ -0,0 +1,181 @@
+//
+//  StreamScheduler.cpp
+//
+
+#include "StreamScheduler.h"
+#include <algorithm>
+#include <chrono>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace{
+    //Yields a worker makes looking for the next period before it goes to sleep
+    const int kSpinYields = 64;
+
+    int64_t nanoseconds(std::chrono::steady_clock::time_point start){
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+//Sequentially consistent throughout: pop() must not read top before its store to bottom is visible
+int streamScheduler::chunkDeque::pop(){
+    const int b = bottom.load() - 1;
+    bottom.store(b);
+    int t = top.load();
+    if(t > b){
+        bottom.store(b + 1);
+        return -1;
+    }
+
+    int chunk = chunks[b];
+    if(t == b){
+        //The last one, thieves may be after it too
+        if(!top.compare_exchange_strong(t, t + 1)) chunk = -1;
+        bottom.store(b + 1);
+    }
+    return chunk;
+}
+
+int streamScheduler::chunkDeque::steal(){
+    int t = top.load();
+    const int b = bottom.load();
+    if(t >= b) return -1;
+
+    const int chunk = chunks[t];
+    return top.compare_exchange_strong(t, t + 1) ? chunk : -2;
+}
+
+streamScheduler::streamScheduler(int threads, bool pin) : mThreads(std::max(1, threads)), mDeques(mThreads), mStats(mThreads),
+    mFunction(0), mContext(0), mStreams(0), mChunkSize(1), mGeneration(0), mFinished(0), mSleepers(0), mStop(false){
+    mLast.wallNS = 0;
+    mLast.imbalance = 1.;
+    mLast.steals = 0;
+
+    for(int w = 1; w < mThreads; ++w) mWorkers.push_back(std::thread(&streamScheduler::workerMain, this, w, pin));
+}
+
+streamScheduler::~streamScheduler(){
+    mStop.store(true);
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mWake.notify_all();
+    }
+    for(size_t i = 0; i < mWorkers.size(); ++i) mWorkers[i].join();
+}
+
+int streamScheduler::getDefaultChunkSize(int nStreams, int threads){
+    return std::max(1, nStreams / (4 * std::max(1, threads)));
+}
+
+void streamScheduler::run(int nStreams, int chunkSize, chunkFunction fn, void* context){
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    chunkSize = std::max(1, chunkSize);
+    const int nChunks = (std::max(0, nStreams) + chunkSize - 1) / chunkSize;
+
+    //Worker w gets the w-th contiguous range, stored backwards so its own pops walk the streams in order
+    for(int w = 0; w < mThreads; ++w){
+        const int first = (int) ((int64_t) nChunks * w / mThreads);
+        const int last = (int) ((int64_t) nChunks * (w + 1) / mThreads);
+        chunkDeque& d = mDeques[w];
+        if((int) d.chunks.size() < last - first) d.chunks.resize(last - first);
+        for(int i = first; i < last; ++i) d.chunks[last - 1 - i] = i;
+        d.top.store(0);
+        d.bottom.store(last - first);
+    }
+
+    mFunction = fn;
+    mContext = context;
+    mStreams = nStreams;
+    mChunkSize = chunkSize;
+    mFinished.store(0);
+    mGeneration.fetch_add(1);
+
+    //A worker that has not gone to sleep yet sees the new generation before it waits
+    if(mSleepers.load() > 0){
+        std::lock_guard<std::mutex> lock(mMutex);
+        mWake.notify_all();
+    }
+
+    work(0);
+
+    //Every worker checks in, so none still reads this period's function when run() returns
+    while(mFinished.load() < mThreads) std::this_thread::yield();
+
+    int64_t busiest = 0, total = 0;
+    int steals = 0;
+    for(int w = 0; w < mThreads; ++w){
+        busiest = std::max(busiest, mStats[w].busyNS);
+        total += mStats[w].busyNS;
+        steals += mStats[w].steals;
+    }
+    mLast.wallNS = nanoseconds(start);
+    mLast.imbalance = total > 0 ? (double) busiest * mThreads / total : 1.;
+    mLast.steals = steals;
+}
+
+void streamScheduler::workerMain(int worker, bool pin){
+#ifdef __linux__
+    const unsigned cores = std::thread::hardware_concurrency();
+    if(pin && cores > 0){
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(worker % cores, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+#else
+    (void) pin;
+#endif
+
+    unsigned seen = 0;
+    for(;;){
+        for(int i = 0; i < kSpinYields && mGeneration.load() == seen && !mStop.load(); ++i) std::this_thread::yield();
+
+        if(mGeneration.load() == seen && !mStop.load()){
+            std::unique_lock<std::mutex> lock(mMutex);
+            mSleepers.fetch_add(1);
+            mWake.wait(lock, [&]{ return mGeneration.load() != seen || mStop.load(); });
+            mSleepers.fetch_sub(1);
+        }
+        if(mStop.load()) return;
+
+        //run() waits for every worker, so no period can be skipped
+        seen = mGeneration.load();
+        work(worker);
+    }
+}
+
+void streamScheduler::work(int worker){
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    chunkDeque& own = mDeques[worker];
+    int steals = 0;
+
+    for(;;){
+        int chunk = own.pop();
+        if(chunk < 0) chunk = stealFrom(worker, steals);
+        if(chunk < 0) break;
+
+        const int begin = chunk * mChunkSize;
+        mFunction(mContext, begin, std::min(mStreams, begin + mChunkSize));
+    }
+
+    mStats[worker].busyNS = nanoseconds(start);
+    mStats[worker].steals = steals;
+    mFinished.fetch_add(1);
+}
+
+//Nothing is pushed during a period, so once every deque came up empty the period's work is handed out
+int streamScheduler::stealFrom(int worker, int& steals){
+    for(int i = 1; i < mThreads; ++i){
+        chunkDeque& victim = mDeques[(worker + i) % mThreads];
+        int chunk;
+        while((chunk = victim.steal()) == -2){}
+        if(chunk >= 0){
+            ++steals;
+            return chunk;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,105 @@
+//
+//  StreamScheduler.h
+//
+//  Runs hundreds of independent streams (one DCompEngine each, say) across all cores once
+//  per audio period, for servers that embed the engine. Streams are batched into chunks of
+//  consecutive streams so neighbouring state stays together in cache. Each worker is dealt
+//  a contiguous range of chunks into its own deque. It takes work from the back of its own
+//  deque and steals from the front of the others' when it runs dry. Workers are pinned to
+//  cores on Linux.
+//
+//  The calling thread works too, as worker 0. Between periods the other workers spin
+//  briefly and then sleep on a condition variable. run() has to take that mutex to wake
+//  them, so the scheduler is for server threads, not for a plugin's audio callback.
+//
+
+#ifndef StreamScheduler_h
+#define StreamScheduler_h
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//Timing of the last run(), see streamScheduler::getLastPeriod()
+struct streamPeriodStats{
+    int64_t wallNS;     //From entering run() until every worker finished
+    double imbalance;   //Busiest worker's time over the mean across workers, 1 is perfect balance
+    int steals;         //Chunks run by a worker other than the one they were dealt to
+};
+
+class streamScheduler{
+public:
+    //Processes streams [begin, end), called with the context given to run()
+    typedef void (*chunkFunction)(void* context, int begin, int end);
+
+    //threads counts the calling thread, so threads - 1 workers are started. With pin set, worker
+    //i is pinned to core i modulo the core count (Linux only); the calling thread is left alone
+    explicit streamScheduler(int threads, bool pin = true);
+
+    ~streamScheduler();
+
+    int getThreads() const { return mThreads; }
+
+    //Calls fn for every chunk of chunkSize consecutive streams out of nStreams and returns when all
+    //of them are done. Only allocates when nStreams / chunkSize outgrows every earlier call
+    void run(int nStreams, int chunkSize, chunkFunction fn, void* context);
+
+    const streamPeriodStats& getLastPeriod() const { return mLast; }
+
+    //A few chunks per thread, enough to even out the load by stealing
+    static int getDefaultChunkSize(int nStreams, int threads);
+
+private:
+    //Chase-Lev deque over a fixed list of chunk indices. The list is filled before each period
+    //and nothing is pushed during it, so only pop() and steal() are needed
+    struct chunkDeque{
+        std::vector<int> chunks;
+        std::atomic<int> top, bottom;
+        char padding[64];   //Keeps neighbouring deques off each other's cache lines
+
+        chunkDeque() : top(0), bottom(0) {}
+
+        //Owner only. Next chunk from the back, -1 when empty
+        int pop();
+
+        //Any thread. Next chunk from the front, -1 when empty, -2 when another thread won the race
+        int steal();
+    };
+
+    //Per worker results, padded so workers do not share cache lines
+    struct workerStats{
+        int64_t busyNS;
+        int steals;
+        char padding[64 - sizeof(int64_t) - sizeof(int)];
+    };
+
+    int mThreads;
+    std::vector<std::thread> mWorkers;
+    std::vector<chunkDeque> mDeques;
+    std::vector<workerStats> mStats;
+
+    //The current period, written by run() before it bumps mGeneration
+    chunkFunction mFunction;
+    void* mContext;
+    int mStreams, mChunkSize;
+
+    std::atomic<unsigned> mGeneration;
+    std::atomic<int> mFinished, mSleepers;
+    std::atomic<bool> mStop;
+    std::mutex mMutex;
+    std::condition_variable mWake;
+
+    streamPeriodStats mLast;
+
+    void workerMain(int worker, bool pin);
+    void work(int worker);
+    int stealFrom(int worker, int& steals);
+
+    streamScheduler(const streamScheduler&);
+    streamScheduler& operator=(const streamScheduler&);
+};
+
+#endif /* StreamScheduler_h */
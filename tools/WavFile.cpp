@@ -0,0 +1,423 @@
+//
+//  WavFile.cpp
+//
+//
+
+#include "WavFile.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace{
+    const int kWaveFormatPCM = 1;
+    const int kWaveFormatFloat = 3;
+    const int kWaveFormatExtensible = 0xFFFE;
+
+    //Size of the ds64 payload reserved by wavWriter (riff size, data size, sample count, table length)
+    const int kDS64Size = 28;
+
+    inline uint16_t readLE16(const unsigned char* p){
+        return (uint16_t) (p[0] | (p[1] << 8));
+    }
+
+    inline uint32_t readLE32(const unsigned char* p){
+        return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+    }
+
+    inline uint64_t readLE64(const unsigned char* p){
+        return (uint64_t) readLE32(p) | ((uint64_t) readLE32(p + 4) << 32);
+    }
+
+    inline void writeLE16(unsigned char* p, uint16_t v){
+        p[0] = v & 0xFF;
+        p[1] = v >> 8;
+    }
+
+    inline void writeLE32(unsigned char* p, uint32_t v){
+        for(int i = 0; i < 4; ++i) p[i] = (v >> (8 * i)) & 0xFF;
+    }
+
+    inline void writeLE64(unsigned char* p, uint64_t v){
+        writeLE32(p, (uint32_t) v);
+        writeLE32(p + 4, (uint32_t) (v >> 32));
+    }
+
+    int bytesPerSample(int format){
+        switch(format){
+            case kInt16: return 2;
+            case kInt24: return 3;
+            case kInt32: return 4;
+            case kFloat32: return 4;
+            default: return 8;
+        }
+    }
+
+    inline double clip(double x){
+        return std::max(-1., std::min(1., x));
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+//wavReader
+
+wavReader::wavReader()
+: mMap(0), mMapSize(0), mData(0), mFrames(0), mChannels(0), mFormat(kInt16), mBlockAlign(0), mSampleRate(0.)
+{
+}
+
+wavReader::~wavReader(){
+    close();
+}
+
+bool wavReader::open(const char* path, std::string& error){
+    close();
+
+    int fd = ::open(path, O_RDONLY);
+    if(fd < 0){
+        error = "cannot open file";
+        return false;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size < 12){
+        ::close(fd);
+        error = "file too short";
+        return false;
+    }
+
+    void* map = mmap(0, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if(map == MAP_FAILED){
+        error = "mmap failed";
+        return false;
+    }
+
+    mMap = (const unsigned char*) map;
+    mMapSize = (size_t) st.st_size;
+    madvise(map, mMapSize, MADV_SEQUENTIAL);
+
+    const bool rf64 = !memcmp(mMap, "RF64", 4);
+    if((!rf64 && memcmp(mMap, "RIFF", 4)) || memcmp(mMap + 8, "WAVE", 4)){
+        close();
+        error = "not a WAV or RF64 file";
+        return false;
+    }
+
+    uint64_t dataSize64 = 0;
+    uint64_t dataSize = 0;
+    bool haveFormat = false;
+    int formatTag = 0, bits = 0;
+
+    //Walk the chunk list, chunks are padded to an even size
+    size_t pos = 12;
+    while(pos + 8 <= mMapSize){
+        const unsigned char* chunk = mMap + pos;
+        uint64_t size = readLE32(chunk + 4);
+        const unsigned char* body = chunk + 8;
+        const size_t available = mMapSize - pos - 8;
+
+        if(!memcmp(chunk, "ds64", 4) && size >= 24 && available >= 24){
+            dataSize64 = readLE64(body + 8);
+        }
+        else if(!memcmp(chunk, "fmt ", 4) && size >= 16 && available >= 16){
+            formatTag = readLE16(body);
+            mChannels = readLE16(body + 2);
+            mSampleRate = readLE32(body + 4);
+            mBlockAlign = readLE16(body + 12);
+            bits = readLE16(body + 14);
+            if(formatTag == kWaveFormatExtensible && size >= 40 && available >= 40){
+                formatTag = readLE16(body + 24);
+            }
+            haveFormat = true;
+        }
+        else if(!memcmp(chunk, "data", 4)){
+            if(rf64 && size == 0xFFFFFFFF) size = dataSize64;
+            mData = body;
+            dataSize = std::min<uint64_t>(size, available);
+            break;
+        }
+
+        pos += 8 + size + (size & 1);
+    }
+
+    if(!haveFormat || !mData){
+        close();
+        error = "missing fmt or data chunk";
+        return false;
+    }
+
+    if(formatTag == kWaveFormatPCM && bits == 16) mFormat = kInt16;
+    else if(formatTag == kWaveFormatPCM && bits == 24) mFormat = kInt24;
+    else if(formatTag == kWaveFormatPCM && bits == 32) mFormat = kInt32;
+    else if(formatTag == kWaveFormatFloat && bits == 32) mFormat = kFloat32;
+    else if(formatTag == kWaveFormatFloat && bits == 64) mFormat = kFloat64;
+    else{
+        close();
+        error = "unsupported sample format";
+        return false;
+    }
+
+    if(mChannels < 1 || mSampleRate <= 0. || mBlockAlign != mChannels * bytesPerSample(mFormat)){
+        close();
+        error = "invalid fmt chunk";
+        return false;
+    }
+
+    mFrames = (int64_t) (dataSize / mBlockAlign);
+    return true;
+}
+
+void wavReader::close(){
+    if(mMap) munmap((void*) mMap, mMapSize);
+    mMap = 0;
+    mMapSize = 0;
+    mData = 0;
+    mFrames = 0;
+}
+
+void wavReader::read(int64_t startFrame, int nFrames, double* const* out) const{
+    readSamples(startFrame, nFrames, out);
+}
+
+void wavReader::read(int64_t startFrame, int nFrames, float* const* out) const{
+    readSamples(startFrame, nFrames, out);
+}
+
+template <typename T>
+void wavReader::readSamples(int64_t startFrame, int nFrames, T* const* out) const{
+    int available = (int) std::max<int64_t>(0, std::min<int64_t>(nFrames, mFrames - startFrame));
+
+    for(int c = 0; c < mChannels; ++c){
+        T* o = out[c];
+
+        //Only form pointers to frames that exist, even one past the data would be undefined
+        if(available > 0){
+            const unsigned char* first = mData + startFrame * mBlockAlign + c * bytesPerSample(mFormat);
+
+            switch(mFormat){
+                case kInt16:
+                    for(int i = 0; i < available; ++i){
+                        const unsigned char* p = first + (int64_t) i * mBlockAlign;
+                        o[i] = (T) ((int16_t) readLE16(p) * (1. / 32768.));
+                    }
+                    break;
+                case kInt24:
+                    for(int i = 0; i < available; ++i){
+                        const unsigned char* p = first + (int64_t) i * mBlockAlign;
+                        o[i] = (T) (((int32_t) ((p[0] << 8) | (p[1] << 16) | ((uint32_t) p[2] << 24)) >> 8) * (1. / 8388608.));
+                    }
+                    break;
+                case kInt32:
+                    for(int i = 0; i < available; ++i){
+                        const unsigned char* p = first + (int64_t) i * mBlockAlign;
+                        o[i] = (T) ((int32_t) readLE32(p) * (1. / 2147483648.));
+                    }
+                    break;
+                case kFloat32:
+                    for(int i = 0; i < available; ++i){
+                        uint32_t bits = readLE32(first + (int64_t) i * mBlockAlign);
+                        float f;
+                        memcpy(&f, &bits, sizeof(f));
+                        o[i] = f;
+                    }
+                    break;
+                case kFloat64:
+                    for(int i = 0; i < available; ++i){
+                        uint64_t bits = readLE64(first + (int64_t) i * mBlockAlign);
+                        double d;
+                        memcpy(&d, &bits, sizeof(d));
+                        o[i] = (T) d;
+                    }
+                    break;
+            }
+        }
+        std::fill(o + available, o + nFrames, (T) 0);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+//wavWriter
+
+wavWriter::wavWriter()
+: mFile(0), mBuffer(0), mBufferFrames(0), mFrames(0), mChannels(0), mFormat(kInt16), mBlockAlign(0), mFactOffset(0), mDataSizeOffset(0), mDataStart(0), mError(false)
+{
+}
+
+wavWriter::~wavWriter(){
+    close();
+}
+
+bool wavWriter::open(const char* path, int channels, double sampleRate, int format, std::string& error){
+    close();
+
+    mFile = fopen(path, "wb");
+    if(!mFile){
+        error = "cannot create file";
+        return false;
+    }
+
+    mChannels = channels;
+    mFormat = format;
+    mBlockAlign = channels * bytesPerSample(format);
+    mFrames = 0;
+    mError = false;
+
+    const bool isFloat = format == kFloat32 || format == kFloat64;
+
+    //RIFF header with a JUNK chunk reserving room for ds64, see EBU Tech 3306
+    unsigned char header[128];
+    unsigned char* p = header;
+    memcpy(p, "RIFF", 4); writeLE32(p + 4, 0); memcpy(p + 8, "WAVE", 4); p += 12;
+    memcpy(p, "JUNK", 4); writeLE32(p + 4, kDS64Size); memset(p + 8, 0, kDS64Size); p += 8 + kDS64Size;
+
+    memcpy(p, "fmt ", 4); writeLE32(p + 4, isFloat ? 18 : 16);
+    writeLE16(p + 8, isFloat ? kWaveFormatFloat : kWaveFormatPCM);
+    writeLE16(p + 10, (uint16_t) channels);
+    writeLE32(p + 12, (uint32_t) sampleRate);
+    writeLE32(p + 16, (uint32_t) (sampleRate * mBlockAlign));
+    writeLE16(p + 20, (uint16_t) mBlockAlign);
+    writeLE16(p + 22, (uint16_t) (8 * bytesPerSample(format)));
+    p += 24;
+    if(isFloat){
+        writeLE16(p, 0);
+        p += 2;
+        memcpy(p, "fact", 4); writeLE32(p + 4, 4); writeLE32(p + 8, 0);
+        mFactOffset = (p + 8) - header;
+        p += 12;
+    }
+
+    memcpy(p, "data", 4); writeLE32(p + 4, 0);
+    mDataSizeOffset = (p + 4) - header;
+    p += 8;
+    mDataStart = p - header;
+
+    if(fwrite(header, 1, mDataStart, mFile) != (size_t) mDataStart){
+        close();
+        error = "write failed";
+        return false;
+    }
+
+    return true;
+}
+
+bool wavWriter::write(const double* const* in, int nFrames){
+    return writeSamples(in, nFrames);
+}
+
+bool wavWriter::write(const float* const* in, int nFrames){
+    return writeSamples(in, nFrames);
+}
+
+template <typename T>
+bool wavWriter::writeSamples(const T* const* in, int nFrames){
+    if(!mFile) return false;
+
+    if(nFrames > mBufferFrames){
+        delete[] mBuffer;
+        mBuffer = new unsigned char[(size_t) nFrames * mBlockAlign];
+        mBufferFrames = nFrames;
+    }
+
+    const int sampleBytes = bytesPerSample(mFormat);
+
+    for(int c = 0; c < mChannels; ++c){
+        unsigned char* p = mBuffer + c * sampleBytes;
+        const T* x = in[c];
+
+        switch(mFormat){
+            case kInt16:
+                for(int i = 0; i < nFrames; ++i, p += mBlockAlign) writeLE16(p, (uint16_t) (int16_t) std::min(32767., std::round(clip(x[i]) * 32768.)));
+                break;
+            case kInt24:
+                for(int i = 0; i < nFrames; ++i, p += mBlockAlign){
+                    int32_t v = (int32_t) std::min(8388607., std::round(clip(x[i]) * 8388608.));
+                    p[0] = v & 0xFF;
+                    p[1] = (v >> 8) & 0xFF;
+                    p[2] = (v >> 16) & 0xFF;
+                }
+                break;
+            case kInt32:
+                for(int i = 0; i < nFrames; ++i, p += mBlockAlign) writeLE32(p, (uint32_t) (int32_t) std::min(2147483647., std::round(clip(x[i]) * 2147483648.)));
+                break;
+            case kFloat32:
+                for(int i = 0; i < nFrames; ++i, p += mBlockAlign){
+                    float f = (float) x[i];
+                    uint32_t bits;
+                    memcpy(&bits, &f, sizeof(f));
+                    writeLE32(p, bits);
+                }
+                break;
+            case kFloat64:
+                for(int i = 0; i < nFrames; ++i, p += mBlockAlign){
+                    double d = x[i];
+                    uint64_t bits;
+                    memcpy(&bits, &d, sizeof(d));
+                    writeLE64(p, bits);
+                }
+                break;
+        }
+    }
+
+    const size_t bytes = (size_t) nFrames * mBlockAlign;
+    if(fwrite(mBuffer, 1, bytes, mFile) != bytes) mError = true;
+    mFrames += nFrames;
+    return !mError;
+}
+
+bool wavWriter::close(){
+    if(!mFile) return true;
+
+    const uint64_t dataSize = (uint64_t) mFrames * mBlockAlign;
+    if(dataSize & 1) fputc(0, mFile);
+    const uint64_t riffSize = mDataStart + dataSize + (dataSize & 1) - 8;
+    const bool rf64 = riffSize > 0xFFFFFFFF;
+
+    unsigned char b[8];
+
+    if(rf64){
+        //Turn the JUNK chunk into ds64 and mark the 32 bit sizes as unused
+        unsigned char ds64[8 + kDS64Size];
+        memcpy(ds64, "ds64", 4);
+        writeLE32(ds64 + 4, kDS64Size);
+        writeLE64(ds64 + 8, riffSize);
+        writeLE64(ds64 + 16, dataSize);
+        writeLE64(ds64 + 24, (uint64_t) mFrames);
+        writeLE32(ds64 + 32, 0);
+        fseeko(mFile, 12, SEEK_SET);
+        if(fwrite(ds64, 1, sizeof(ds64), mFile) != sizeof(ds64)) mError = true;
+
+        fseeko(mFile, 0, SEEK_SET);
+        memcpy(b, "RF64", 4);
+        writeLE32(b + 4, 0xFFFFFFFF);
+        if(fwrite(b, 1, 8, mFile) != 8) mError = true;
+    }
+    else{
+        fseeko(mFile, 4, SEEK_SET);
+        writeLE32(b, (uint32_t) riffSize);
+        if(fwrite(b, 1, 4, mFile) != 4) mError = true;
+    }
+
+    if(mFactOffset){
+        fseeko(mFile, mFactOffset, SEEK_SET);
+        writeLE32(b, rf64 ? 0xFFFFFFFF : (uint32_t) mFrames);
+        if(fwrite(b, 1, 4, mFile) != 4) mError = true;
+    }
+
+    fseeko(mFile, mDataSizeOffset, SEEK_SET);
+    writeLE32(b, rf64 ? 0xFFFFFFFF : (uint32_t) dataSize);
+    if(fwrite(b, 1, 4, mFile) != 4) mError = true;
+
+    if(fclose(mFile) != 0) mError = true;
+    mFile = 0;
+
+    delete[] mBuffer;
+    mBuffer = 0;
+    mBufferFrames = 0;
+    mFactOffset = 0;
+
+    return !mError;
+}
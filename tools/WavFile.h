@@ -0,0 +1,85 @@
+//
+//  WavFile.h
+//
+//  Minimal WAV/RF64 reading and writing for the command line tools.
+//  wavReader memory maps the input and decodes straight from the mapping,
+//  wavWriter streams and switches the header to RF64 when the file outgrows 4 GB.
+//
+
+#ifndef WavFile_h
+#define WavFile_h
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+enum kSampleFormat{
+    kInt16,
+    kInt24,
+    kInt32,
+    kFloat32,
+    kFloat64
+};
+
+class wavReader{
+public:
+    wavReader();
+
+    ~wavReader();
+
+    //Maps path and parses its header, returns false and fills error on failure
+    bool open(const char* path, std::string& error);
+
+    void close();
+
+    int getChannels() const { return mChannels; }
+    double getSampleRate() const { return mSampleRate; }
+    int64_t getFrames() const { return mFrames; }
+    int getFormat() const { return mFormat; }
+
+    //Decodes nFrames starting at startFrame into one buffer per channel.
+    //Frames past the end of the file are written as silence
+    void read(int64_t startFrame, int nFrames, double* const* out) const;
+    void read(int64_t startFrame, int nFrames, float* const* out) const;
+
+private:
+    template <typename T>
+    void readSamples(int64_t startFrame, int nFrames, T* const* out) const;
+
+    const unsigned char* mMap;
+    size_t mMapSize;
+    const unsigned char* mData;
+    int64_t mFrames;
+    int mChannels, mFormat, mBlockAlign;
+    double mSampleRate;
+};
+
+class wavWriter{
+public:
+    wavWriter();
+
+    ~wavWriter();
+
+    bool open(const char* path, int channels, double sampleRate, int format, std::string& error);
+
+    //Encodes nFrames from one buffer per channel, samples are clipped for integer formats
+    bool write(const double* const* in, int nFrames);
+    bool write(const float* const* in, int nFrames);
+
+    //Patches the header sizes and closes the file, returns false on any write error
+    bool close();
+
+private:
+    template <typename T>
+    bool writeSamples(const T* const* in, int nFrames);
+
+    FILE* mFile;
+    unsigned char* mBuffer;
+    int mBufferFrames;
+    int64_t mFrames;
+    int mChannels, mFormat, mBlockAlign;
+    long mFactOffset, mDataSizeOffset, mDataStart;
+    bool mError;
+};
+
+#endif /* WavFile_h */
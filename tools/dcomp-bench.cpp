@@ -0,0 +1,1251 @@
+//
+//  dcomp-bench.cpp
+//
+//  Times DCompEngine on noise for every combination of mode, sidechain, filters and
+//  audition, so the engine can be benchmarked without a host.
+//
+//  usage: dcomp-bench [--float] [seconds] [blockSize] [sampleRate]
+//         dcomp-bench --verify                   checks every SIMD tier against the scalar kernels
+//         dcomp-bench --precision [sampleRate]   compares the float engine against the double one
+//         dcomp-bench --control-rate [sampleRate]  times and measures the control rate gain computer
+//         dcomp-bench --lookahead [sampleRate]     times the limiter's sliding max against a naive scan
+//         dcomp-bench --rms [sampleRate]           checks and times the RMS detector's running sum
+//         dcomp-bench --timing [blockSize] [sampleRate]  per block timing as the plugin collects it
+//         dcomp-bench --gain-table [sampleRate]   compares the gain table against the closed form curve
+//         dcomp-bench --saturation [sampleRate]   aliasing and cost of the Colored mode saturation
+//         dcomp-bench --oversampling [sampleRate] latency, cost and accuracy of the oversampler
+//         dcomp-bench --channels [sampleRate]     one multichannel engine against one engine per channel
+//         dcomp-bench --bank [sampleRate]         a compressorBank against one compressor per strip
+//         dcomp-bench --kernels [sampleRate]      the specialized kernels against the per-sample reference loop
+//         dcomp-bench --params [blockSize] [sampleRate]  block times with a thread writing parameters and without
+//
+//  DCOMP_SIMD=scalar|sse2|avx2|avx512 caps the kernel tier used by the benchmark.
+//
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+#include "DCompEngine.h"
+#include "BlockTimer.h"
+#include "CompressorBank.h"
+#include "DSPKernels.h"
+#include "DSPMath.h"
+#include "ParamTransport.h"
+
+namespace{
+    //Largest |a - b| relative to max(1, |b|)
+    template <typename T>
+    double maxError(const std::vector<T>& a, const std::vector<T>& b){
+        double err = 0.;
+        for(size_t i = 0; i < a.size(); ++i){
+            err = std::max(err, std::fabs((double) a[i] - (double) b[i]) / std::max(1., std::fabs((double) b[i])));
+        }
+        return err;
+    }
+
+    template <typename T>
+    bool check(const char* tier, const char* kernel, const std::vector<T>& out, const std::vector<T>& ref, double tolerance){
+        double err = maxError(out, ref);
+        bool ok = err <= tolerance;
+        printf("%-8s %-14s max error %.3g %s\n", tier, kernel, err, ok ? "ok" : "FAILED");
+        return ok;
+    }
+
+    //Error bounds checked by verifyKernels for one sample type
+    struct tolerances{
+        double dB;          //ampToDB against libm, absolute in dB
+        double amp;         //dbToAmp against libm, relative
+        double tier;        //wide tiers against the scalar tier
+    };
+
+    //Runs every kernel of every tier this machine supports on the same random data and
+    //compares against the scalar tier, plus the dB conversions against libm
+    template <typename T>
+    bool verifyKernels(const char* type, const tolerances& tol){
+        //Odd length so the scalar tails of the wide tiers are covered too
+        const int n = 4099;
+        const dspKernels* scalar = getDSPKernels(kTierScalar);
+
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<double> logAmp(-12., 1.), db(-150., 40.), sample(-2., 2.), unit(0., 1.);
+        std::vector<T> amp(n), dB(n), x(n), y(n), w(n);
+        for(int i = 0; i < n; ++i){
+            amp[i] = (T) (std::pow(10., logAmp(rng)) * (i & 1 ? -1. : 1.));
+            dB[i] = (T) db(rng);
+            x[i] = (T) sample(rng);
+            y[i] = (T) sample(rng);
+            w[i] = (T) unit(rng);
+        }
+        amp[0] = 0;
+
+        std::vector<T> ref(n), out(n);
+        bool ok = true;
+
+        printf("%s kernels\n", type);
+
+        for(int t = 0; t < kNumDSPTiers; ++t){
+            const dspKernels* k = getDSPKernels(t);
+            if(!k){
+                printf("%-8d not available\n", t);
+                continue;
+            }
+
+            //Documented bounds against libm, computed in double from the same inputs
+            k->ampToDB(&amp[0], &out[0], n);
+            double absErr = 0.;
+            for(int i = 1; i < n; ++i) absErr = std::max(absErr, std::fabs(out[i] - 20. * std::log10(std::fabs((double) amp[i]))));
+            printf("%-8s %-14s max error %.3g %s\n", k->name, "ampToDB/libm", absErr, absErr <= tol.dB ? "ok" : "FAILED");
+            ok &= absErr <= tol.dB;
+            k->dbToAmp(&dB[0], &out[0], n);
+            double relErr = 0.;
+            for(int i = 0; i < n; ++i) relErr = std::max(relErr, std::fabs(out[i] / std::pow(10., dB[i] / 20.) - 1.));
+            printf("%-8s %-14s max error %.3g %s\n", k->name, "dbToAmp/libm", relErr, relErr <= tol.amp ? "ok" : "FAILED");
+            ok &= relErr <= tol.amp;
+
+            if(t == kTierScalar) continue;
+
+            scalar->ampToDB(&amp[0], &ref[0], n);
+            k->ampToDB(&amp[0], &out[0], n);
+            ok &= check(k->name, "ampToDB", out, ref, tol.tier);
+
+            scalar->dbToAmp(&dB[0], &ref[0], n);
+            k->dbToAmp(&dB[0], &out[0], n);
+            ok &= check(k->name, "dbToAmp", out, ref, tol.tier);
+
+            scalar->gainComputer(&dB[0], &ref[0], n, -20., 0.75, -25., -15., -0.0375);
+            k->gainComputer(&dB[0], &out[0], n, -20., 0.75, -25., -15., -0.0375);
+            ok &= check(k->name, "gainComputer", out, ref, tol.tier);
+
+            scalar->saturate(&x[0], &ref[0], n, 0.4, -0.5);
+            k->saturate(&x[0], &out[0], n, 0.4, -0.5);
+            ok &= check(k->name, "saturate", out, ref, tol.tier);
+
+            //The ADAA quotient divides rounding differences between tiers by the step, allow for that
+            T lastRef = 0, last = 0;
+            scalar->saturateADAA(&x[0], &ref[0], n, 0.4, -0.5, &lastRef);
+            k->saturateADAA(&x[0], &out[0], n, 0.4, -0.5, &last);
+            ok &= check(k->name, "saturateADAA", out, ref, std::max(tol.tier, 1e-9));
+
+            scalar->applyGain(&x[0], &w[0], &ref[0], n);
+            k->applyGain(&x[0], &w[0], &out[0], n);
+            ok &= check(k->name, "applyGain", out, ref, 0.);
+
+            scalar->mixDryWet(&x[0], &y[0], &w[0], &ref[0], n);
+            k->mixDryWet(&x[0], &y[0], &w[0], &out[0], n);
+            ok &= check(k->name, "mixDryWet", out, ref, tol.tier);
+
+            ref = w;
+            out = w;
+            scalar->linkMax(&x[0], &ref[0], n, 0.7);
+            k->linkMax(&x[0], &out[0], n, 0.7);
+            ok &= check(k->name, "linkMax", out, ref, 0.);
+
+            ref = w;
+            out = w;
+            scalar->linkSum(&x[0], &ref[0], n, 0.7);
+            k->linkSum(&x[0], &out[0], n, 0.7);
+            ok &= check(k->name, "linkSum", out, ref, tol.tier);
+
+            //13 lanes so the wide tiers hand some to the scalar tail, each with its own settings
+            {
+                const int lanes = 13, frames = n / lanes;
+                std::vector<T> state[2][2], settings[8];
+                for(int j = 0; j < 8; ++j) settings[j].resize(lanes);
+                for(int c = 0; c < lanes; ++c){
+                    settings[0][c] = (T) (0.9 + 0.0999 * unit(rng));      //attack
+                    settings[1][c] = (T) (0.99 + 0.00999 * unit(rng));    //release
+                    settings[2][c] = (T) (int) (40. * unit(rng));         //hold
+                    settings[3][c] = (T) (-40. * unit(rng));              //threshold
+                    settings[4][c] = (T) unit(rng);                       //slope
+                    settings[5][c] = settings[3][c] - (T) 3;              //knee
+                    settings[6][c] = settings[3][c] + (T) 3;
+                    settings[7][c] = (T) -0.5 * settings[4][c] / (T) 6;
+                }
+                for(int r = 0; r < 2; ++r){
+                    state[r][0].assign(lanes, (T) 0);
+                    state[r][1].assign(lanes, (T) 0);
+                }
+                const compressorLanes<T> laneRef = {&state[0][0][0], &state[0][1][0], &settings[0][0], &settings[1][0], &settings[2][0],
+                                                    &settings[3][0], &settings[4][0], &settings[5][0], &settings[6][0], &settings[7][0]};
+                const compressorLanes<T> laneOut = {&state[1][0][0], &state[1][1][0], &settings[0][0], &settings[1][0], &settings[2][0],
+                                                    &settings[3][0], &settings[4][0], &settings[5][0], &settings[6][0], &settings[7][0]};
+                std::fill(ref.begin(), ref.end(), (T) 0);
+                std::fill(out.begin(), out.end(), (T) 0);
+                scalar->compressBank(&amp[0], &ref[0], frames, lanes, lanes, laneRef);
+                k->compressBank(&amp[0], &out[0], frames, lanes, lanes, laneOut);
+                //The envelope recursion carries rounding differences between tiers forward
+                ok &= check(k->name, "compressBank", out, ref, std::max(tol.tier, sizeof(T) == sizeof(float) ? 1e-5 : 1e-12));
+            }
+
+            //Reads taps - 1 samples of history before its first input
+            const double coeffs[19] = {0.01, -0.03, 0.07, -0.12, 0.2, 0.31, 0.45, 0.62, 0.8, 1., 0.8, 0.62, 0.45, 0.31, 0.2, -0.12, 0.07, -0.03, 0.01};
+            scalar->fir(&x[18], &ref[0], n - 18, coeffs, 19);
+            k->fir(&x[18], &out[0], n - 18, coeffs, 19);
+            ok &= check(k->name, "fir", out, ref, tol.tier);
+
+            //In place
+            out = x;
+            k->applyGain(&out[0], &w[0], &out[0], n);
+            scalar->applyGain(&x[0], &w[0], &ref[0], n);
+            ok &= check(k->name, "in place", out, ref, 0.);
+        }
+
+        return ok;
+    }
+
+    //Sets up an engine for one of the 32 flag combinations used by the benchmark
+    template <typename T>
+    void configure(DCompEngineT<T>& engine, int config, double sampleRate){
+        engine.init(sampleRate);
+        engine.setThreshold(-12.);
+        engine.setMode(config & 1 ? DCompEngine::kColored : DCompEngine::kClean);
+        engine.setSidechainEnable((config & 2) != 0);
+        engine.setLPEnable((config & 4) != 0);
+        engine.setHPEnable((config & 8) != 0);
+        engine.setSidechainAudition((config & 16) != 0);
+    }
+
+    //Four channels of noise with a slow level sweep so the compressor keeps moving. Samples
+    //are rounded to float so the float and double engines see the same input
+    void makeTestSignal(std::vector<double>& in, int nFrames, double sampleRate){
+        in.resize(4 * nFrames);
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<double> noise(-1., 1.);
+        for(int i = 0; i < nFrames; ++i){
+            const double level = 0.5 + 0.5 * std::sin(2. * M_PI * 3. * i / sampleRate);
+            for(int c = 0; c < 4; ++c) in[c * nFrames + i] = (float) (level * noise(rng));
+        }
+    }
+
+    //Renders the same noise through the float and double engines for every configuration
+    //and reports how far the float output strays, relative to full scale
+    int comparePrecision(double sampleRate){
+        const int nFrames = (int) sampleRate * 2;
+        const double tolerance = 1e-6;
+
+        std::vector<double> in, out(2 * nFrames);
+        makeTestSignal(in, nFrames, sampleRate);
+        std::vector<float> inF(in.begin(), in.end()), outF(2 * nFrames);
+
+        printf("float vs double engine, %d frames, %s kernels\n", nFrames, getDSPKernels().name);
+        printf("mode     sc lp hp aud   max error   rms error\n");
+
+        bool ok = true;
+        for(int config = 0; config < 32; ++config){
+            DCompEngine engine;
+            DCompEngineFloat engineF;
+            configure(engine, config, sampleRate);
+            configure(engineF, config, sampleRate);
+
+            engine.process(&in[0], &in[nFrames], &in[2 * nFrames], &in[3 * nFrames], &out[0], &out[nFrames], nFrames);
+            engineF.process(&inF[0], &inF[nFrames], &inF[2 * nFrames], &inF[3 * nFrames], &outF[0], &outF[nFrames], nFrames);
+
+            double maxErr = 0., sumSq = 0.;
+            for(int i = 0; i < 2 * nFrames; ++i){
+                const double e = std::fabs(outF[i] - out[i]);
+                maxErr = std::max(maxErr, e);
+                sumSq += e * e;
+            }
+            ok &= maxErr <= tolerance;
+
+            printf("%-8s %2d %2d %2d %3d   %9.3g   %9.3g %s\n", config & 1 ? "colored" : "clean", (config >> 1) & 1, (config >> 2) & 1, (config >> 3) & 1, (config >> 4) & 1,
+                   maxErr, std::sqrt(sumSq / (2 * nFrames)), maxErr <= tolerance ? "ok" : "FAILED");
+        }
+
+        printf(ok ? "float engine within %.0g of double\n" : "float engine exceeds %.0g\n", tolerance);
+        return ok ? 0 : 1;
+    }
+
+    //Times control rate gain computation against full rate and measures how far its output
+    //strays, for fast settings and for the slow settings typical on buses
+    int compareControlRate(double sampleRate){
+        const int nFrames = (int) sampleRate * 10;
+        const int blockSize = 512;
+        const int intervals[] = {1, 8, 16, 32};
+        const double settings[2][2] = {{1., 50.}, {30., 300.}};   //attack, release (ms)
+
+        std::vector<double> in, ref(2 * nFrames), out(2 * nFrames);
+        makeTestSignal(in, nFrames, sampleRate);
+
+        printf("control rate vs full rate, %d frames, block %d, %s kernels\n", nFrames, blockSize, getDSPKernels().name);
+        printf("attack release interval interp   ns/sample   max error   rms error   max dB\n");
+
+        for(int setting = 0; setting < 2; ++setting){
+            for(int i = 0; i < 4; ++i){
+                for(int interp = 0; interp < (intervals[i] > 1 ? 2 : 1); ++interp){
+                    DCompEngine engine;
+                    engine.setAttack(settings[setting][0]);
+                    engine.setRelease(settings[setting][1]);
+                    engine.setThreshold(-18.);
+                    engine.setControlRate(intervals[i], interp);
+                    engine.init(sampleRate);
+
+                    std::vector<double>& o = intervals[i] == 1 ? ref : out;
+                    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                    for(int offset = 0; offset < nFrames; offset += blockSize){
+                        const int n = std::min(blockSize, nFrames - offset);
+                        engine.process(&in[offset], &in[nFrames + offset], 0, 0, &o[offset], &o[nFrames + offset], n);
+                    }
+                    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+                    //Output error relative to full scale, and the gain difference in dB where the output is above -60 dB
+                    double maxErr = 0., sumSq = 0., maxGainErr = 0.;
+                    for(int k = 0; k < 2 * nFrames; ++k){
+                        const double e = std::fabs(o[k] - ref[k]);
+                        maxErr = std::max(maxErr, e);
+                        sumSq += e * e;
+                        if(std::fabs(ref[k]) > 1e-3) maxGainErr = std::max(maxGainErr, std::fabs(ampToDB(o[k] / ref[k])));
+                    }
+
+                    printf("%6.0f %7.0f %8d %6s   %9.2f   %9.3g   %9.3g   %9.3g\n", settings[setting][0], settings[setting][1], intervals[i], intervals[i] == 1 ? "-" : interp == DCompEngine::kInterpolateLinear ? "linear" : "dB",
+                           elapsed.count() * 1e9 / nFrames, maxErr, std::sqrt(sumSq / (2 * nFrames)), maxGainErr);
+                }
+            }
+        }
+
+        return 0;
+    }
+
+    //Sliding window maximum by rescanning the whole window every sample, the reference for slidingMax
+    class naiveMax{
+    public:
+        void setWindow(int length){
+            history.assign(length, 0.);
+            pos = 0;
+        }
+
+        double process(double x){
+            history[pos] = x;
+            if(++pos == (int) history.size()) pos = 0;
+            double m = 0.;
+            for(size_t i = 0; i < history.size(); ++i) m = std::max(m, history[i]);
+            return m;
+        }
+
+    private:
+        std::vector<double> history;
+        int pos;
+    };
+
+    //Times slidingMax against a naive window scan at 1-10 ms, then checks that the Limiter
+    //mode holds its ceiling and delays the output by exactly the latency it reports
+    int compareLookahead(double sampleRate){
+        const int nFrames = (int) sampleRate * 10;
+        const double lookaheads[] = {1., 2., 5., 10.};
+        bool ok = true;
+
+        std::vector<double> in;
+        makeTestSignal(in, nFrames, sampleRate);
+        std::vector<double> mag(nFrames), fast(nFrames), naive(nFrames);
+        for(int i = 0; i < nFrames; ++i) mag[i] = std::max(std::fabs(in[i]), std::fabs(in[nFrames + i]));
+
+        printf("sliding max, %d frames at %.0f Hz\n", nFrames, sampleRate);
+        printf("lookahead  window   deque ns/sample   naive ns/sample\n");
+        for(int l = 0; l < 4; ++l){
+            const int window = lookaheadLimiter::getLookaheadSamples(lookaheads[l], sampleRate) + 1;
+
+            slidingMax deque;
+            deque.init(window);
+            deque.setWindow(window);
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for(int i = 0; i < nFrames; ++i) fast[i] = deque.process(mag[i]);
+            std::chrono::duration<double> dequeTime = std::chrono::steady_clock::now() - start;
+
+            naiveMax scan;
+            scan.setWindow(window);
+            start = std::chrono::steady_clock::now();
+            for(int i = 0; i < nFrames; ++i) naive[i] = scan.process(mag[i]);
+            std::chrono::duration<double> naiveTime = std::chrono::steady_clock::now() - start;
+
+            const bool same = fast == naive;
+            ok &= same;
+            printf("%6.0f ms %8d   %15.2f   %15.2f %s\n", lookaheads[l], window, dequeTime.count() * 1e9 / nFrames, naiveTime.count() * 1e9 / nFrames, same ? "ok" : "MISMATCH");
+        }
+
+        printf("limiter, threshold -6 dB, 12 dB hotter input\n");
+        printf("lookahead  latency   ns/sample   peak out (dB)\n");
+        std::vector<double> loud(in), out(2 * nFrames);
+        for(size_t i = 0; i < loud.size(); ++i) loud[i] *= 4.;
+
+        for(int l = 0; l < 4; ++l){
+            DCompEngine engine;
+            engine.setMode(DCompEngine::kLimiter);
+            engine.setLookahead(lookaheads[l]);
+            engine.setThreshold(-6.);
+            engine.setRelease(50.);
+            engine.init(sampleRate);
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for(int offset = 0; offset < nFrames; offset += 512){
+                const int n = std::min(512, nFrames - offset);
+                engine.process(&loud[offset], &loud[nFrames + offset], 0, 0, &out[offset], &out[nFrames + offset], n);
+            }
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+            //Skip the first 100 ms while the threshold smoother settles
+            double peak = 0.;
+            for(int c = 0; c < 2; ++c){
+                for(int i = (int) (sampleRate * 0.1); i < nFrames; ++i) peak = std::max(peak, std::fabs(out[c * nFrames + i]));
+            }
+            const bool held = ampToDB(peak) <= -6. + 1e-9;
+
+            //An impulse below the threshold comes out unchanged, exactly latency samples later
+            std::vector<double> impulse(1024, 0.), response(1024);
+            impulse[10] = 0.25;
+            engine.init(sampleRate);
+            engine.process(&impulse[0], &impulse[0], 0, 0, &response[0], &response[0], 1024);
+            const int latency = engine.getLatency();
+            const bool aligned = latency == DCompEngine::getLatency(DCompEngine::kLimiter, lookaheads[l], sampleRate) && std::fabs(response[10 + latency] - 0.25) < 1e-9;
+
+            ok &= held && aligned;
+            printf("%6.0f ms %8d   %9.2f   %13.6f %s\n", lookaheads[l], latency, elapsed.count() * 1e9 / nFrames, ampToDB(peak), held && aligned ? "ok" : "FAILED");
+        }
+
+        return ok ? 0 : 1;
+    }
+
+    //RMS over the window by summing it again every sample, the reference for the running sum
+    double naiveRMS(const std::vector<double>& x, int i, int window){
+        double sum = 0.;
+        for(int k = std::max(0, i - window + 1); k <= i; ++k) sum += x[k] * x[k];
+        return std::sqrt(sum / window);
+    }
+
+    //Times the RMS detector's running sum against a naive window sum at 5-300 ms and checks they
+    //agree, including after a long loud passage, then times the engine with each detector
+    int compareRMS(double sampleRate){
+        const int nFrames = (int) sampleRate * 2;
+        const double windows[] = {5., 50., 300.};
+        bool ok = true;
+
+        std::vector<double> in;
+        makeTestSignal(in, nFrames, sampleRate);
+        in.resize(nFrames);
+        std::vector<double> fast(nFrames), naive(nFrames);
+
+        printf("rms detector, %d frames at %.0f Hz\n", nFrames, sampleRate);
+        printf("   window   running ns/sample   naive ns/sample   max rel error\n");
+        for(int w = 0; w < 3; ++w){
+            envFollower detector(0., 1., 0., sampleRate);
+            detector.initRMS(windows[w]);
+            detector.setDetectMode(envFollower::kRMS);
+            detector.setRMSWindow(windows[w]);
+            const int window = (int) (windows[w] * 0.001 * sampleRate + 0.5);
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for(int i = 0; i < nFrames; ++i) fast[i] = detector.detect(in[i]);
+            std::chrono::duration<double> runningTime = std::chrono::steady_clock::now() - start;
+
+            start = std::chrono::steady_clock::now();
+            for(int i = 0; i < nFrames; ++i) naive[i] = naiveRMS(in, i, window);
+            std::chrono::duration<double> naiveTime = std::chrono::steady_clock::now() - start;
+
+            const double err = maxError(fast, naive);
+            ok &= err < 1e-9;
+            printf("%6.0f ms   %17.2f   %15.2f   %13.3g %s\n", windows[w], runningTime.count() * 1e9 / nFrames, naiveTime.count() * 1e9 / nFrames, err, err < 1e-9 ? "ok" : "FAILED");
+        }
+
+        //Ten minutes at full scale, then a second 100 dB quieter. Without the drift correction the
+        //running sum keeps rounding error from the loud part and the quiet RMS is off by about 1e-3
+        {
+            const int loudFrames = (int) sampleRate * 600, quietFrames = (int) sampleRate;
+            std::mt19937 rng(2);
+            std::uniform_real_distribution<double> noise(-1., 1.);
+            std::vector<double> quiet(quietFrames);
+
+            envFollower detector(0., 1., 0., sampleRate);
+            detector.initRMS(50.);
+            detector.setDetectMode(envFollower::kRMS);
+            detector.setRMSWindow(50.);
+            for(int i = 0; i < loudFrames; ++i) detector.detect(noise(rng));
+
+            double err = 0.;
+            const int window = (int) (0.05 * sampleRate + 0.5);
+            for(int i = 0; i < quietFrames; ++i){
+                quiet[i] = noise(rng) * 1e-5;
+                const double rms = detector.detect(quiet[i]);
+                if(i >= window) err = std::max(err, std::fabs(rms - naiveRMS(quiet, i, window)) / naiveRMS(quiet, i, window));
+            }
+            ok &= err < 1e-9;
+            printf("10 min at 0 dB, then -100 dB: max rel error %.3g %s\n", err, err < 1e-9 ? "ok" : "FAILED");
+        }
+
+        printf("engine, clean mode, 50 ms window\n");
+        printf("detector   ns/sample\n");
+        std::vector<double> stereo, out(2 * nFrames);
+        makeTestSignal(stereo, nFrames, sampleRate);
+        for(int d = 0; d < 2; ++d){
+            DCompEngine engine;
+            engine.setThreshold(-20.);
+            engine.setDetector(d);
+            engine.setRMSWindow(50.);
+            engine.init(sampleRate);
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for(int offset = 0; offset < nFrames; offset += 512){
+                const int n = std::min(512, nFrames - offset);
+                engine.process(&stereo[offset], &stereo[nFrames + offset], 0, 0, &out[offset], &out[nFrames + offset], n);
+            }
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            printf("%-8s   %9.2f\n", d == envFollower::kRMS ? "rms" : "peak", elapsed.count() * 1e9 / nFrames);
+        }
+
+        return ok ? 0 : 1;
+    }
+
+    //Runs the engine under a blockTimer the way DComp does and prints what it collected,
+    //plus the cost of the timer itself
+    int reportTiming(int blockSize, double sampleRate){
+        if(!blockTimer::isEnabled()){
+            printf("block timing is compiled out (DCOMP_BLOCK_TIMING=0)\n");
+            return 0;
+        }
+
+        //Cost of one begin/end pair around an empty block
+        blockTimer idle;
+        idle.setSampleRate(sampleRate);
+        const int pairs = 1000000;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for(int i = 0; i < pairs; ++i){
+            idle.begin();
+            idle.end(blockSize);
+        }
+        std::chrono::duration<double> overhead = std::chrono::steady_clock::now() - start;
+
+        const int nFrames = (int) sampleRate * 10;
+        std::vector<double> in, out(2 * blockSize);
+        makeTestSignal(in, nFrames, sampleRate);
+
+        DCompEngine engine;
+        engine.setThreshold(-20.);
+        engine.init(sampleRate);
+
+        blockTimer timer;
+        timer.setSampleRate(sampleRate);
+        timer.setDeadlineFraction(0.01);
+        for(int offset = 0; offset + blockSize <= nFrames; offset += blockSize){
+            timer.begin();
+            engine.process(&in[offset], &in[nFrames + offset], 0, 0, &out[0], &out[blockSize], blockSize);
+            timer.end(blockSize);
+        }
+
+        blockTimingStats stats;
+        timer.read(stats);
+        uint64_t histogramTotal = 0;
+        for(int i = 0; i < blockTimingStats::kBuckets; ++i) histogramTotal += stats.histogram[i];
+
+        printf("timer overhead %.1f ns per block (%.3f%% of a %d sample deadline at %.0f Hz)\n", overhead.count() * 1e9 / pairs, 100. * overhead.count() / pairs / (blockSize / sampleRate), blockSize, sampleRate);
+        printf("%llu blocks of %d, %.2f ns/sample, mean load %.3f%%, peak load %.3f%%, %llu over 1%% of the deadline\n",
+               (unsigned long long) stats.blocks, blockSize, (double) stats.busyNS / stats.samples, 100. * stats.loadSum / stats.blocks, 100. * stats.peakLoad, (unsigned long long) stats.overruns);
+        printf("ns/sample   blocks\n");
+        for(int i = 0; i < blockTimingStats::kBuckets; ++i){
+            if(!stats.histogram[i]) continue;
+            printf("%5d-%-5d %7llu\n", i ? 1 << (i - 1) : 0, 1 << i, (unsigned long long) stats.histogram[i]);
+        }
+
+        timer.requestReset();
+        timer.begin();
+        timer.end(0);
+        timer.read(stats);
+
+        const bool ok = histogramTotal == (uint64_t) (nFrames / blockSize) && stats.blocks == 0;
+        printf("%s\n", ok ? "ok" : "FAILED");
+        return ok ? 0 : 1;
+    }
+
+    //ns per sample of the gain computer kernel and of a table lookup, on 64 sample blocks
+    template <typename T>
+    void timeGainComputer(const compressor& comp, const gainCurveTable& table){
+        const int n = 64, reps = 200000;
+        std::vector<T> env(n), gr(n);
+        std::mt19937 rng(3);
+        std::uniform_real_distribution<double> level(-60., 10.);
+        for(int i = 0; i < n; ++i) env[i] = (T) level(rng);
+
+        compressor c = comp;
+        volatile double sink = 0.;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for(int r = 0; r < reps; ++r){
+            c.setGainTable(0);
+            c.processBlock(&env[0], &gr[0], n);
+            sink += gr[r & (n - 1)];
+        }
+        std::chrono::duration<double> closedForm = std::chrono::steady_clock::now() - start;
+
+        start = std::chrono::steady_clock::now();
+        for(int r = 0; r < reps; ++r){
+            c.setGainTable(&table);
+            c.processBlock(&env[0], &gr[0], n);
+            sink += gr[r & (n - 1)];
+        }
+        std::chrono::duration<double> lookup = std::chrono::steady_clock::now() - start;
+
+        printf("%-6s   %11.2f   %9.2f\n", sizeof(T) == sizeof(float) ? "float" : "double", closedForm.count() * 1e9 / (reps * n), lookup.count() * 1e9 / (reps * n));
+    }
+
+    //Checks the interpolated table against the closed form over the plugin's threshold, ratio
+    //and knee ranges, times compressor::processBlock with each, then runs the engine with the
+    //table rebuilt between blocks from the curve the engine publishes, as a builder thread would
+    int compareGainTable(double sampleRate){
+        const double ratios[] = {1., 1.5, 2., 4., 10., 100.};
+        const double knees[] = {0., 0.2, 1., 2.};
+        bool ok = true;
+
+        double err = 0.;
+        gainCurveTable table;
+        for(double threshold = -32.; threshold <= 2.; threshold += 0.5){
+            for(int r = 0; r < 6; ++r){
+                for(int k = 0; k < 4; ++k){
+                    compressor comp(1., 100., 0., ratios[r], knees[k], sampleRate);
+                    comp.setThreshold(threshold);
+                    table.build(comp);
+                    for(double e = gainCurveTable::kMinDB - 20.; e < gainCurveTable::kMaxDB + 40.; e += 0.01){
+                        err = std::max(err, std::fabs(table.lookup(e) - comp.getGainReduction(e)));
+                    }
+                }
+            }
+        }
+        ok &= err < 0.02;
+        printf("gain table, %d steps of %g dB: max error %.4f dB %s\n", (int) gainCurveTable::kSize, 1. / gainCurveTable::kStepsPerDB, err, err < 0.02 ? "ok" : "FAILED");
+
+        compressor comp(1., 100., 0., 4., 1., sampleRate);
+        comp.setThreshold(-20.);
+        table.build(comp);
+        printf("%s kernels, 64 sample blocks, envelope + gain computer\n", getDSPKernels().name);
+        printf("         closed form       table   (ns/sample)\n");
+        timeGainComputer<double>(comp, table);
+        timeGainComputer<float>(comp, table);
+
+        //Threshold swept every block, the builder rebuilds whenever the published curve moves
+        const int nFrames = (int) sampleRate * 4;
+        std::vector<double> in, direct(2 * nFrames), tabled(2 * nFrames);
+        makeTestSignal(in, nFrames, sampleRate);
+
+        printf("engine, clean mode, threshold automated\n");
+        printf("gain computer   ns/sample   rebuilds   us each\n");
+        for(int useTable = 0; useTable < 2; ++useTable){
+            compressorCurve curve;
+            gainCurveBuffer buffer;
+            compressor shape;
+            int rebuilds = 0;
+            DCompEngine engine;
+            engine.setKnee(1.);
+            engine.setThreshold(-30.);
+            engine.setCurve(&curve);
+            engine.init(sampleRate);
+            if(useTable){
+                curve.update(shape);
+                buffer.update(shape);
+                engine.setGainTable(&buffer);
+            }
+
+            //Only process() is timed, rebuilding is the builder's cost
+            std::vector<double>& out = useTable ? tabled : direct;
+            std::chrono::duration<double> elapsed(0.), building(0.);
+            for(int offset = 0; offset < nFrames; offset += 512){
+                const int n = std::min(512, nFrames - offset);
+                engine.setThreshold(-30. + 20. * offset / nFrames);
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                engine.process(&in[offset], &in[nFrames + offset], 0, 0, &out[offset], &out[nFrames + offset], n);
+                elapsed += std::chrono::steady_clock::now() - start;
+
+                start = std::chrono::steady_clock::now();
+                if(useTable && curve.update(shape)){
+                    buffer.update(shape);
+                    ++rebuilds;
+                }
+                building += std::chrono::steady_clock::now() - start;
+            }
+            printf("%-13s   %9.2f   %8d %9.1f\n", useTable ? "table" : "closed form", elapsed.count() * 1e9 / nFrames, rebuilds, rebuilds ? building.count() * 1e6 / rebuilds : 0.);
+        }
+
+        //The table follows the curve one block late, so allow for that on top of the interpolation
+        const double outErr = maxError(tabled, direct);
+        ok &= outErr < 0.05;
+        printf("max output difference %.4f %s\n", outErr, outErr < 0.05 ? "ok" : "FAILED");
+
+        return ok ? 0 : 1;
+    }
+
+    //In place radix 2 FFT, size a power of two
+    void fft(std::vector<std::complex<double> >& a){
+        const size_t n = a.size();
+        for(size_t i = 1, j = 0; i < n; ++i){
+            size_t bit = n >> 1;
+            for(; j & bit; bit >>= 1) j ^= bit;
+            j ^= bit;
+            if(i < j) std::swap(a[i], a[j]);
+        }
+        for(size_t len = 2; len <= n; len <<= 1){
+            const std::complex<double> w = std::polar(1., -2. * M_PI / len);
+            for(size_t i = 0; i < n; i += len){
+                std::complex<double> wk(1., 0.);
+                for(size_t k = 0; k < len / 2; ++k, wk *= w){
+                    const std::complex<double> u = a[i + k], v = a[i + k + len / 2] * wk;
+                    a[i + k] = u + v;
+                    a[i + k + len / 2] = u - v;
+                }
+            }
+        }
+    }
+
+    //Power outside the harmonics of the test tone relative to the fundamental, in dB. The tone
+    //sits on bin k of an N point FFT, so every harmonic, aliased or not, falls on an exact bin
+    //and anything that is not a harmonic below Nyquist is aliasing
+    double aliasingDB(const std::vector<double>& y, int k){
+        const int n = (int) y.size();
+        std::vector<std::complex<double> > spectrum(y.begin(), y.end());
+        fft(spectrum);
+
+        double fundamental = std::norm(spectrum[k]), aliased = 0.;
+        std::vector<bool> harmonic(n / 2 + 1, false);
+        for(long h = k; h <= n / 2; h += k) harmonic[h] = true;
+        for(int b = 1; b <= n / 2; ++b){
+            if(!harmonic[b]) aliased += std::norm(spectrum[b]);
+        }
+        return 10. * std::log10(aliased / fundamental);
+    }
+
+    //The shaper oversampled the way the engine does it: up, plain shaper, down in 64 sample blocks
+    void saturateOversampled(oversampler<double>& os, const double* in, double* out, int n, double upper, double lower){
+        const dspKernels& k = getDSPKernels();
+        double high[64 * oversampler<double>::kMaxFactor];
+        for(int offset = 0; offset < n; offset += 64){
+            const int block = std::min(64, n - offset);
+            os.up(in + offset, high, block);
+            k.saturate(high, high, block * os.getFactor(), upper, lower);
+            os.down(high, out + offset, block);
+        }
+    }
+
+    //Aliasing and cost of the Colored mode shaper as it was (plain), with antiderivative
+    //antialiasing (what the engine uses without oversampling) and oversampled 2x, 4x and 8x, on full scale tones
+    int compareSaturation(double sampleRate){
+        const int n = 1 << 16;
+        const int tones[] = {1637, 6829};   //Primes, about 1.2 and 5 kHz at 48 kHz
+        const double upper = dbToAmp(-12. * .9), lower = -dbToAmp(-12.);
+        const dspKernels& k = getDSPKernels();
+        bool ok = true;
+
+        printf("%s kernels, threshold -12 dB, tone at 0.9\n", k.name);
+        printf("    tone   plain dB    adaa dB      2x dB      4x dB      8x dB\n");
+        for(int t = 0; t < 2; ++t){
+            //Two periods of the FFT length, the second is measured so the filters have settled
+            std::vector<double> x(2 * n), plain(2 * n), adaa(2 * n), oversampled(2 * n);
+            for(int i = 0; i < 2 * n; ++i) x[i] = 0.9 * std::sin(2. * M_PI * tones[t] * (i % n) / n);
+
+            double last = 0.;
+            k.saturate(&x[0], &plain[0], 2 * n, upper, lower);
+            k.saturateADAA(&x[0], &adaa[0], 2 * n, upper, lower, &last);
+
+            const double plainDB = aliasingDB(std::vector<double>(plain.begin() + n, plain.end()), tones[t]);
+            const double adaaDB = aliasingDB(std::vector<double>(adaa.begin() + n, adaa.end()), tones[t]);
+            double osDB[3];
+            for(int f = 0; f < 3; ++f){
+                oversampler<double> os;
+                os.setFactor(2 << f);
+                saturateOversampled(os, &x[0], &oversampled[0], 2 * n, upper, lower);
+                osDB[f] = aliasingDB(std::vector<double>(oversampled.begin() + n, oversampled.end()), tones[t]);
+            }
+            const bool better = adaaDB < plainDB && osDB[0] < plainDB && osDB[2] < osDB[0];
+            ok &= better;
+            printf("%6.0f Hz   %8.1f   %8.1f   %8.1f   %8.1f   %8.1f %s\n", tones[t] * sampleRate / n, plainDB, adaaDB, osDB[0], osDB[1], osDB[2], better ? "ok" : "FAILED");
+        }
+
+        //Cost on noise in 64 sample blocks, as the engine calls it
+        std::vector<double> noise;
+        makeTestSignal(noise, n, sampleRate);
+        std::vector<double> out(64);
+        double last = 0.;
+        oversampler<double> os;
+        std::chrono::duration<double> elapsed[5];
+        for(int method = 0; method < 5; ++method){
+            if(method >= 2) os.setFactor(1 << (method - 1));
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for(int offset = 0; offset + 64 <= n; offset += 64){
+                if(method == 0) k.saturate(&noise[offset], &out[0], 64, upper, lower);
+                else if(method == 1) k.saturateADAA(&noise[offset], &out[0], 64, upper, lower, &last);
+                else saturateOversampled(os, &noise[offset], &out[0], 64, upper, lower);
+            }
+            elapsed[method] = std::chrono::steady_clock::now() - start;
+        }
+        printf("ns/sample  %8.2f   %8.2f   %8.2f   %8.2f   %8.2f\n", elapsed[0].count() * 1e9 / n, elapsed[1].count() * 1e9 / n,
+               elapsed[2].count() * 1e9 / n, elapsed[3].count() * 1e9 / n, elapsed[4].count() * 1e9 / n);
+
+        return ok ? 0 : 1;
+    }
+
+    //Latency, cost and accuracy of each oversampling factor: up followed by down should give the
+    //input back, delayed by the reported latency, and up alone should leave only the tone
+    template <typename T>
+    bool checkOversampler(const char* type, double tolerance, double sampleRate){
+        const int n = 1 << 14;
+        const int tone = 341;               //About 1 kHz at 48 kHz, on an FFT bin
+        bool ok = true;
+
+        printf("%s, %s kernels\n", type, getDSPKernels().name);
+        printf("factor   latency   ns/sample   roundtrip error   images dB\n");
+        for(int factor = 2; factor <= oversampler<T>::kMaxFactor; factor *= 2){
+            oversampler<T> os;
+            os.setFactor(factor);
+            const int latency = oversampler<T>::getLatency(factor);
+
+            //Two periods, the second is measured so the filters have settled
+            std::vector<T> x(2 * n), y(2 * n);
+            std::vector<double> high(n * factor);
+            T buffer[64 * oversampler<T>::kMaxFactor];
+            for(int i = 0; i < 2 * n; ++i) x[i] = (T) (0.5 * std::sin(2. * M_PI * tone * (i % n) / n));
+            for(int offset = 0; offset < 2 * n; offset += 64){
+                os.up(&x[offset], buffer, 64);
+                if(offset >= n) std::copy(buffer, buffer + 64 * factor, high.begin() + (offset - n) * factor);
+                os.down(buffer, &y[offset], 64);
+            }
+
+            double err = 0.;
+            for(int i = n; i < 2 * n; ++i) err = std::max(err, std::fabs((double) y[i] - x[i - latency]));
+
+            //At the high rate the tone is still on bin tone, everything else is an image
+            std::vector<std::complex<double> > spectrum(high.begin(), high.end());
+            fft(spectrum);
+            double images = 0.;
+            for(size_t b = 1; b <= spectrum.size() / 2; ++b){
+                if((int) b != tone) images += std::norm(spectrum[b]);
+            }
+            const double imagesDB = 10. * std::log10(images / std::norm(spectrum[tone]));
+
+            //Cost of up and down on noise in 64 sample blocks, as the engine calls them
+            std::vector<double> signal;
+            makeTestSignal(signal, n, sampleRate);
+            std::vector<T> noise(signal.begin(), signal.begin() + n);
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for(int offset = 0; offset + 64 <= n; offset += 64){
+                os.up(&noise[offset], buffer, 64);
+                os.down(buffer, &y[offset], 64);
+            }
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+            const bool good = err < tolerance && imagesDB < -60.;
+            ok &= good;
+            printf("%4dx   %7d   %9.2f   %15.3g   %9.1f %s\n", factor, latency, elapsed.count() * 1e9 / n, err, imagesDB, good ? "ok" : "FAILED");
+        }
+        return ok;
+    }
+
+    int compareOversampling(double sampleRate){
+        bool ok = checkOversampler<double>("double", 1e-3, sampleRate);
+        ok &= checkOversampler<float>("float", 1e-3, sampleRate);
+        return ok ? 0 : 1;
+    }
+
+    //One engine processing every channel against one engine per channel, unlinked so both do the
+    //same work, then linked in one group to show what the shared detector saves
+    int compareChannels(double sampleRate){
+        const int nFrames = (int) sampleRate * 2;
+        const int blockSize = 256;
+        std::vector<double> signal;
+        makeTestSignal(signal, nFrames, sampleRate);
+
+        std::vector<double> in(DCompEngine::kMaxChannels * nFrames);
+        for(int c = 0; c < DCompEngine::kMaxChannels; ++c){
+            for(int i = 0; i < nFrames; ++i) in[c * nFrames + i] = signal[(c % 4) * nFrames + (i + 97 * c) % nFrames];
+        }
+        std::vector<double> out(DCompEngine::kMaxChannels * blockSize), separate;
+        bool ok = true;
+
+        printf("%d frames, block %d, %.0f Hz, %s kernels, ns/sample per channel\n", nFrames, blockSize, sampleRate, getDSPKernels().name);
+        printf("channels   separate   one engine   linked   max diff\n");
+        const int counts[] = {1, 2, 6, 12, 16};
+        for(size_t k = 0; k < sizeof(counts) / sizeof(counts[0]); ++k){
+            const int channels = counts[k];
+            double diff = 0.;
+            double ns[3];
+
+            for(int run = 0; run < 3; ++run){
+                std::vector<DCompEngine> engines(run == 0 ? channels : 1);
+                for(size_t e = 0; e < engines.size(); ++e){
+                    configure(engines[e], 1, sampleRate);
+                    for(int c = 0; c < DCompEngine::kMaxChannels; ++c) engines[e].setLinkGroup(c, run == 2 ? 0 : c);
+                }
+
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                for(int offset = 0; offset < nFrames; offset += blockSize){
+                    const int n = std::min(blockSize, nFrames - offset);
+                    const double* channelIn[DCompEngine::kMaxChannels];
+                    double* channelOut[DCompEngine::kMaxChannels];
+                    for(int c = 0; c < channels; ++c){
+                        channelIn[c] = &in[c * nFrames + offset];
+                        channelOut[c] = &out[c * blockSize];
+                    }
+
+                    if(run == 0){
+                        for(int c = 0; c < channels; ++c) engines[c].process(&channelIn[c], 0, &channelOut[c], 1, n);
+                    }
+                    else engines[0].process(channelIn, 0, channelOut, channels, n);
+                }
+                std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                ns[run] = elapsed.count() * 1e9 / nFrames / channels;
+
+                //The unlinked engine must match the separate ones, compare the last block
+                if(run == 0) separate.assign(out.begin(), out.begin() + channels * blockSize);
+                if(run == 1){
+                    for(int i = 0; i < channels * blockSize; ++i) diff = std::max(diff, std::fabs(out[i] - separate[i]));
+                }
+            }
+
+            ok &= diff == 0.;
+            printf("%8d   %8.2f   %10.2f   %6.2f   %8.3g %s\n", channels, ns[0], ns[1], ns[2], diff, diff == 0. ? "ok" : "FAILED");
+        }
+        return ok ? 0 : 1;
+    }
+
+    //K strips with their own settings through K compressor objects and through one bank, strip by
+    //strip buffers for both. Reports ns per strip sample, how many strips one core runs in real
+    //time, and the largest gain reduction difference in dB
+    template <typename T>
+    bool timeBank(double sampleRate, double tolerance){
+        const int nFrames = (int) sampleRate;
+        const int blockSize = 256;
+        std::vector<double> signal;
+        makeTestSignal(signal, nFrames, sampleRate);
+        bool ok = true;
+
+        printf("%s, %s kernels, block %d\n", sizeof(T) == sizeof(float) ? "float" : "double", getDSPKernels().name, blockSize);
+        printf("strips   separate ns   bank ns   strips/core   speedup   max diff dB\n");
+        const int counts[] = {1, 4, 16, 64, 256, 1024};
+        for(size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); ++c){
+            const int strips = counts[c];
+            std::mt19937 rng(2);
+            std::uniform_real_distribution<double> unit(0., 1.);
+
+            std::vector<compressor> separate(strips);
+            compressorBank<T> bank;
+            bank.init(strips, sampleRate);
+            for(int k = 0; k < strips; ++k){
+                const double attack = 0.1 + 50. * unit(rng), release = 10. + 500. * unit(rng), hold = 20. * unit(rng);
+                const double threshold = -30. * unit(rng), ratio = 1. + 19. * unit(rng), knee = unit(rng);
+                const int mode = unit(rng) < 0.2 ? compressor::kLimiter : compressor::kCompressor;
+                separate[k].init(attack, release, hold, ratio, knee, sampleRate);
+                separate[k].setThreshold(threshold);
+                separate[k].setMode(mode);
+                bank.setAttack(k, attack);
+                bank.setRelease(k, release);
+                bank.setHold(k, hold);
+                bank.setThreshold(k, threshold);
+                bank.setRatio(k, ratio);
+                bank.setKnee(k, knee);
+                bank.setMode(k, mode);
+            }
+
+            //Each strip gets its own stretch of the test signal, all strips share one long buffer
+            std::vector<T> in(nFrames + strips * 97);
+            for(size_t i = 0; i < in.size(); ++i) in[i] = (T) signal[i % (4 * nFrames)];
+            std::vector<T> grSeparate(strips * blockSize), grBank(strips * blockSize);
+            std::vector<const T*> level(strips);
+            std::vector<T*> grOut(strips);
+            double diff = 0., ns[2];
+
+            for(int run = 0; run < 2; ++run){
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                for(int offset = 0; offset < nFrames; offset += blockSize){
+                    const int n = std::min(blockSize, nFrames - offset);
+                    for(int k = 0; k < strips; ++k){
+                        level[k] = &in[offset + 97 * k];
+                        grOut[k] = run ? &grBank[k * blockSize] : &grSeparate[k * blockSize];
+                    }
+                    if(run == 0){
+                        for(int k = 0; k < strips; ++k) separate[k].processBlock(level[k], grOut[k], n);
+                    }
+                    else bank.process(&level[0], &grOut[0], n);
+                }
+                std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                ns[run] = elapsed.count() * 1e9 / nFrames / strips;
+            }
+
+            //Last block of each
+            for(size_t i = 0; i < grBank.size(); ++i) diff = std::max(diff, std::fabs((double) grBank[i] - grSeparate[i]));
+            ok &= diff <= tolerance;
+            printf("%6d   %11.2f   %7.2f   %11.0f   %7.2f   %11.3g %s\n", strips, ns[0], ns[1], 1e9 / (ns[1] * sampleRate), ns[0] / ns[1], diff, diff <= tolerance ? "ok" : "FAILED");
+        }
+        return ok;
+    }
+
+    int compareBank(double sampleRate){
+        //The float bank keeps its envelope in float, compressor always in double
+        bool ok = timeBank<double>(sampleRate, 1e-9);
+        ok &= timeBank<float>(sampleRate, 1e-2);
+        return ok ? 0 : 1;
+    }
+
+    //Renders in[0] and in[1] (sidechain in[2] and in[3]) through engine in 512 sample blocks into out, returns ns per sample
+    template <typename T>
+    double renderTimed(DCompEngineT<T>& engine, const std::vector<T>& in, std::vector<T>& out, int nFrames){
+        const int blockSize = 512;
+        out.resize(2 * nFrames);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for(int offset = 0; offset < nFrames; offset += blockSize){
+            const int n = std::min(blockSize, nFrames - offset);
+            engine.process(&in[offset], &in[nFrames + offset], &in[2 * nFrames + offset], &in[3 * nFrames + offset], &out[offset], &out[nFrames + offset], n);
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count() * 1e9 / nFrames;
+    }
+
+    //Every flag combination through its processKernel specialization and through the reference
+    //loop that tests the flags per sample (setReferenceKernel). The two only differ in rounding:
+    //the reference saturates and mixes a sample at a time, the kernels a block at a time
+    template <typename T>
+    bool compareKernels(double sampleRate, double tolerance){
+        const int nFrames = (int) sampleRate * 2;
+        std::vector<double> signal;
+        makeTestSignal(signal, nFrames, sampleRate);
+        const std::vector<T> in(signal.begin(), signal.end());
+        std::vector<T> kernelOut, referenceOut;
+
+        printf("%s, %s kernels\n", sizeof(T) == sizeof(float) ? "float" : "double", getDSPKernels().name);
+        printf("mode     sc lp hp aud   kernel ns/sample   reference ns/sample   speedup   max error\n");
+        bool ok = true;
+        double kernelSum = 0., referenceSum = 0.;
+        for(int config = 0; config < 32; ++config){
+            DCompEngineT<T> kernel, reference;
+            configure(kernel, config, sampleRate);
+            configure(reference, config, sampleRate);
+            reference.setReferenceKernel(true);
+
+            const double kernelNS = renderTimed(kernel, in, kernelOut, nFrames);
+            const double referenceNS = renderTimed(reference, in, referenceOut, nFrames);
+            const double err = maxError(kernelOut, referenceOut);
+            ok &= err <= tolerance;
+            kernelSum += kernelNS;
+            referenceSum += referenceNS;
+
+            printf("%-8s %2d %2d %2d %3d   %16.2f   %19.2f   %6.2fx   %9.3g%s\n", config & 1 ? "colored" : "clean", (config >> 1) & 1, (config >> 2) & 1, (config >> 3) & 1, (config >> 4) & 1,
+                   kernelNS, referenceNS, referenceNS / kernelNS, err, err <= tolerance ? "" : "   FAILED");
+        }
+        printf("mean                   %16.2f   %19.2f   %6.2fx\n", kernelSum / 32, referenceSum / 32, referenceSum / kernelSum);
+        return ok;
+    }
+
+    int compareKernels(double sampleRate){
+        bool ok = compareKernels<double>(sampleRate, 1e-12);
+        ok &= compareKernels<float>(sampleRate, 1e-6);
+        printf("%s\n", ok ? "ok" : "FAILED");
+        return ok ? 0 : 1;
+    }
+
+    //Parameters the writer thread of --params automates, the continuous ones the plugin has
+    enum EBenchParams{
+        kParamGain,
+        kParamThreshold,
+        kParamAttack,
+        kParamRelease,
+        kParamHold,
+        kParamRatio,
+        kParamKnee,
+        kParamMix,
+        kParamCutoffHP,
+        kParamCutoffLP,
+        kParamRMSWindow,
+        kNumBenchParams
+    };
+
+    //What one --params run saw on the audio thread
+    struct paramRunStats{
+        double meanUS, p999US, maxUS;               //Whole callback: transport, setters and process()
+        double transportP999NS, transportMaxNS;     //consume() and the setters alone
+        double writesPerSecond;     //Full parameter sets the writer published
+        int applied;                //Blocks that picked up a change
+    };
+
+    //Runs the engine on blockSize blocks paced in real time, as a host calls the plugin, applying
+    //the transport's values at the start of each block. With writer set another thread sets every
+    //parameter to a random value every half millisecond meanwhile
+    paramRunStats runParamWriter(bool writer, double seconds, int blockSize, double sampleRate){
+        const int nFrames = (int) (sampleRate * seconds);
+        std::vector<double> in, out(2 * blockSize);
+        makeTestSignal(in, nFrames, sampleRate);
+
+        DCompEngine engine;
+        engine.setHPEnable(true);
+        engine.setLPEnable(true);
+        engine.init(sampleRate);
+
+        paramTransport<kNumBenchParams> params;
+        std::atomic<bool> done(false);
+        std::atomic<long> writes(0);
+        std::thread writerThread;
+        if(writer){
+            writerThread = std::thread([&](){
+                std::mt19937 rng(2);
+                std::uniform_real_distribution<double> u(0., 1.);
+                while(!done.load()){
+                    params.set(kParamGain, 32. * u(rng));
+                    params.set(kParamThreshold, -32. + 34. * u(rng));
+                    params.set(kParamAttack, 250. * u(rng));
+                    params.set(kParamRelease, 10. + 990. * u(rng));
+                    params.set(kParamHold, 300. * u(rng));
+                    params.set(kParamRatio, 1. + 99. * u(rng));
+                    params.set(kParamKnee, 2. * u(rng));
+                    params.set(kParamMix, u(rng));
+                    params.set(kParamCutoffHP, 20. + 1980. * u(rng));
+                    params.set(kParamCutoffLP, 1000. + 19000. * u(rng));
+                    params.set(kParamRMSWindow, 1. + 299. * u(rng));
+                    writes.fetch_add(1);
+                    std::this_thread::sleep_for(std::chrono::microseconds(500));
+                }
+            });
+        }
+
+        paramRunStats stats = {0., 0., 0., 0., 0., 0., 0};
+        std::vector<double> blockUS, transportNS;
+        blockUS.reserve(nFrames / blockSize);
+        transportNS.reserve(nFrames / blockSize);
+        double sumUS = 0.;
+        int blocks = 0;
+        const std::chrono::steady_clock::time_point runStart = std::chrono::steady_clock::now();
+        for(int offset = 0; offset + blockSize <= nFrames; offset += blockSize, ++blocks){
+            std::this_thread::sleep_until(runStart + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(offset / sampleRate)));
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            if(params.consume()){
+                engine.setGain(params.get(kParamGain));
+                engine.setThreshold(params.get(kParamThreshold));
+                engine.setAttack(params.get(kParamAttack));
+                engine.setRelease(params.get(kParamRelease));
+                engine.setHold(params.get(kParamHold));
+                engine.setRatio(params.get(kParamRatio));
+                engine.setKnee(params.get(kParamKnee));
+                engine.setMix(params.get(kParamMix));
+                engine.setCutoffHP(params.get(kParamCutoffHP));
+                engine.setCutoffLP(params.get(kParamCutoffLP));
+                engine.setRMSWindow(params.get(kParamRMSWindow));
+                ++stats.applied;
+            }
+            const std::chrono::steady_clock::time_point applied = std::chrono::steady_clock::now();
+            engine.process(&in[offset], &in[nFrames + offset], 0, 0, &out[0], &out[blockSize], blockSize);
+            const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+            blockUS.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+            transportNS.push_back(std::chrono::duration<double, std::nano>(applied - start).count());
+            sumUS += blockUS.back();
+        }
+        const double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - runStart).count();
+
+        done.store(true);
+        if(writer) writerThread.join();
+        stats.meanUS = sumUS / blocks;
+        std::sort(blockUS.begin(), blockUS.end());
+        std::sort(transportNS.begin(), transportNS.end());
+        stats.p999US = blockUS[blocks * 999 / 1000];
+        stats.maxUS = blockUS.back();
+        stats.transportP999NS = transportNS[blocks * 999 / 1000];
+        stats.transportMaxNS = transportNS.back();
+        stats.writesPerSecond = writes.load() / wallSeconds;
+        return stats;
+    }
+
+    //The callback's block times over 5 s with and without a thread writing parameters at 2 kHz.
+    //The transport never waits, so only the extra smoothing work and sharing the core may show.
+    //The maxima include preemption by the OS (and the writer, on a single core), p99.9 mostly not
+    int compareParamWriter(int blockSize, double sampleRate){
+        const double seconds = 5.;
+        const double deadlineUS = 1e6 * blockSize / sampleRate;
+        printf("%.0f s of %d sample blocks at %.0f Hz (deadline %.1f us), %u cores\n", seconds, blockSize, sampleRate, deadlineUS, std::thread::hardware_concurrency());
+        printf("writer   writes/s   blocks applied   mean us   p99.9 us   max us   max load %%   transport p99.9 ns   max ns\n");
+
+        bool ok = true;
+        for(int writer = 0; writer < 2; ++writer){
+            const paramRunStats stats = runParamWriter(writer != 0, seconds, blockSize, sampleRate);
+            printf("%-6s   %8.0f   %14d   %7.2f   %8.2f   %6.2f   %10.1f   %18.0f   %6.0f\n", writer ? "on" : "off", stats.writesPerSecond, stats.applied,
+                   stats.meanUS, stats.p999US, stats.maxUS, 100. * stats.maxUS / deadlineUS, stats.transportP999NS, stats.transportMaxNS);
+            if(writer) ok &= stats.writesPerSecond >= 1000. && stats.applied > 0;
+        }
+        printf("%s\n", ok ? "ok" : "FAILED (writer below 1 kHz or never applied)");
+        return ok ? 0 : 1;
+    }
+
+    template <typename T>
+    void benchmark(double seconds, int blockSize, double sampleRate){
+        const int nFrames = (int) (seconds * sampleRate);
+
+        std::vector<T> in1(nFrames), in2(nFrames), sc1(nFrames), sc2(nFrames);
+        std::vector<T> out1(blockSize), out2(blockSize);
+
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<double> noise(-1., 1.);
+        for(int i = 0; i < nFrames; ++i){
+            in1[i] = (T) noise(rng);
+            in2[i] = (T) noise(rng);
+            sc1[i] = (T) noise(rng);
+            sc2[i] = (T) noise(rng);
+        }
+
+        printf("%d frames, block %d, %.0f Hz, %s kernels, %s\n", nFrames, blockSize, sampleRate, getDSPKernels().name, sizeof(T) == sizeof(float) ? "float" : "double");
+        printf("mode     sc lp hp aud   ns/sample   x realtime\n");
+
+        for(int config = 0; config < 32; ++config){
+            DCompEngineT<T> engine;
+            configure(engine, config, sampleRate);
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for(int offset = 0; offset < nFrames; offset += blockSize){
+                const int n = std::min(blockSize, nFrames - offset);
+                engine.process(&in1[offset], &in2[offset], &sc1[offset], &sc2[offset], &out1[0], &out2[0], n);
+            }
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+            printf("%-8s %2d %2d %2d %3d   %9.2f   %10.1f\n", config & 1 ? "colored" : "clean", (config >> 1) & 1, (config >> 2) & 1, (config >> 3) & 1, (config >> 4) & 1,
+                   elapsed.count() * 1e9 / nFrames, seconds / elapsed.count());
+        }
+    }
+}
+
+int main(int argc, char* argv[]){
+    if(argc > 1 && !strcmp(argv[1], "--verify")){
+        printf("selected tier: %s, cpu supports up to tier %d\n", getDSPKernels().name, getSupportedDSPTier());
+        const tolerances doubleTol = {1e-11, 1e-11, 1e-12};
+        const tolerances floatTol = {5e-5, 2e-6, 1e-6};
+        bool ok = verifyKernels<double>("double", doubleTol);
+        ok &= verifyKernels<float>("float", floatTol);
+        printf(ok ? "all kernels ok\n" : "kernel verification FAILED\n");
+        return ok ? 0 : 1;
+    }
+    if(argc > 1 && !strcmp(argv[1], "--precision")) return comparePrecision(argc > 2 ? atof(argv[2]) : 48000.);
+    if(argc > 1 && !strcmp(argv[1], "--control-rate")) return compareControlRate(argc > 2 ? atof(argv[2]) : 48000.);
+    if(argc > 1 && !strcmp(argv[1], "--lookahead")) return compareLookahead(argc > 2 ? atof(argv[2]) : 48000.);
+    if(argc > 1 && !strcmp(argv[1], "--rms")) return compareRMS(argc > 2 ? atof(argv[2]) : 48000.);
+    if(argc > 1 && !strcmp(argv[1], "--saturation")) return compareSaturation(argc > 2 ? atof(argv[2]) : 48000.);
+    if(argc > 1 && !strcmp(argv[1], "--oversampling")) return compareOversampling(argc > 2 ? atof(argv[2]) : 48000.);
+    if(argc > 1 && !strcmp(argv[1], "--bank")) return compareBank(argc > 2 ? atof(argv[2]) : 48000.);
+    if(argc > 1 && !strcmp(argv[1], "--params")) return compareParamWriter(argc > 2 ? atoi(argv[2]) : 256, argc > 3 ? atof(argv[3]) : 48000.);
+    if(argc > 1 && !strcmp(argv[1], "--kernels")) return compareKernels(argc > 2 ? atof(argv[2]) : 48000.);
+    if(argc > 1 && !strcmp(argv[1], "--channels")) return compareChannels(argc > 2 ? atof(argv[2]) : 48000.);
+    if(argc > 1 && !strcmp(argv[1], "--gain-table")) return compareGainTable(argc > 2 ? atof(argv[2]) : 48000.);
+    if(argc > 1 && !strcmp(argv[1], "--timing")) return reportTiming(argc > 2 ? atoi(argv[2]) : 256, argc > 3 ? atof(argv[3]) : 48000.);
+
+    const bool singlePrecision = argc > 1 && !strcmp(argv[1], "--float");
+    if(singlePrecision){
+        --argc;
+        ++argv;
+    }
+
+    const double seconds = argc > 1 ? atof(argv[1]) : 10.;
+    const int blockSize = argc > 2 ? atoi(argv[2]) : 512;
+    const double sampleRate = argc > 3 ? atof(argv[3]) : 48000.;
+
+    if(seconds * sampleRate < 1. || blockSize <= 0){
+        fprintf(stderr, "usage: %s [--float] [seconds] [blockSize] [sampleRate]\n", argv[0]);
+        return 1;
+    }
+
+    if(singlePrecision) benchmark<float>(seconds, blockSize, sampleRate);
+    else benchmark<double>(seconds, blockSize, sampleRate);
+
+    return 0;
+}
@@ -0,0 +1,537 @@
+//
+//  dcomp-render.cpp
+//
+//  Offline batch renderer. Applies a preset to WAV/RF64 files with DCompEngine,
+//  optionally keyed from a sidechain file. A directory of files is spread over a
+//  thread pool sized to the machine, with one engine per file.
+//
+//  usage: dcomp-render [options] <input.wav | input dir> <output.wav | output dir>
+//
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "DCompEngine.h"
+#include "WavFile.h"
+
+namespace{
+
+    //Frames decoded, processed and encoded per step
+    const int kRenderBlockSize = 4096;
+
+    //Plugin parameters in the units shown in the plugin UI, defaults match DComp
+    struct preset{
+        double gain = 0.;
+        double threshold = -4.;
+        double attack = 10.;
+        double release = 250.;
+        double hold = 0.;
+        double ratio = 4.;
+        double knee = .5;
+        int mode = DCompEngine::kClean;
+        double mix = 100.;
+        bool audition = false;
+        double highpass = 20.;
+        double lowpass = 20000.;
+        bool highpassEnable = false;
+        bool lowpassEnable = false;
+        double lookahead = 5.;
+        int detector = envFollower::kPeak;
+        double rmsWindow = 50.;
+        int oversampling = 1;
+        int link = DCompEngine::kLinkMax;
+        std::vector<int> linkGroups = std::vector<int>(DCompEngine::kMaxChannels, 0);
+        std::vector<double> linkWeights = std::vector<double>(DCompEngine::kMaxChannels, 1.);
+
+        //Engine only, not plugin parameters
+        int controlRate = 1;
+        int interpolation = DCompEngine::kInterpolateDB;
+    };
+
+    struct renderJob{
+        std::string input, sidechain, output;
+    };
+
+    void printUsage(const char* name){
+        fprintf(stderr,
+                "usage: %s [options] <input.wav | input dir> <output.wav | output dir>\n"
+                "  -p, --preset FILE      read parameters from FILE, one 'name = value' per line\n"
+                "  -s, --set NAME=VALUE   set one parameter, applied after the preset\n"
+                "  -c, --sidechain PATH   key the compressor from PATH, a file or a directory of files\n"
+                "                         matched by name when the input is a directory\n"
+                "  -f, --format FMT       output format: 16, 24, 32, float or double (default: input format)\n"
+                "  -j, --jobs N           number of files rendered in parallel (default: all cores)\n"
+                "      --float            process in single precision instead of double\n"
+                "parameters: gain threshold attack release hold ratio knee (0-1) mode (clean|colored|limiter)\n"
+                "            mix (%%) audition (0|1) highpass lowpass (Hz, setting one enables the filter)\n"
+                "            lookahead (ms, limiter mode) detector (peak|rms) rmswindow (ms)\n"
+                "            oversampling (1, 2, 4 or 8, all modes) link (max|sum)\n"
+                "            linkgroups (all|pairs|none, or one group per channel: 0,0,1,1,...)\n"
+                "            linkweights (one detector weight per channel: 1,1,0.5,...)\n"
+                "            controlrate (samples per gain computer update, 1-64) interpolation (db|linear)\n",
+                name);
+    }
+
+    std::string trim(const std::string& s){
+        const char* ws = " \t\r\n";
+        size_t first = s.find_first_not_of(ws);
+        if(first == std::string::npos) return "";
+        return s.substr(first, s.find_last_not_of(ws) - first + 1);
+    }
+
+    bool parseNumber(const std::string& s, double& value){
+        char* end;
+        errno = 0;
+        value = strtod(s.c_str(), &end);
+        return !s.empty() && *end == '\0' && errno == 0;
+    }
+
+    //Comma separated numbers, at most DCompEngine::kMaxChannels of them
+    bool parseList(const std::string& s, std::vector<double>& values){
+        values.clear();
+        size_t start = 0;
+        while(values.size() < (size_t) DCompEngine::kMaxChannels){
+            const size_t comma = s.find(',', start);
+            double v;
+            if(!parseNumber(trim(s.substr(start, comma == std::string::npos ? std::string::npos : comma - start)), v)) return false;
+            values.push_back(v);
+            if(comma == std::string::npos) return true;
+            start = comma + 1;
+        }
+        return false;
+    }
+
+    bool setParameter(preset& p, const std::string& name, const std::string& value, std::string& error){
+        double v = 0.;
+
+        if(name == "mode"){
+            if(value == "clean" || value == "0") p.mode = DCompEngine::kClean;
+            else if(value == "colored" || value == "1") p.mode = DCompEngine::kColored;
+            else if(value == "limiter" || value == "2") p.mode = DCompEngine::kLimiter;
+            else{
+                error = "mode must be clean, colored or limiter";
+                return false;
+            }
+            return true;
+        }
+
+        if(name == "detector"){
+            if(value == "peak" || value == "0") p.detector = envFollower::kPeak;
+            else if(value == "rms" || value == "1") p.detector = envFollower::kRMS;
+            else{
+                error = "detector must be peak or rms";
+                return false;
+            }
+            return true;
+        }
+
+        if(name == "interpolation"){
+            if(value == "db" || value == "0") p.interpolation = DCompEngine::kInterpolateDB;
+            else if(value == "linear" || value == "1") p.interpolation = DCompEngine::kInterpolateLinear;
+            else{
+                error = "interpolation must be db or linear";
+                return false;
+            }
+            return true;
+        }
+
+        if(name == "link"){
+            if(value == "max" || value == "0") p.link = DCompEngine::kLinkMax;
+            else if(value == "sum" || value == "1") p.link = DCompEngine::kLinkSum;
+            else{
+                error = "link must be max or sum";
+                return false;
+            }
+            return true;
+        }
+
+        //Channels a list leaves out go in group 0 and keep weight 1
+        if(name == "linkgroups"){
+            std::vector<double> groups;
+            for(int c = 0; c < DCompEngine::kMaxChannels; ++c){
+                p.linkGroups[c] = value == "pairs" ? c / 2 : value == "none" ? c : 0;
+            }
+            if(value == "all" || value == "pairs" || value == "none") return true;
+            if(!parseList(value, groups)){
+                error = "linkgroups must be all, pairs, none or a list of up to 16 groups";
+                return false;
+            }
+            for(size_t c = 0; c < groups.size(); ++c){
+                if(groups[c] < 0 || groups[c] >= DCompEngine::kMaxChannels){
+                    error = "link groups must be 0 to 15";
+                    return false;
+                }
+                p.linkGroups[c] = (int) groups[c];
+            }
+            return true;
+        }
+
+        if(name == "linkweights"){
+            std::vector<double> weights;
+            if(!parseList(value, weights)){
+                error = "linkweights must be a list of up to 16 weights";
+                return false;
+            }
+            std::fill(p.linkWeights.begin(), p.linkWeights.end(), 1.);
+            std::copy(weights.begin(), weights.end(), p.linkWeights.begin());
+            return true;
+        }
+
+        if(!parseNumber(value, v)){
+            error = "invalid value '" + value + "' for " + name;
+            return false;
+        }
+
+        if(name == "gain") p.gain = v;
+        else if(name == "threshold") p.threshold = v;
+        else if(name == "attack") p.attack = v;
+        else if(name == "release") p.release = v;
+        else if(name == "hold") p.hold = v;
+        else if(name == "ratio") p.ratio = v;
+        else if(name == "knee") p.knee = v;
+        else if(name == "mix") p.mix = v;
+        else if(name == "audition") p.audition = v != 0.;
+        else if(name == "lookahead") p.lookahead = v;
+        else if(name == "rmswindow") p.rmsWindow = v;
+        else if(name == "oversampling"){
+            if(v != 1. && v != 2. && v != 4. && v != 8.){
+                error = "oversampling must be 1, 2, 4 or 8";
+                return false;
+            }
+            p.oversampling = (int) v;
+        }
+        else if(name == "controlrate") p.controlRate = (int) v;
+        else if(name == "highpass"){
+            p.highpass = v;
+            p.highpassEnable = true;
+        }
+        else if(name == "lowpass"){
+            p.lowpass = v;
+            p.lowpassEnable = true;
+        }
+        else{
+            error = "unknown parameter '" + name + "'";
+            return false;
+        }
+        return true;
+    }
+
+    bool setParameter(preset& p, const std::string& assignment, std::string& error){
+        size_t eq = assignment.find('=');
+        if(eq == std::string::npos){
+            error = "expected name = value, got '" + assignment + "'";
+            return false;
+        }
+        return setParameter(p, trim(assignment.substr(0, eq)), trim(assignment.substr(eq + 1)), error);
+    }
+
+    bool loadPreset(preset& p, const char* path, std::string& error){
+        FILE* f = fopen(path, "r");
+        if(!f){
+            error = std::string("cannot open preset ") + path;
+            return false;
+        }
+
+        char line[1024];
+        int lineNumber = 0;
+        bool ok = true;
+        while(ok && fgets(line, sizeof(line), f)){
+            ++lineNumber;
+            std::string s = line;
+            s = trim(s.substr(0, s.find('#')));
+            if(s.empty()) continue;
+
+            if(!setParameter(p, s, error)){
+                char where[64];
+                snprintf(where, sizeof(where), " (%s:%d)", path, lineNumber);
+                error += where;
+                ok = false;
+            }
+        }
+
+        fclose(f);
+        return ok;
+    }
+
+    //Mirrors the conversions in DComp::OnParamChange
+    template <typename T>
+    void applyPreset(DCompEngineT<T>& engine, const preset& p){
+        engine.setGain(p.gain);
+        engine.setThreshold(p.threshold);
+        engine.setAttack(p.attack);
+        engine.setRelease(p.release);
+        engine.setHold(p.hold);
+        engine.setRatio(p.ratio);
+        engine.setKnee(p.knee * 2.);
+        engine.setMode(p.mode);
+        engine.setMix(p.mix / 100.);
+        engine.setSidechainAudition(p.audition);
+        engine.setCutoffHP(p.highpass);
+        engine.setCutoffLP(p.lowpass);
+        engine.setHPEnable(p.highpassEnable);
+        engine.setLPEnable(p.lowpassEnable);
+        engine.setLookahead(p.lookahead);
+        engine.setDetector(p.detector);
+        engine.setRMSWindow(p.rmsWindow);
+        for(int mode = DCompEngine::kClean; mode <= DCompEngine::kLimiter; ++mode) engine.setOversampling(mode, p.oversampling);
+        engine.setControlRate(p.controlRate, p.interpolation);
+        engine.setLinkMode(p.link);
+        for(int c = 0; c < DCompEngine::kMaxChannels; ++c){
+            engine.setLinkGroup(c, p.linkGroups[c]);
+            engine.setLinkWeight(c, p.linkWeights[c]);
+        }
+    }
+
+    bool isDirectory(const std::string& path){
+        struct stat st;
+        return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+    }
+
+    //True when both paths exist and name the same file, through links too
+    bool isSameFile(const std::string& a, const std::string& b){
+        struct stat sa, sb;
+        return stat(a.c_str(), &sa) == 0 && stat(b.c_str(), &sb) == 0 && sa.st_dev == sb.st_dev && sa.st_ino == sb.st_ino;
+    }
+
+    bool hasWavExtension(const std::string& name){
+        size_t dot = name.rfind('.');
+        if(dot == std::string::npos) return false;
+        std::string ext = name.substr(dot + 1);
+        for(size_t i = 0; i < ext.size(); ++i) ext[i] = tolower(ext[i]);
+        return ext == "wav" || ext == "wave" || ext == "rf64";
+    }
+
+    bool listWavFiles(const std::string& dir, std::vector<std::string>& names){
+        DIR* d = opendir(dir.c_str());
+        if(!d) return false;
+
+        while(dirent* entry = readdir(d)){
+            std::string name = entry->d_name;
+            if(name[0] != '.' && hasWavExtension(name) && !isDirectory(dir + "/" + name)) names.push_back(name);
+        }
+        closedir(d);
+
+        std::sort(names.begin(), names.end());
+        return true;
+    }
+
+    //T is the sample type the engine runs in, files are decoded straight into it
+    template <typename T>
+    bool render(const renderJob& job, const preset& p, int format, std::string& error){
+        //The inputs stay mapped while the output is written, truncating one of them would destroy it
+        if(isSameFile(job.output, job.input) || (!job.sidechain.empty() && isSameFile(job.output, job.sidechain))){
+            error = job.output + ": output would overwrite an input, choose another output path";
+            return false;
+        }
+
+        wavReader input;
+        if(!input.open(job.input.c_str(), error)){
+            error = job.input + ": " + error;
+            return false;
+        }
+
+        const int channels = input.getChannels();
+        if(channels > DCompEngine::kMaxChannels){
+            error = job.input + ": at most 16 channels are supported";
+            return false;
+        }
+
+        wavReader sidechain;
+        if(!job.sidechain.empty()){
+            if(!sidechain.open(job.sidechain.c_str(), error)){
+                error = job.sidechain + ": " + error;
+                return false;
+            }
+            if(sidechain.getSampleRate() != input.getSampleRate() || sidechain.getChannels() > DCompEngine::kMaxChannels){
+                error = job.sidechain + ": sidechain must have at most 16 channels and the input sample rate";
+                return false;
+            }
+        }
+
+        DCompEngineT<T> engine;
+        applyPreset(engine, p);
+        engine.setSidechainEnable(!job.sidechain.empty());
+        engine.init(input.getSampleRate());
+
+        wavWriter output;
+        if(!output.open(job.output.c_str(), channels, input.getSampleRate(), format < 0 ? input.getFormat() : format, error)){
+            error = job.output + ": " + error;
+            return false;
+        }
+
+        //Each channel is keyed from sidechain channel c modulo the sidechain's channel count, so a
+        //mono key drives every channel and a stereo key alternates left and right
+        const int scChannels = job.sidechain.empty() ? 0 : sidechain.getChannels();
+        std::vector<T> buffers((2 * channels + scChannels) * kRenderBlockSize);
+        T* in[DCompEngine::kMaxChannels];
+        T* out[DCompEngine::kMaxChannels];
+        T* scRead[DCompEngine::kMaxChannels];
+        const T* sc[DCompEngine::kMaxChannels];
+        for(int c = 0; c < channels; ++c){
+            in[c] = &buffers[c * kRenderBlockSize];
+            out[c] = &buffers[(channels + c) * kRenderBlockSize];
+        }
+        for(int c = 0; c < scChannels; ++c) scRead[c] = &buffers[(2 * channels + c) * kRenderBlockSize];
+        for(int c = 0; c < channels; ++c) sc[c] = scChannels ? scRead[c % scChannels] : 0;
+
+        //Run latency frames past the end (reads there are silence) and drop the first latency
+        //output frames, so the output lines up with the input and keeps its length
+        const int latency = DCompEngine::getLatency(p.mode, p.lookahead, input.getSampleRate(), p.oversampling);
+        const int64_t frames = input.getFrames() + latency;
+
+        for(int64_t frame = 0; frame < frames; frame += kRenderBlockSize){
+            const int n = (int) std::min<int64_t>(kRenderBlockSize, frames - frame);
+
+            input.read(frame, n, in);
+            if(scChannels) sidechain.read(frame, n, scRead);
+
+            engine.process(in, scChannels ? sc : 0, out, channels, n);
+
+            const int skip = (int) std::max<int64_t>(0, std::min<int64_t>(n, latency - frame));
+            T* aligned[DCompEngine::kMaxChannels];
+            for(int c = 0; c < channels; ++c) aligned[c] = out[c] + skip;
+            if(n > skip && !output.write(aligned, n - skip)) break;
+        }
+
+        if(!output.close()){
+            error = job.output + ": write failed";
+            return false;
+        }
+        return true;
+    }
+}
+
+int main(int argc, char* argv[]){
+    preset p;
+    std::string sidechainPath;
+    int format = -1;
+    unsigned int jobs = std::max(1u, std::thread::hardware_concurrency());
+    bool singlePrecision = false;
+    std::vector<std::string> positional;
+    std::string error;
+
+    for(int i = 1; i < argc; ++i){
+        std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+
+        if((arg == "-p" || arg == "--preset") && hasValue){
+            if(!loadPreset(p, argv[++i], error)){
+                fprintf(stderr, "%s\n", error.c_str());
+                return 1;
+            }
+        }
+        else if((arg == "-s" || arg == "--set") && hasValue){
+            if(!setParameter(p, argv[++i], error)){
+                fprintf(stderr, "%s\n", error.c_str());
+                return 1;
+            }
+        }
+        else if((arg == "-c" || arg == "--sidechain") && hasValue){
+            sidechainPath = argv[++i];
+        }
+        else if((arg == "-f" || arg == "--format") && hasValue){
+            std::string f = argv[++i];
+            if(f == "16") format = kInt16;
+            else if(f == "24") format = kInt24;
+            else if(f == "32") format = kInt32;
+            else if(f == "float") format = kFloat32;
+            else if(f == "double") format = kFloat64;
+            else{
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        else if((arg == "-j" || arg == "--jobs") && hasValue){
+            jobs = std::max(1, atoi(argv[++i]));
+        }
+        else if(arg == "--float"){
+            singlePrecision = true;
+        }
+        else if(arg == "-h" || arg == "--help"){
+            printUsage(argv[0]);
+            return 0;
+        }
+        else if(!arg.empty() && arg[0] == '-'){
+            printUsage(argv[0]);
+            return 1;
+        }
+        else{
+            positional.push_back(arg);
+        }
+    }
+
+    if(positional.size() != 2){
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    const std::string& inputPath = positional[0];
+    const std::string& outputPath = positional[1];
+    std::vector<renderJob> renderJobs;
+
+    if(isDirectory(inputPath)){
+        std::vector<std::string> names;
+        if(!listWavFiles(inputPath, names)){
+            fprintf(stderr, "%s: cannot read directory\n", inputPath.c_str());
+            return 1;
+        }
+        if(!isDirectory(outputPath) && mkdir(outputPath.c_str(), 0777) != 0){
+            fprintf(stderr, "%s: cannot create directory\n", outputPath.c_str());
+            return 1;
+        }
+
+        const bool sidechainDir = !sidechainPath.empty() && isDirectory(sidechainPath);
+        for(size_t i = 0; i < names.size(); ++i){
+            renderJob job;
+            job.input = inputPath + "/" + names[i];
+            job.output = outputPath + "/" + names[i];
+            job.sidechain = sidechainDir ? sidechainPath + "/" + names[i] : sidechainPath;
+            renderJobs.push_back(job);
+        }
+    }
+    else{
+        renderJob job;
+        job.input = inputPath;
+        job.output = isDirectory(outputPath) ? outputPath + "/" + inputPath.substr(inputPath.rfind('/') + 1) : outputPath;
+        job.sidechain = sidechainPath;
+        renderJobs.push_back(job);
+    }
+
+    //Each worker takes the next file until none are left
+    std::atomic<size_t> next(0);
+    std::atomic<int> failures(0);
+    std::mutex printMutex;
+
+    auto worker = [&](){
+        for(size_t i = next++; i < renderJobs.size(); i = next++){
+            std::string jobError;
+            bool ok = singlePrecision ? render<float>(renderJobs[i], p, format, jobError) : render<double>(renderJobs[i], p, format, jobError);
+
+            std::lock_guard<std::mutex> lock(printMutex);
+            if(ok){
+                printf("%s -> %s\n", renderJobs[i].input.c_str(), renderJobs[i].output.c_str());
+            }
+            else{
+                fprintf(stderr, "error: %s\n", jobError.c_str());
+                ++failures;
+            }
+        }
+    };
+
+    jobs = std::min<unsigned int>(jobs, (unsigned int) renderJobs.size());
+    std::vector<std::thread> workers;
+    for(unsigned int t = 1; t < jobs; ++t) workers.push_back(std::thread(worker));
+    worker();
+    for(size_t t = 0; t < workers.size(); ++t) workers[t].join();
+
+    return failures == 0 ? 0 : 1;
+}
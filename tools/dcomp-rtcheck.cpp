@@ -0,0 +1,318 @@
+//
+//  dcomp-rtcheck.cpp
+//
+//  Drives DCompEngine the way the plugin's audio callback does, with the real time
+//  checker armed around every callback: parameter changes go through the setters and
+//  process() runs with the meter tap and curve attached, timed by a blockTimer, while a
+//  builder thread rebuilds a gain table from the curve. Every mode, detector, control rate
+//  and kernel flag combination is run for both precisions, with all continuous parameters
+//  automated and the switches (gain table, oversampling, channel count and linking included)
+//  flipped mid-stream. Exits non-zero and prints a stack trace for anything that allocates,
+//  locks, prints or sleeps in the callback. Halfway through each run the engine is reset at another sample rate.
+//  The meter frames are fed to the plots' history, which is checked the same way.
+//
+//  usage: dcomp-rtcheck [blocks] [sampleRate]
+//         dcomp-rtcheck --self-test   checks that the checker itself catches each kind of call
+//
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include "DCompEngine.h"
+#include "BlockTimer.h"
+#include "PlotHistory.h"
+#include "RMSRingWorker.h"
+#include "RTCheck.h"
+
+namespace{
+    //Largest block a host hands the plugin in this run, block sizes are random up to this
+    const int kMaxBlockSize = 2048;
+
+    const char* const kModeNames[] = {"clean", "colored", "limiter"};
+
+    //The plots as DComp sets them up: 4 s across 300 columns, -32 to +2 dB over 200 pixels
+    const double kPlotTimeScale = 4.;
+    const int kPlotColumns = 300;
+    const double kPlotHeight = 200., kPlotRange = -32., kPlotHeadroom = 2.;
+
+    //What IGRPlotControl and ILevelPlotControl do with each meter frame: follow the levels and
+    //average them into columns. init() allocates, feed() must not
+    struct plotFeed{
+        envFollower envIn, envOut;
+        plotHistory history, level;
+
+        void init(double sampleRate){
+            const double rate = meterTap::getFrameRate(sampleRate);
+            const int columnLength = std::max(1, int(kPlotTimeScale * rate / kPlotColumns));
+            const double scale = -kPlotHeight / (kPlotHeadroom - kPlotRange);
+            envIn.init(envFollower::kPeak, 0, 75, 60, rate);
+            envOut.init(envFollower::kPeak, 0, 75, 60, rate);
+            history.init(3, kPlotColumns, columnLength);
+            history.setMapping(scale, kPlotHeight - scale * kPlotRange);
+            level.init(1, kPlotColumns, columnLength);
+            level.setMapping(scale, kPlotHeight - scale * kPlotRange);
+        }
+
+        void feed(const meterFrame& frame){
+            const double in = 20. * std::log10(std::max(envIn.process(frame.in), 1e-10));
+            const double out = 20. * std::log10(std::max(envOut.process(frame.out), 1e-10));
+            history.add(in, out, frame.gr);
+            level.add(in);
+        }
+    };
+
+    //The callback as DComp runs it: apply the latest parameters, then process the block
+    struct callbackState{
+        int mode, detector, controlRate, oversampling;
+        int channels, link, linkGroups;     //linkGroups: 0 all, 1 pairs, 2 none
+        bool sidechain, lowpass, highpass, audition, gainTable;
+    };
+
+    template <typename T>
+    void automate(DCompEngineT<T>& engine, std::mt19937& rng){
+        std::uniform_real_distribution<double> u(0., 1.);
+        engine.setGain(32. * u(rng));
+        engine.setThreshold(-32. + 34. * u(rng));
+        engine.setAttack(0.01 + 500. * u(rng));
+        engine.setRelease(1. + 2000. * u(rng));
+        engine.setHold(500. * u(rng));
+        engine.setRatio(1. + 19. * u(rng));
+        engine.setKnee(2. * u(rng));
+        engine.setMix(u(rng));
+        engine.setCutoffHP(20. + 1980. * u(rng));
+        engine.setCutoffLP(1000. + 19000. * u(rng));
+        engine.setLookahead(DCompEngine::kMaxLookaheadMS * u(rng));
+        engine.setRMSWindow(1. + (DCompEngine::kMaxRMSWindowMS - 1.) * u(rng));
+    }
+
+    template <typename T>
+    void applySwitches(DCompEngineT<T>& engine, const callbackState& s, gainCurveBuffer* table){
+        engine.setMode(s.mode);
+        engine.setDetector(s.detector);
+        engine.setControlRate(s.controlRate);
+        engine.setSidechainEnable(s.sidechain);
+        engine.setLPEnable(s.lowpass);
+        engine.setHPEnable(s.highpass);
+        engine.setSidechainAudition(s.audition);
+        engine.setGainTable(s.gainTable ? table : 0);
+        for(int mode = DCompEngine::kClean; mode <= DCompEngine::kLimiter; ++mode) engine.setOversampling(mode, s.oversampling);
+        engine.setLinkMode(s.link);
+        for(int c = 0; c < DCompEngine::kMaxChannels; ++c) engine.setLinkGroup(c, s.linkGroups == 0 ? 0 : s.linkGroups == 1 ? c / 2 : c);
+    }
+
+    //One configuration: set up outside the checker (allocation is allowed there, as in
+    //Reset), then run blocks callbacks with the checker armed. The gain table builder
+    //thread is not armed, it may lock and sleep
+    template <typename T>
+    void runConfiguration(const callbackState& start, int blocks, double sampleRate, const std::vector<T>& input, std::mt19937& rng){
+        DCompEngineT<T> engine;
+        meterTap tap;
+        compressorCurve curve;
+        blockTimer timer;
+        gainCurveBuffer table;
+        std::vector<T> out(DCompEngine::kMaxChannels * kMaxBlockSize);
+        meterFrame frame;
+        plotFeed plots;
+        rmsRingWorker<T> ringWorker;
+
+        applySwitches(engine, start, &table);
+        engine.setMeterTap(&tap);
+        engine.setCurve(&curve);
+        engine.init(sampleRate);
+        timer.setSampleRate(sampleRate);
+        plots.init(sampleRate);
+
+        std::atomic<bool> done(false);
+        std::thread builder([&](){
+            compressor shape;
+            while(!done.load()){
+                if(curve.update(shape)) table.update(shape);
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        });
+
+        callbackState s = start;
+        std::uniform_int_distribution<int> blockSize(1, kMaxBlockSize);
+        std::uniform_int_distribution<int> flip(0, 15);
+        const int nFrames = (int) input.size() / 4;
+        double rate = sampleRate;
+
+        for(int b = 0; b < blocks; ++b){
+            //Halfway through the host resets at another rate, as DComp::Reset does, after which
+            //the callback must still not allocate
+            if(b == blocks / 2){
+                rate = sampleRate == 192000. ? 44100. : 192000.;
+                engine.init(rate);
+                timer.setSampleRate(rate);
+                plots.init(rate);
+            }
+
+            //Flip one switch now and then, so every transition is covered from every state
+            const int flipped = flip(rng);
+            switch(flipped){
+                case 0: s.mode = (s.mode + 1) % 3; break;
+                case 1: s.detector = 1 - s.detector; break;
+                case 2: s.controlRate = s.controlRate == 1 ? 16 : 1; break;
+                case 3: s.sidechain = !s.sidechain; break;
+                case 4: s.lowpass = !s.lowpass; break;
+                case 5: s.highpass = !s.highpass; break;
+                case 6: s.audition = !s.audition; break;
+                case 7: s.gainTable = !s.gainTable; break;
+                case 8: s.oversampling = s.oversampling == DCompEngine::kMaxOversampling ? 1 : 2 * s.oversampling; break;
+                case 9: s.link = 1 - s.link; break;
+                case 10: s.linkGroups = (s.linkGroups + 1) % 3; break;
+                case 11: s.channels = s.channels == 2 ? 6 : s.channels == 6 ? DCompEngine::kMaxChannels : s.channels == DCompEngine::kMaxChannels ? 1 : 2; break;
+                default: break;
+            }
+
+            //Selecting RMS or relinking requests RMS buffers from the callback, as DComp::OnParamChange
+            //does when the host calls it from the audio thread. The worker allocates them and a later
+            //callback swaps them in, as ProcessDoubleReplacing does
+            const bool newRings = s.detector == envFollower::kRMS && (flipped == 1 || flipped == 10);
+
+            const int n = blockSize(rng);
+            const int offset = std::uniform_int_distribution<int>(0, nFrames - n)(rng);
+
+            //Beyond stereo the channels reuse the two inputs and the two sidechain channels
+            const T* in[DCompEngine::kMaxChannels];
+            const T* sc[DCompEngine::kMaxChannels];
+            T* channelOut[DCompEngine::kMaxChannels];
+            for(int c = 0; c < s.channels; ++c){
+                in[c] = &input[(c & 1) * nFrames + offset];
+                sc[c] = &input[(2 + (c & 1)) * nFrames + offset];
+                channelOut[c] = &out[c * kMaxBlockSize];
+            }
+
+            {
+                rtCheckScope scope("the audio callback");
+                timer.begin();
+                if(newRings) ringWorker.request(rate, s.linkGroups == 0 ? 1 : s.linkGroups == 1 ? DCompEngine::kMaxChannels / 2 : DCompEngine::kMaxChannels);
+                applySwitches(engine, s, &table);
+                ringWorker.apply(engine);
+                automate(engine, rng);
+                if(s.channels == 2) engine.process(in[0], in[1], sc[0], sc[1], channelOut[0], channelOut[1], n);
+                else engine.process(in, sc, channelOut, s.channels, n);
+                timer.end(n);
+            }
+
+            //A host's blocks are milliseconds apart, give the worker as long so the rings are swapped in
+            //by one of the next callbacks
+            if(newRings) std::this_thread::sleep_for(std::chrono::milliseconds(2 * rmsRingWorker<T>::kPollMS));
+
+            //GUI side: the meter tap and the plot history must not allocate either
+            {
+                rtCheckScope scope("the plot history");
+                while(tap.read(frame)) plots.feed(frame);
+            }
+        }
+
+        done.store(true);
+        builder.join();
+    }
+
+    template <typename T>
+    int runMatrix(int blocks, double sampleRate){
+        std::vector<T> input(4 * sampleRate);
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<double> noise(-1., 1.);
+        for(size_t i = 0; i < input.size(); ++i) input[i] = (T) (2. * noise(rng));
+
+        const int before = rtCheckViolations();
+        int configurations = 0;
+        for(int mode = 0; mode < 3; ++mode){
+            for(int detector = 0; detector < 2; ++detector){
+                for(int rate = 0; rate < 2; ++rate){
+                    for(int flags = 0; flags < 16; ++flags){
+                        callbackState s;
+                        s.mode = mode;
+                        s.detector = detector;
+                        s.controlRate = rate ? 16 : 1;
+                        s.sidechain = (flags & 1) != 0;
+                        s.lowpass = (flags & 2) != 0;
+                        s.highpass = (flags & 4) != 0;
+                        s.audition = (flags & 8) != 0;
+                        s.gainTable = false;
+                        s.oversampling = 1;
+                        s.channels = 2;
+                        s.link = DCompEngine::kLinkMax;
+                        s.linkGroups = 0;
+
+                        const int violations = rtCheckViolations();
+                        runConfiguration<T>(s, blocks, sampleRate, input, rng);
+                        if(rtCheckViolations() != violations){
+                            fprintf(stderr, "  in %s, %s detector, control rate %d, sc %d lp %d hp %d aud %d (%s)\n", kModeNames[mode], detector ? "rms" : "peak", s.controlRate,
+                                    s.sidechain, s.lowpass, s.highpass, s.audition, sizeof(T) == sizeof(float) ? "float" : "double");
+                        }
+                        ++configurations;
+                    }
+                }
+            }
+        }
+
+        const int found = rtCheckViolations() - before;
+        printf("%-6s %d configurations x %d callbacks: %d violations %s\n", sizeof(T) == sizeof(float) ? "float" : "double", configurations, blocks, found, found ? "FAILED" : "ok");
+        return found;
+    }
+
+    //Each of these must be caught, or the matrix passing means nothing
+    int selfTest(){
+        std::mutex mutex;
+        int missed = 0;
+        rtCheckSetMaxReports(0);
+
+        struct probe{
+            const char* name;
+            void (*run)(std::mutex&);
+        };
+        const probe probes[] = {
+            //volatile keeps the compiler from eliding the pairs or the empty print
+            {"operator new", [](std::mutex&){ int* volatile p = new int(1); delete p; }},
+            {"std::vector growth", [](std::mutex&){ std::vector<double> v; v.push_back(1.); }},
+            {"malloc", [](std::mutex&){ void* volatile p = malloc(16); free(p); }},
+            {"std::mutex", [](std::mutex& m){ m.lock(); m.unlock(); }},
+            {"printf", [](std::mutex&){ const char* volatile empty = ""; printf("%s", empty); }},
+            {"fwrite", [](std::mutex&){ fwrite("", 1, 0, stdout); }},
+        };
+
+        for(size_t i = 0; i < sizeof(probes) / sizeof(probes[0]); ++i){
+            //Only the glibc build sees malloc and the C library
+            const bool expected = rtCheckInterposesLibC() || !strcmp(probes[i].name, "operator new") || !strcmp(probes[i].name, "std::vector growth");
+            const int before = rtCheckViolations();
+            {
+                rtCheckScope scope("the self test");
+                probes[i].run(mutex);
+            }
+            const bool caught = rtCheckViolations() > before;
+            if(expected && !caught) ++missed;
+            printf("%-20s %s\n", probes[i].name, caught ? "caught" : expected ? "MISSED" : "not checked on this platform");
+        }
+
+        return missed ? 1 : 0;
+    }
+}
+
+int main(int argc, char* argv[]){
+    rtCheckInit();
+    if(argc > 1 && !strcmp(argv[1], "--self-test")) return selfTest();
+
+    const int blocks = argc > 1 ? atoi(argv[1]) : 200;
+    const double sampleRate = argc > 2 ? atof(argv[2]) : 48000.;
+    if(blocks <= 0 || sampleRate < kMaxBlockSize){
+        fprintf(stderr, "usage: %s [blocks] [sampleRate]\n", argv[0]);
+        return 1;
+    }
+
+    if(!rtCheckInterposesLibC()) printf("only operator new/delete are checked on this platform\n");
+
+    int violations = runMatrix<double>(blocks, sampleRate);
+    violations += runMatrix<float>(blocks, sampleRate);
+    return violations ? 1 : 0;
+}
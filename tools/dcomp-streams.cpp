@@ -0,0 +1,172 @@
+//
+//  dcomp-streams.cpp
+//
+//  Load test for servers that embed the engine: many independent stereo streams, one
+//  DCompEngine each, processed once per audio period by a streamScheduler. Sweeps thread
+//  and stream counts and prints the wall time per period against the period's deadline,
+//  the overruns, the load imbalance between workers and how often they stole work. Fails if
+//  any stream was not processed exactly once per period.
+//
+//  usage: dcomp-streams [options] [periods] [blockSize] [sampleRate]
+//
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include "DCompEngine.h"
+#include "StreamScheduler.h"
+
+namespace{
+    //Periods run before the timed ones, so every engine has touched its buffers
+    const int kWarmupPeriods = 5;
+
+    void printUsage(const char* name){
+        fprintf(stderr,
+                "usage: %s [options] [periods] [blockSize] [sampleRate]\n"
+                "  -t, --threads LIST   thread counts to sweep, including the calling thread (default: 1,2,4,8,16,32,64)\n"
+                "  -s, --streams LIST   stream counts to sweep (default: 10,50,100,500,1000,2000)\n"
+                "  -c, --chunk N        streams per chunk (default: a quarter of each thread's share)\n"
+                "      --no-pin         leave the workers unpinned\n"
+                "defaults: 100 periods of 256 frames at 48000 Hz\n",
+                name);
+    }
+
+    bool parseList(const char* s, std::vector<int>& values){
+        values.clear();
+        while(*s){
+            char* end;
+            const long v = strtol(s, &end, 10);
+            if(end == s || v <= 0) return false;
+            values.push_back((int) v);
+            s = *end == ',' ? end + 1 : end;
+            if(*end && *end != ',') return false;
+        }
+        return !values.empty();
+    }
+
+    //Every stream has its own engine, settings and buffers. Each stream's input is noise at its own level
+    struct streamSet{
+        std::vector<DCompEngineT<float> > engines;
+        std::vector<float> in, out;
+        std::vector<int> runs;      //Periods each stream was processed in, only its chunk's worker writes it
+        int blockSize;
+
+        void init(int count, int frames, double sampleRate){
+            std::vector<DCompEngineT<float> >(count).swap(engines);
+            blockSize = frames;
+            in.resize(2 * count * frames);
+            out.resize(2 * count * frames);
+            runs.assign(count, 0);
+
+            std::mt19937 rng(1);
+            std::uniform_real_distribution<double> unit(0., 1.);
+            for(int s = 0; s < count; ++s){
+                DCompEngineT<float>& e = engines[s];
+                e.setMode(s % 3);
+                e.setThreshold(-30. * unit(rng));
+                e.setRatio(1. + 9. * unit(rng));
+                e.setAttack(0.1 + 30. * unit(rng));
+                e.setRelease(20. + 500. * unit(rng));
+                e.init(sampleRate);
+
+                const double level = unit(rng);
+                for(int i = 0; i < 2 * frames; ++i) in[2 * s * frames + i] = (float) (level * (2. * unit(rng) - 1.));
+            }
+        }
+
+        static void process(void* context, int begin, int end){
+            streamSet& set = *(streamSet*) context;
+            const int n = set.blockSize;
+            for(int s = begin; s < end; ++s){
+                const float* in = &set.in[2 * s * n];
+                float* out = &set.out[2 * s * n];
+                set.engines[s].process(in, in + n, 0, 0, out, out + n, n);
+                ++set.runs[s];
+            }
+        }
+    };
+}
+
+int main(int argc, char* argv[]){
+    std::vector<int> threadCounts, streamCounts;
+    parseList("1,2,4,8,16,32,64", threadCounts);
+    parseList("10,50,100,500,1000,2000", streamCounts);
+    int chunkSize = 0;
+    bool pin = true;
+    std::vector<const char*> positional;
+
+    for(int i = 1; i < argc; ++i){
+        const bool hasValue = i + 1 < argc;
+        if((!strcmp(argv[i], "-t") || !strcmp(argv[i], "--threads")) && hasValue){
+            if(!parseList(argv[++i], threadCounts)){
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        else if((!strcmp(argv[i], "-s") || !strcmp(argv[i], "--streams")) && hasValue){
+            if(!parseList(argv[++i], streamCounts)){
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        else if((!strcmp(argv[i], "-c") || !strcmp(argv[i], "--chunk")) && hasValue) chunkSize = atoi(argv[++i]);
+        else if(!strcmp(argv[i], "--no-pin")) pin = false;
+        else if(argv[i][0] == '-'){
+            printUsage(argv[0]);
+            return 1;
+        }
+        else positional.push_back(argv[i]);
+    }
+
+    const int periods = positional.size() > 0 ? atoi(positional[0]) : 100;
+    const int blockSize = positional.size() > 1 ? atoi(positional[1]) : 256;
+    const double sampleRate = positional.size() > 2 ? atof(positional[2]) : 48000.;
+    if(periods <= 0 || blockSize <= 0 || sampleRate <= 0. || chunkSize < 0){
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    const double deadlineMS = 1000. * blockSize / sampleRate;
+    printf("%d periods of %d frames at %.0f Hz (deadline %.2f ms), %u cores, workers %s\n", periods, blockSize, sampleRate, deadlineMS,
+           std::thread::hardware_concurrency(), pin ? "pinned" : "unpinned");
+    printf("threads   streams   chunk   mean ms   max ms   load %%   overruns   imbalance   steals\n");
+
+    streamSet streams;
+    bool ok = true;
+    for(size_t j = 0; j < streamCounts.size(); ++j){
+        const int nStreams = streamCounts[j];
+        streams.init(nStreams, blockSize, sampleRate);
+
+        for(size_t k = 0; k < threadCounts.size(); ++k){
+            streamScheduler scheduler(threadCounts[k], pin);
+            const int chunk = chunkSize ? chunkSize : streamScheduler::getDefaultChunkSize(nStreams, threadCounts[k]);
+
+            std::fill(streams.runs.begin(), streams.runs.end(), 0);
+            double wallSum = 0., wallMax = 0., imbalanceSum = 0.;
+            int overruns = 0;
+            long steals = 0;
+            for(int p = 0; p < kWarmupPeriods + periods; ++p){
+                scheduler.run(nStreams, chunk, &streamSet::process, &streams);
+                if(p < kWarmupPeriods) continue;
+
+                const streamPeriodStats& stats = scheduler.getLastPeriod();
+                const double ms = stats.wallNS * 1e-6;
+                wallSum += ms;
+                wallMax = std::max(wallMax, ms);
+                imbalanceSum += stats.imbalance;
+                steals += stats.steals;
+                if(ms > deadlineMS) ++overruns;
+            }
+
+            const bool complete = std::count(streams.runs.begin(), streams.runs.end(), kWarmupPeriods + periods) == nStreams;
+            ok &= complete;
+            printf("%7d   %7d   %5d   %7.3f   %6.3f   %6.1f   %8d   %9.2f   %6.1f%s\n", threadCounts[k], nStreams, chunk, wallSum / periods, wallMax,
+                   100. * wallSum / periods / deadlineMS, overruns, imbalanceSum / periods, (double) steals / periods, complete ? "" : "   FAILED");
+        }
+    }
+    return ok ? 0 : 1;
+}